@@ -0,0 +1,913 @@
+// Microbenchmarks of the tracker pipeline, run against the mock SteamVR host of driver_runner:
+//
+//   parse             handling one updatepose message, as timed by the driver itself inside the pipe thread
+//   pipe_roundtrip    sending that message and receiving the reply
+//   parse_binary      handling the same update as a binary UpdatePose message
+//   binary_roundtrip  sending that message and receiving the reply
+//   client_update     ApriltagClient::Client::UpdatePose, one binary update waiting for its reply
+//   client_async      UpdatePoseAsync with the default window of requests in flight, time per update
+//   client_send       SendPose, fire and forget updates the driver does not reply to, time per update
+//   client_batch      UpdatePoses with one sample per tracker, time per sample
+//   save              TrackerDevice::save_current_pose
+//   predict           TrackerDevice::get_next_pose
+//   update            TrackerDevice::Update, prediction and posting for one tracker
+//   run_frame         VRDriver::RunFrame with every tracker, the path SteamVR actually drives
+//   get_rotation      VRDriver::GetRotation
+//   ring_insert       SampleRing::Insert of a sample newer than all others into a full ring, keeping the running sums
+//   ring_insert_late  the same for a sample that arrives behind a quarter of the ring and has to be moved into place
+//
+// Every case runs for every combination of tracker count, history size and filter. Results are CSV on stdout,
+// one row per case with the time of one operation in ns (one frame for run_frame), so runs of different
+// releases can be compared directly. For the client cases 1e9 / mean_ns is the updates per second one client
+// thread can achieve, the same goes for text (parse, pipe_roundtrip) against binary (parse_binary, binary_roundtrip) messages.
+//
+// With --fusion it instead measures accuracy: several simulated cameras of different quality watch one tracker,
+// some of their observations way off, and their samples are fed to the tracker's filter both as they come and
+// through PoseFusion. Rows give the error of the pose posted every frame against the true motion, in mm.
+//
+// With --clients it instead runs that many clients at once, each on its own connection and thread sending
+// UpdatePose and waiting for every reply, while a frame thread calls RunFrame at 90 Hz. Rows give the updates
+// per second of all clients together and the round trip time of one update, which shows how well the pipe
+// threads scale and how much they contend for the trackers.
+//
+// With --replay it instead feeds the pose samples of a session recording or driver_runner trace (synthetic ones
+// without a file) through every filter in simulated time and compares the poses posted every frame with the
+// sampled path: jitter, lag and the CPU time the filter took, per tracker.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openvr_driver.h>
+
+#include <Native/DriverFactory.hpp>
+#include <Driver/VRDriver.hpp>
+#include <Driver/TrackerDevice.hpp>
+#include <Driver/Transport.hpp>
+#include <Driver/Telemetry.hpp>
+#include <Driver/PoseFusion.hpp>
+#include <Driver/Protocol.hpp>
+#include <Driver/Recording.hpp>
+#include <Driver/SampleRing.hpp>
+
+#include <ApriltagClient.hpp>
+
+#include "MockHost.hpp"
+
+using namespace ExampleDriver;
+
+namespace {
+
+    struct Options {
+        std::vector<int> trackers = { 1, 4, 16, 64 };
+        std::vector<int> history = { 5, 10, 50, 200 };
+        std::vector<std::string> filters = { "regression" };
+        double seconds = 0.2;       // per case
+        bool fusion = false;
+        std::vector<int> clients;   // concurrent client counts, empty runs the microbenchmarks
+        bool replay = false;
+        std::string replay_file;    // recording or trace, empty replays synthetic samples
+    };
+
+    void PrintUsage()
+    {
+        std::fprintf(stderr,
+            "usage: driver_benchmark [options]\n"
+            "  --trackers <n,n,...>   tracker counts (default 1,4,16,64)\n"
+            "  --history <n,n,...>    saved samples per tracker (default 5,10,50,200)\n"
+            "  --filters <f,f,...>    regression, kalman, oneeuro (default regression)\n"
+            "  --time <ms>            time spent on every case (default 200)\n"
+            "  --fusion               measure the accuracy of multi-camera fusion instead of timings\n"
+            "  --clients <n,n,...>    measure throughput and latency of that many concurrent clients instead\n"
+            "  --replay [file]        replay the samples of a recording or trace through the filters, synthetic ones without a file\n");
+    }
+
+    template<typename T>
+    std::vector<T> ParseList(const char* text)
+    {
+        std::vector<T> values;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            std::stringstream value(item);
+            T parsed;
+            if (value >> parsed)
+                values.push_back(parsed);
+        }
+        return values;
+    }
+
+    // Runs op, which performs batch operations, over and over for the given time and histograms the time per operation
+    template<typename Op>
+    void Measure(double seconds, int batch, Histogram::Snapshot& result, Op&& op)
+    {
+        auto histogram = std::make_unique<Histogram>();
+        for (int i = 0; i < 10; i++)
+            op();
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+        for (;;) {
+            auto start = std::chrono::steady_clock::now();
+            op();
+            auto end = std::chrono::steady_clock::now();
+            histogram->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / batch);
+            if (end > deadline)
+                break;
+        }
+        histogram->Read(result);
+    }
+
+    void PrintRow(const char* name, int trackers, int history, const std::string& filter, const Histogram::Snapshot& snapshot)
+    {
+        std::printf("%s,%d,%d,%s,%llu,%.1f,%.1f,%.1f,%.1f,%.1f\n", name, trackers, history, filter.c_str(),
+            (unsigned long long)snapshot.count, snapshot.Mean(), snapshot.Percentile(0.5), snapshot.Percentile(0.9),
+            snapshot.Percentile(0.99), snapshot.Max());
+        std::fflush(stdout);
+    }
+
+    bool Exchange(IConnection& connection, const std::string& message, std::string& reply)
+    {
+        char buffer[kMaxMessageSize];
+        if (!connection.Send(message.data(), message.size()))
+            return false;
+        int length = connection.Receive(buffer, sizeof(buffer) - 1);
+        if (length < 0)
+            return false;
+        buffer[length] = '\0';
+        reply = buffer;
+        return true;
+    }
+
+    // A tracker walking in a circle, sampled at time t
+    void SamplePose(int tracker, double t, double pose[])
+    {
+        double angle = t + tracker;
+        pose[0] = 0.5 * std::cos(angle);
+        pose[1] = 1.0 + 0.01 * tracker;
+        pose[2] = 0.5 * std::sin(angle);
+        pose[3] = std::cos(angle / 2);
+        pose[4] = 0;
+        pose[5] = std::sin(angle / 2);
+        pose[6] = 0;
+    }
+
+    // One camera's observation of the tracker in the fusion simulation
+    struct Observation {
+        uint32_t camera;
+        double pose[7];
+        double capture;
+        double receive;
+    };
+
+    // Runs in simulated time, so the result does not depend on the machine or on --time
+    void RunFusionAccuracy(const Options& options)
+    {
+        const double duration = 30;
+        const double settle = 2;                                    // not measured while the filter fills up
+        const double camera_period = 1.0 / 30;
+        const double frame_period = 1.0 / 90;
+        const double window = 0.025;                                // s, the fusion_window the README suggests
+        const double noise[] = { 0.003, 0.005, 0.008, 0.012 };      // m per axis, the cameras are not equally good
+        const double calibration = 0.005;                           // m per axis, how far each camera's view is off as a whole
+        const int max_cameras = 4;
+        const double outlier_rates[] = { 0, 0.05 };
+
+        std::printf("fusion,cameras,outliers,filter,mode,samples,rms_mm,p90_mm,max_mm,jitter_mm\n");
+        for (const std::string& filter : options.filters) {
+            PoseFilterType type;
+            if (!ParsePoseFilterType(filter, type)) {
+                std::fprintf(stderr, "unknown filter %s\n", filter.c_str());
+                continue;
+            }
+
+            for (int cameras = 1; cameras <= max_cameras; cameras++) {
+                for (double outliers : outlier_rates) {
+                    //every camera runs at its own phase and latency, an outlier is a misdetection 10 to 30 cm off
+                    std::mt19937 random(cameras * 1000 + int(outliers * 100));
+                    std::uniform_real_distribution<double> uniform(0, 1);
+                    std::normal_distribution<double> gaussian(0, 1);
+                    std::vector<Observation> observations;
+                    for (int camera = 0; camera < cameras; camera++) {
+                        double phase = uniform(random) * camera_period;
+                        double latency = 0.01 + 0.003 * camera;
+                        double bias[3];
+                        for (int i = 0; i < 3; i++)
+                            bias[i] = calibration * gaussian(random);
+                        for (double t = phase; t < duration; t += camera_period) {
+                            //camera ids start at 1, 0 names no camera and is never fused
+                            Observation observation{};
+                            observation.camera = camera + 1;
+                            SamplePose(0, t, observation.pose);
+                            for (int i = 0; i < 3; i++)
+                                observation.pose[i] += bias[i] + noise[camera] * gaussian(random);
+                            if (uniform(random) < outliers) {
+                                double offset = 0.1 + 0.2 * uniform(random);
+                                observation.pose[uniform(random) < 0.5 ? 0 : 2] += uniform(random) < 0.5 ? offset : -offset;
+                            }
+                            observation.capture = t;
+                            observation.receive = t + latency;
+                            observations.push_back(observation);
+                        }
+                    }
+                    std::sort(observations.begin(), observations.end(), [](const Observation& a, const Observation& b) { return a.receive < b.receive; });
+
+                    //raw is what the driver did before fusion: every sample into the filter, window 0 passes them straight through
+                    for (bool fused : { false, true }) {
+                        PoseHistory history;
+                        history.filter = type;
+                        history.regression.Configure(10);
+                        PoseFusion fusion;
+                        fusion.Configure(fused ? window : 0);
+
+                        //the same checks as TrackerDevice::store_pose
+                        auto store = [&](const PoseFusion::Sample& sample, double now) {
+                            IPoseFilter& filter = history.Filter();
+                            filter.Expire(now - history.max_time);
+                            double predicted[7];
+                            double dx = 0, dy = 0, dz = 0;
+                            if (filter.Predict(sample.time, predicted)) {
+                                dx = predicted[0] - sample.pose[0];
+                                dy = predicted[1] - sample.pose[1];
+                                dz = predicted[2] - sample.pose[2];
+                            }
+                            if (std::sqrt(dx * dx + dy * dy + dz * dz) <= 0.5)
+                                filter.AddSample(sample.time, sample.pose);
+                        };
+
+                        auto histogram = std::make_unique<Histogram>();
+                        double squares = 0;
+                        double jitter_squares = 0;
+                        double last_error[3];
+                        bool first = true;
+                        size_t next = 0;
+                        PoseFusion::Sample samples[2];
+                        for (double now = 0; now < duration; now += frame_period) {
+                            for (; next < observations.size() && observations[next].receive <= now; next++) {
+                                const Observation& observation = observations[next];
+                                int count = fusion.Add(observation.camera, observation.pose, observation.capture, observation.receive, history.Filter(), samples);
+                                for (int i = 0; i < count; i++)
+                                    store(samples[i], observation.receive);
+                            }
+                            if (fusion.Flush(now, frame_period, history.Filter(), samples[0]))
+                                store(samples[0], now);
+
+                            double pose[7];
+                            double truth[7];
+                            if (now < settle || !history.Filter().Predict(now, pose))
+                                continue;
+                            SamplePose(0, now, truth);
+                            double error[3];
+                            for (int i = 0; i < 3; i++)
+                                error[i] = pose[i] - truth[i];
+                            double distance = std::sqrt(error[0] * error[0] + error[1] * error[1] + error[2] * error[2]);
+                            squares += distance * distance;
+                            histogram->Record((int64_t)(distance * 1e6));      // um, the histogram counts integers
+
+                            //jitter is how much the error changes from one frame to the next, what shows as shaking
+                            double dx = first ? 0 : error[0] - last_error[0];
+                            double dy = first ? 0 : error[1] - last_error[1];
+                            double dz = first ? 0 : error[2] - last_error[2];
+                            if (!first)
+                                jitter_squares += dx * dx + dy * dy + dz * dz;
+                            for (int i = 0; i < 3; i++)
+                                last_error[i] = error[i];
+                            first = false;
+                        }
+
+                        Histogram::Snapshot result;
+                        histogram->Read(result);
+                        uint64_t count = std::max<uint64_t>(1, result.count);
+                        std::printf("fusion,%d,%.2f,%s,%s,%llu,%.2f,%.2f,%.2f,%.2f\n", cameras, outliers, filter.c_str(), fused ? "fused" : "raw",
+                            (unsigned long long)result.count, std::sqrt(squares / count) * 1000, result.Percentile(0.9) / 1000,
+                            result.Max() / 1000, std::sqrt(jitter_squares / count) * 1000);
+                        std::fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    // One pose sample of a tracker as the driver received it, for --replay
+    struct ReplaySample {
+        uint32_t tracker;
+        double pose[7];
+        double capture;     // session seconds
+        double receive;
+    };
+
+    void AddReplaySample(std::vector<ReplaySample>& samples, uint32_t tracker, const double position[], const double rotation[], double capture, double receive)
+    {
+        ReplaySample sample{};
+        sample.tracker = tracker;
+        for (int i = 0; i < 3; i++)
+            sample.pose[i] = position[i];
+        for (int i = 0; i < 4; i++)
+            sample.pose[3 + i] = rotation[i];
+        sample.capture = capture;
+        sample.receive = receive;
+        samples.push_back(sample);
+    }
+
+    // Pulls the pose samples out of one pipe message, text or binary, received at time
+    void ParseReplayMessage(const std::string& message, double time, std::vector<ReplaySample>& samples)
+    {
+        if (Protocol::IsBinaryMessage(message.data(), message.size())) {
+            Protocol::Header header = Protocol::DecodeHeader(message.data(), message.size());
+            if (header.type == Protocol::MessageType::UpdatePose || header.type == Protocol::MessageType::UpdatePoseAt) {
+                Protocol::UpdatePoseMessage update;
+                if (!Protocol::Decode(message.data(), message.size(), update))
+                    return;
+                double capture = header.type == Protocol::MessageType::UpdatePoseAt ? update.time : time - std::abs(update.time);
+                AddReplaySample(samples, update.idx, update.position, update.rotation, capture, time);
+            }
+            else if (header.type == Protocol::MessageType::UpdatePoseBatch) {
+                Protocol::UpdatePoseBatchMessage batch;
+                if (!Protocol::DecodeBatch(message.data(), message.size(), batch))
+                    return;
+                for (uint32_t i = 0; i < batch.count; i++) {
+                    const Protocol::PoseSample& sample = batch.samples[i];
+                    AddReplaySample(samples, sample.idx, sample.position, sample.rotation, time - std::abs(sample.time), time);
+                }
+            }
+            return;
+        }
+
+        std::istringstream iss(message);
+        std::string word;
+        iss >> word;
+        uint32_t count = 1;
+        if (word == "updateposes")
+            iss >> count;
+        else if (word != "updatepose" && word != "updateposeat")
+            return;
+
+        for (uint32_t i = 0; i < count && i < Protocol::kMaxBatchSize; i++) {
+            uint32_t idx;
+            double position[3], rotation[4], value;
+            iss >> idx >> position[0] >> position[1] >> position[2] >> rotation[0] >> rotation[1] >> rotation[2] >> rotation[3] >> value;
+            if (!iss)
+                return;
+            //updateposeat carries the absolute capture time in ms, the others how long ago the sample was captured
+            double capture = word == "updateposeat" ? value / 1000 : time - std::abs(value);
+            AddReplaySample(samples, idx, position, rotation, capture, time);
+        }
+    }
+
+    // Reads a session recording, or a driver_runner text trace if the file is not one
+    bool LoadReplay(const std::string& path, std::vector<ReplaySample>& samples)
+    {
+        Recording::Reader reader;
+        if (reader.Open(path)) {
+            Recording::Reader::Record record;
+            while (reader.Next(record)) {
+                if (record.header->type == Recording::RecordType::Message)
+                    ParseReplayMessage(std::string(record.payload, record.header->size), record.header->time, samples);
+            }
+            return true;
+        }
+
+        std::ifstream trace(path);
+        if (!trace)
+            return false;
+        std::string line;
+        while (std::getline(trace, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            size_t space = line.find(' ');
+            if (line.empty() || line[0] == '#' || space == std::string::npos)
+                continue;
+            ParseReplayMessage(line.substr(space + 1), std::atof(line.substr(0, space).c_str()), samples);
+        }
+        return true;
+    }
+
+    // Without a file: two trackers seen by a 30 Hz camera with 2 mm of noise, a frame of timing jitter and 20 ms of latency
+    void MakeReplaySamples(std::vector<ReplaySample>& samples)
+    {
+        std::mt19937 random(7);
+        std::normal_distribution<double> gaussian(0, 1);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        for (double t = 0; t < 60; t += 1.0 / 30) {
+            for (uint32_t tracker = 0; tracker < 2; tracker++) {
+                ReplaySample sample{};
+                sample.tracker = tracker;
+                sample.capture = t + 0.004 * uniform(random);
+                SamplePose(int(tracker), sample.capture, sample.pose);
+                for (int i = 0; i < 3; i++)
+                    sample.pose[i] += 0.002 * gaussian(random);
+                sample.receive = sample.capture + 0.02;
+                samples.push_back(sample);
+            }
+        }
+    }
+
+    // Where the samples put the tracker at time, interpolated between the two captured around it
+    bool SampledPosition(const std::vector<ReplaySample>& samples, double time, double position[])
+    {
+        auto next = std::upper_bound(samples.begin(), samples.end(), time, [](double t, const ReplaySample& sample) { return t < sample.capture; });
+        if (next == samples.begin() || next == samples.end())
+            return false;
+        const ReplaySample& before = *(next - 1);
+        double span = next->capture - before.capture;
+        double f = span > 0 ? (time - before.capture) / span : 0;
+        for (int i = 0; i < 3; i++)
+            position[i] = before.pose[i] + f * (next->pose[i] - before.pose[i]);
+        return true;
+    }
+
+    // Replays recorded samples through every filter in simulated time: the samples are stored as they were received
+    // and a pose is predicted every 90 Hz frame, like RunFrame does. Only positions are compared.
+    //   jitter_mm   rms of the second difference of the posted positions, what shows as shaking
+    //   lag_ms      how far the posted path trails the sampled one, the shift that brings them closest (negative: ahead)
+    //   error_mm    rms distance of the posted positions from the sampled path at that shift, noise of the samples included
+    //   add_ns, predict_ns   CPU time of IPoseFilter::AddSample and Predict
+    void RunReplay(const Options& options)
+    {
+        std::vector<ReplaySample> all;
+        if (options.replay_file.empty()) {
+            MakeReplaySamples(all);
+        }
+        else if (!LoadReplay(options.replay_file, all)) {
+            std::fprintf(stderr, "could not read %s\n", options.replay_file.c_str());
+            return;
+        }
+
+        std::map<uint32_t, std::vector<ReplaySample>> trackers;
+        for (const ReplaySample& sample : all)
+            trackers[sample.tracker].push_back(sample);
+
+        const double frame_period = 1.0 / 90;
+        std::printf("replay,tracker,history,filter,samples,frames,jitter_mm,lag_ms,error_mm,add_ns,predict_ns\n");
+        for (auto& [tracker, received] : trackers) {
+            std::vector<ReplaySample> captured = received;
+            std::stable_sort(captured.begin(), captured.end(), [](const ReplaySample& a, const ReplaySample& b) { return a.capture < b.capture; });
+
+            for (int history_size : options.history) {
+                for (const std::string& filter : options.filters) {
+                    PoseFilterType type;
+                    if (!ParsePoseFilterType(filter, type)) {
+                        std::fprintf(stderr, "unknown filter %s\n", filter.c_str());
+                        continue;
+                    }
+
+                    PoseHistory history;
+                    history.filter = type;
+                    history.regression.Configure(history_size);
+                    IPoseFilter& motion = history.Filter();
+                    auto add_time = std::make_unique<Histogram>();
+                    auto predict_time = std::make_unique<Histogram>();
+
+                    //posted positions, a frame without a prediction breaks the run the jitter is taken over
+                    std::vector<double> frames;
+                    std::vector<std::array<double, 3>> posted;
+                    double jitter_squares = 0;
+                    uint64_t jitter_count = 0;
+                    size_t next = 0;
+                    double start = received.front().receive;
+                    double end = received.back().receive;
+                    for (double now = start; now <= end; now += frame_period) {
+                        for (; next < received.size() && received[next].receive <= now; next++) {
+                            const ReplaySample& sample = received[next];
+                            //the same checks as TrackerDevice::store_pose
+                            motion.Expire(sample.receive - history.max_time);
+                            double predicted[7];
+                            double dx = 0, dy = 0, dz = 0;
+                            if (motion.Predict(sample.capture, predicted)) {
+                                dx = predicted[0] - sample.pose[0];
+                                dy = predicted[1] - sample.pose[1];
+                                dz = predicted[2] - sample.pose[2];
+                            }
+                            if (std::sqrt(dx * dx + dy * dy + dz * dz) > 0.5)
+                                continue;
+                            auto before = std::chrono::steady_clock::now();
+                            motion.AddSample(sample.capture, sample.pose);
+                            add_time->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count());
+                        }
+
+                        double pose[7];
+                        auto before = std::chrono::steady_clock::now();
+                        bool predicted = motion.Predict(now, pose);
+                        predict_time->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count());
+                        frames.push_back(now);
+                        if (!predicted) {
+                            posted.push_back({ NAN, NAN, NAN });
+                            continue;
+                        }
+                        posted.push_back({ pose[0], pose[1], pose[2] });
+
+                        size_t n = posted.size();
+                        if (n >= 3 && !std::isnan(posted[n - 2][0]) && !std::isnan(posted[n - 3][0])) {
+                            for (int i = 0; i < 3; i++) {
+                                double second = posted[n - 1][i] - 2 * posted[n - 2][i] + posted[n - 3][i];
+                                jitter_squares += second * second;
+                            }
+                            jitter_count++;
+                        }
+                    }
+
+                    //try every shift from 100 ms ahead to 300 ms behind, in steps of 1 ms
+                    int best_lag = 0;
+                    double best_error = INFINITY;
+                    for (int lag = -100; lag <= 300; lag++) {
+                        double squares = 0;
+                        uint64_t count = 0;
+                        for (size_t i = 0; i < frames.size(); i++) {
+                            double position[3];
+                            if (std::isnan(posted[i][0]) || !SampledPosition(captured, frames[i] - lag / 1000.0, position))
+                                continue;
+                            for (int j = 0; j < 3; j++)
+                                squares += (posted[i][j] - position[j]) * (posted[i][j] - position[j]);
+                            count++;
+                        }
+                        if (count > 0 && squares / count < best_error) {
+                            best_error = squares / count;
+                            best_lag = lag;
+                        }
+                    }
+
+                    Histogram::Snapshot add_result;
+                    Histogram::Snapshot predict_result;
+                    add_time->Read(add_result);
+                    predict_time->Read(predict_result);
+                    std::printf("replay,%u,%d,%s,%zu,%zu,%.3f,%d,%.2f,%.1f,%.1f\n", tracker, history_size, filter.c_str(), received.size(),
+                        frames.size(), std::sqrt(jitter_squares / std::max<uint64_t>(1, jitter_count)) * 1000, best_lag,
+                        std::sqrt(best_error) * 1000, add_result.Mean(), predict_result.Mean());
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<TrackerDevice>> GetTrackers()
+    {
+        std::vector<std::shared_ptr<TrackerDevice>> trackers;
+        for (auto& device : GetDriver()->GetDevices()) {
+            if (device->GetDeviceType() == DeviceType::TRACKER)
+                trackers.push_back(std::static_pointer_cast<TrackerDevice>(device));
+        }
+        return trackers;
+    }
+
+    // Every client thread updates its own share of the trackers, so they only meet in the driver
+    void RunConcurrentClients(const Options& options, IConnection& connection, vr::IServerTrackedDeviceProvider* provider)
+    {
+        std::string reply;
+        std::printf("clients,trackers,history,filter,updates_per_s,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+        for (int tracker_count : options.trackers) {
+            while ((int)GetTrackers().size() < tracker_count)
+                Exchange(connection, "addtracker benchmark_" + std::to_string(GetTrackers().size()) + " TrackerRole_Waist", reply);
+
+            for (int history : options.history) {
+                for (const std::string& filter : options.filters) {
+                    if (!Exchange(connection, "settings " + std::to_string(history) + " 1000 0 " + filter, reply) || reply.find("changed") == std::string::npos) {
+                        std::fprintf(stderr, "could not set up %s with %d samples: %s\n", filter.c_str(), history, reply.c_str());
+                        return;
+                    }
+
+                    for (int client_count : options.clients) {
+                        std::vector<std::unique_ptr<ApriltagClient::Client>> clients;
+                        for (int i = 0; i < client_count; i++) {
+                            clients.push_back(std::make_unique<ApriltagClient::Client>());
+                            if (!clients.back()->Connect()) {
+                                std::fprintf(stderr, "client %d could not connect to the driver\n", i);
+                                return;
+                            }
+                        }
+
+                        auto histogram = std::make_unique<Histogram>();
+                        std::atomic<bool> running{ true };
+                        std::atomic<uint64_t> updates{ 0 };
+                        std::thread frames([&]() {
+                            auto next = std::chrono::steady_clock::now();
+                            while (running.load(std::memory_order_relaxed)) {
+                                provider->RunFrame();
+                                next += std::chrono::microseconds(11111);
+                                std::this_thread::sleep_until(next);
+                            }
+                        });
+
+                        auto start = std::chrono::steady_clock::now();
+                        std::vector<std::thread> threads;
+                        for (int c = 0; c < client_count; c++) {
+                            threads.emplace_back([&, c]() {
+                                double pose[7];
+                                ApriltagClient::Pose client_pose;
+                                uint64_t count = 0;
+                                int tracker = c % tracker_count;
+                                while (running.load(std::memory_order_relaxed)) {
+                                    auto sent = std::chrono::steady_clock::now();
+                                    SamplePose(tracker, std::chrono::duration<double>(sent - start).count(), pose);
+                                    std::memcpy(&client_pose, pose, sizeof(client_pose));
+                                    clients[c]->UpdatePose(tracker, client_pose, 0);
+                                    histogram->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sent).count());
+                                    count++;
+                                    tracker = (tracker + client_count) % tracker_count;
+                                }
+                                updates.fetch_add(count, std::memory_order_relaxed);
+                            });
+                        }
+
+                        std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+                        running = false;
+                        for (std::thread& thread : threads)
+                            thread.join();
+                        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                        frames.join();
+                        for (auto& client : clients)
+                            client->Disconnect();
+
+                        Histogram::Snapshot result;
+                        histogram->Read(result);
+                        std::printf("%d,%d,%d,%s,%.0f,%.1f,%.1f,%.1f,%.1f,%.1f\n", client_count, tracker_count, history, filter.c_str(),
+                            updates.load() / elapsed, result.Mean(), result.Percentile(0.5), result.Percentile(0.9),
+                            result.Percentile(0.99), result.Max());
+                        std::fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // Kept alive to the very end: the driver's pipe threads are never joined
+    static DriverRunner::MockDriverContext context;
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--trackers" && has_value)
+            options.trackers = ParseList<int>(argv[++i]);
+        else if (arg == "--history" && has_value)
+            options.history = ParseList<int>(argv[++i]);
+        else if (arg == "--filters" && has_value)
+            options.filters = ParseList<std::string>(argv[++i]);
+        else if (arg == "--time" && has_value)
+            options.seconds = std::atof(argv[++i]) / 1000;
+        else if (arg == "--fusion")
+            options.fusion = true;
+        else if (arg == "--clients" && has_value)
+            options.clients = ParseList<int>(argv[++i]);
+        else if (arg == "--replay") {
+            options.replay = true;
+            if (has_value && std::strncmp(argv[i + 1], "--", 2) != 0)
+                options.replay_file = argv[++i];
+        }
+        else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    std::sort(options.trackers.begin(), options.trackers.end());
+    if (options.trackers.empty() || options.trackers.front() < 1 || options.history.empty() || options.filters.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    // Needs no driver, the fusion and the filters run on their own in simulated time
+    if (options.fusion) {
+        RunFusionAccuracy(options);
+        return 0;
+    }
+    if (options.replay) {
+        RunReplay(options);
+        return 0;
+    }
+
+    int error = vr::VRInitError_None;
+    auto provider = static_cast<vr::IServerTrackedDeviceProvider*>(HmdDriverFactory(vr::IServerTrackedDeviceProvider_Version, &error));
+    if (provider == nullptr || provider->Init(&context) != vr::VRInitError_None) {
+        std::fprintf(stderr, "driver failed to initialize\n");
+        return 1;
+    }
+
+    std::unique_ptr<IConnection> connection;
+    for (int attempt = 0; attempt < 50 && connection == nullptr; attempt++) {
+        connection = ConnectTransport("ApriltagPipeIn");
+        if (connection == nullptr)
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    ApriltagClient::Client client;
+    if (connection == nullptr || !client.Connect()) {
+        std::fprintf(stderr, "could not connect to the driver\n");
+        return 1;
+    }
+
+    if (!options.clients.empty()) {
+        RunConcurrentClients(options, *connection, provider);
+        client.Disconnect();
+        connection.reset();
+        provider->Cleanup();
+        std::fflush(stdout);
+        std::_Exit(0);
+    }
+
+    std::printf("benchmark,trackers,history,filter,samples,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+
+    Histogram::Snapshot result;
+    std::string reply;
+    double pose[7];
+
+    // Does not depend on the trackers, runs once
+    {
+        vr::HmdMatrix34_t matrices[64];
+        for (int i = 0; i < 64; i++) {
+            double angle = i * 0.1;
+            matrices[i] = {};
+            matrices[i].m[0][0] = (float)std::cos(angle);
+            matrices[i].m[0][2] = (float)std::sin(angle);
+            matrices[i].m[1][1] = 1;
+            matrices[i].m[2][0] = (float)-std::sin(angle);
+            matrices[i].m[2][2] = (float)std::cos(angle);
+        }
+        volatile double sink = 0;
+        Measure(options.seconds, 1024, result, [&]() {
+            double sum = 0;
+            for (int i = 0; i < 1024; i++)
+                sum += VRDriver::GetRotation(matrices[i & 63]).w;
+            sink = sink + sum;
+        });
+        PrintRow("get_rotation", 0, 0, "-", result);
+    }
+
+    // The ring on its own, the cost of keeping samples sorted and the sums current at every history size
+    for (int history : options.history) {
+        SampleRing ring(history);
+        double t = 0;
+        Measure(options.seconds, 256, result, [&]() {
+            for (int i = 0; i < 256; i++) {
+                t += 1 / 120.0;
+                SamplePose(0, t, pose);
+                ring.Insert(t, pose);
+            }
+        });
+        PrintRow("ring_insert", 1, history, "-", result);
+
+        int behind = std::max(1, history / 4);
+        Measure(options.seconds, 256, result, [&]() {
+            for (int i = 0; i < 256; i++) {
+                t += 1 / 120.0;
+                SamplePose(0, t, pose);
+                ring.Insert(t - behind / 120.0 - 1 / 240.0, pose);
+            }
+        });
+        PrintRow("ring_insert_late", 1, history, "-", result);
+    }
+
+    // Trackers can not be removed, so counts only go up and RunFrame always sees exactly the current count
+    for (int tracker_count : options.trackers) {
+        while ((int)GetTrackers().size() < tracker_count)
+            Exchange(*connection, "addtracker benchmark_" + std::to_string(GetTrackers().size()) + " TrackerRole_Waist", reply);
+        auto trackers = GetTrackers();
+
+        for (int history : options.history) {
+            for (const std::string& filter : options.filters) {
+                // Long max time, the history is never emptied by the clock while a case runs
+                if (!Exchange(*connection, "settings " + std::to_string(history) + " 1000 0 " + filter, reply) || reply.find("changed") == std::string::npos) {
+                    std::fprintf(stderr, "could not set up %s with %d samples: %s\n", filter.c_str(), history, reply.c_str());
+                    return 1;
+                }
+
+                // Fill every history, samples 1/120 s apart and the newest now
+                for (int t = 0; t < tracker_count; t++) {
+                    for (int i = history - 1; i >= 0; i--) {
+                        SamplePose(t, -i / 120.0, pose);
+                        trackers[t]->save_current_pose(pose[0], pose[1], pose[2], pose[3], pose[4], pose[5], pose[6], i / 120.0);
+                    }
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+                // The driver times message handling itself, only the part under the command lock
+                Histogram::Snapshot before, after;
+                Telemetry::Get().message_handling.Read(before);
+                int next_tracker = 0;
+                Measure(options.seconds, 1, result, [&]() {
+                    SamplePose(next_tracker, elapsed(), pose);
+                    char message[256];
+                    std::snprintf(message, sizeof(message), "updatepose %d %f %f %f %f %f %f %f 0", next_tracker,
+                        pose[0], pose[1], pose[2], pose[3], pose[4], pose[5], pose[6]);
+                    Exchange(*connection, message, reply);
+                    next_tracker = (next_tracker + 1) % tracker_count;
+                });
+                Telemetry::Get().message_handling.Read(after);
+                PrintRow("parse", tracker_count, history, filter, after - before);
+                PrintRow("pipe_roundtrip", tracker_count, history, filter, result);
+
+                // The same update in the binary encoding, on the same connection so only the encoding differs
+                Protocol::UpdatePoseMessage binary{};
+                binary.header = Protocol::MakeHeader(Protocol::MessageType::UpdatePose);
+                Telemetry::Get().message_handling.Read(before);
+                Measure(options.seconds, 1, result, [&]() {
+                    SamplePose(next_tracker, elapsed(), pose);
+                    binary.idx = next_tracker;
+                    std::memcpy(binary.position, pose, sizeof(binary.position));
+                    std::memcpy(binary.rotation, pose + 3, sizeof(binary.rotation));
+                    char buffer[256];
+                    connection->Send(reinterpret_cast<const char*>(&binary), sizeof(binary));
+                    connection->Receive(buffer, sizeof(buffer));
+                    next_tracker = (next_tracker + 1) % tracker_count;
+                });
+                Telemetry::Get().message_handling.Read(after);
+                PrintRow("parse_binary", tracker_count, history, filter, after - before);
+                PrintRow("binary_roundtrip", tracker_count, history, filter, result);
+
+                ApriltagClient::Pose client_pose;
+                Measure(options.seconds, 1, result, [&]() {
+                    SamplePose(next_tracker, elapsed(), pose);
+                    std::memcpy(&client_pose, pose, sizeof(client_pose));
+                    client.UpdatePose(next_tracker, client_pose, 0);
+                    next_tracker = (next_tracker + 1) % tracker_count;
+                });
+                PrintRow("client_update", tracker_count, history, filter, result);
+
+                Measure(options.seconds, 256, result, [&]() {
+                    for (int i = 0; i < 256; i++) {
+                        SamplePose(next_tracker, elapsed(), pose);
+                        std::memcpy(&client_pose, pose, sizeof(client_pose));
+                        client.UpdatePoseAsync(next_tracker, client_pose, 0);
+                        next_tracker = (next_tracker + 1) % tracker_count;
+                    }
+                    client.Flush();
+                });
+                PrintRow("client_async", tracker_count, history, filter, result);
+
+                // A query at the end waits until the driver went through every update before it
+                Measure(options.seconds, 256, result, [&]() {
+                    for (int i = 0; i < 256; i++) {
+                        SamplePose(next_tracker, elapsed(), pose);
+                        std::memcpy(&client_pose, pose, sizeof(client_pose));
+                        client.SendPose(next_tracker, client_pose, 0);
+                        next_tracker = (next_tracker + 1) % tracker_count;
+                    }
+                    client.GetTrackerPose(0, 0, client_pose);
+                });
+                PrintRow("client_send", tracker_count, history, filter, result);
+
+                std::vector<ApriltagClient::PoseSample> samples(tracker_count);
+                Measure(options.seconds, tracker_count, result, [&]() {
+                    double t = elapsed();
+                    for (int i = 0; i < tracker_count; i++) {
+                        SamplePose(i, t, pose);
+                        samples[i].idx = i;
+                        std::memcpy(samples[i].position, pose, sizeof(samples[i].position));
+                        std::memcpy(samples[i].rotation, pose + 3, sizeof(samples[i].rotation));
+                        samples[i].time = 0;
+                    }
+                    client.UpdatePoses(samples.data(), samples.size());
+                });
+                PrintRow("client_batch", tracker_count, history, filter, result);
+
+                Measure(options.seconds, tracker_count, result, [&]() {
+                    double t = elapsed();
+                    for (int i = 0; i < tracker_count; i++) {
+                        SamplePose(i, t, pose);
+                        trackers[i]->save_current_pose(pose[0], pose[1], pose[2], pose[3], pose[4], pose[5], pose[6], 0);
+                    }
+                });
+                PrintRow("save", tracker_count, history, filter, result);
+
+                Measure(options.seconds, tracker_count, result, [&]() {
+                    for (int i = 0; i < tracker_count; i++)
+                        trackers[i]->get_next_pose(0, pose);
+                });
+                PrintRow("predict", tracker_count, history, filter, result);
+
+                Measure(options.seconds, tracker_count, result, [&]() {
+                    for (int i = 0; i < tracker_count; i++)
+                        trackers[i]->Update();
+                });
+                PrintRow("update", tracker_count, history, filter, result);
+
+                Measure(options.seconds, 1, result, [&]() {
+                    provider->RunFrame();
+                });
+                PrintRow("run_frame", tracker_count, history, filter, result);
+            }
+        }
+    }
+
+    client.Disconnect();
+    connection.reset();
+    provider->Cleanup();
+
+    // The pipe server thread blocks in Accept for good, leave without running static destructors underneath it
+    std::fflush(stdout);
+    std::_Exit(0);
+}
@@ -0,0 +1,573 @@
+#include "ApriltagClient.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Protocol = ExampleDriver::Protocol;
+
+namespace {
+
+    // Text replies are the command's words followed by "  OK". Skips the leading space and checks the first word.
+    const char* SkipWord(const char* reply, const char* word)
+    {
+        while (*reply == ' ')
+            reply++;
+        size_t length = std::strlen(word);
+        if (std::strncmp(reply, word, length) != 0 || (reply[length] != ' ' && reply[length] != '\0'))
+            return nullptr;
+        return reply + length;
+    }
+
+    // Batch replies only carry count statuses, so they are shorter than BatchStatusReply and Protocol::Decode can not take them
+    bool DecodeBatchReply(const char* data, int length, Protocol::BatchStatusReply& out)
+    {
+        if (length < (int)Protocol::BatchReplySize(0))
+            return false;
+        std::memcpy(&out, data, Protocol::BatchReplySize(0));
+        if (out.header.type != Protocol::MessageType::BatchStatusReply || out.count > Protocol::kMaxBatchSize
+            || length < (int)Protocol::BatchReplySize(out.count))
+            return false;
+        std::memcpy(out.status, data + Protocol::BatchReplySize(0), out.count);
+        return true;
+    }
+
+    // Tracker poses come back as a TrackerPoseReply, errors decoding the request as a plain StatusReply
+    ApriltagClient::Status DecodeTrackerPose(const char* data, int length, ApriltagClient::Pose& pose, int* prediction_status)
+    {
+        Protocol::TrackerPoseReply reply;
+        if (!Protocol::Decode(data, length, reply))
+        {
+            Protocol::StatusReply status;
+            return Protocol::Decode(data, length, status) ? status.status : ApriltagClient::Status::Malformed;
+        }
+        if (reply.status == ApriltagClient::Status::Updated)
+        {
+            std::memcpy(pose.position, reply.pose, sizeof(pose.position));
+            std::memcpy(pose.rotation, reply.pose + 3, sizeof(pose.rotation));
+            if (prediction_status != nullptr)
+                *prediction_status = reply.prediction_status;
+        }
+        return reply.status;
+    }
+
+    // Reads count numbers, false if any is missing
+    bool ReadNumbers(const char* text, double* out, int count)
+    {
+        for (int i = 0; i < count; i++) {
+            char* end;
+            out[i] = std::strtod(text, &end);
+            if (end == text)
+                return false;
+            text = end;
+        }
+        return true;
+    }
+}
+
+bool ApriltagClient::Client::Connect(const char* name, int timeout_ms)
+{
+    Disconnect();
+    this->connection_ = ExampleDriver::ConnectTransport(name, timeout_ms);
+    if (this->connection_ == nullptr)
+        return false;
+
+    Protocol::HandshakeMessage handshake{ NextHeader(Protocol::MessageType::Handshake), Protocol::kVersion };
+    Protocol::HandshakeReply reply;
+    if (!Request(&handshake, sizeof(handshake)) || !Protocol::Decode(this->reply_, this->reply_length_, reply)
+        || reply.header.type != Protocol::MessageType::HandshakeReply || reply.driver_version != Protocol::kVersion)
+    {
+        Disconnect();
+        return false;
+    }
+    return true;
+}
+
+void ApriltagClient::Client::Disconnect()
+{
+    this->connection_.reset();
+    this->in_flight_ = 0;
+    for (PendingQuery& query : this->queries_)
+        query = PendingQuery();
+    //the driver ends the subscription with the connection
+    this->shared_memory_.Close();
+    this->subscribed_devices_ = 0;
+    this->clock_synced_ = false;
+}
+
+void ApriltagClient::Client::Fail()
+{
+    //a broken connection stays broken, the app reconnects when it wants to
+    Disconnect();
+}
+
+ExampleDriver::Protocol::Header ApriltagClient::Client::NextHeader(Protocol::MessageType type, uint32_t flags)
+{
+    //0 is left out, it marks free query slots
+    if (++this->next_request_id_ == 0)
+        this->next_request_id_ = 1;
+    return Protocol::MakeHeader(type, this->next_request_id_, flags);
+}
+
+ExampleDriver::Protocol::UpdatePoseMessage ApriltagClient::Client::PoseMessage(Protocol::MessageType type, uint32_t idx, const Pose& pose, double time, uint32_t flags)
+{
+    Protocol::UpdatePoseMessage message{};
+    message.header = NextHeader(type, flags);
+    message.idx = idx;
+    message.source = this->source_;
+    std::memcpy(message.position, pose.position, sizeof(message.position));
+    std::memcpy(message.rotation, pose.rotation, sizeof(message.rotation));
+    message.time = time;
+    message.smoothing = 0;
+    return message;
+}
+
+void ApriltagClient::Client::CopySamples(Protocol::UpdatePoseBatchMessage& message, const PoseSample* samples) const
+{
+    std::memcpy(message.samples, samples, message.count * sizeof(PoseSample));
+    for (uint32_t i = 0; i < message.count; i++)
+    {
+        if (message.samples[i].source == 0)
+            message.samples[i].source = this->source_;
+    }
+}
+
+double ApriltagClient::Client::ToDriverTime(double capture_time) const
+{
+    return capture_time + this->clock_offset_ + this->clock_drift_ * (capture_time - this->clock_reference_);
+}
+
+bool ApriltagClient::Client::Request(const void* message, size_t length)
+{
+    if (!Flush())
+        return false;
+    if (!this->connection_->Send(static_cast<const char*>(message), length))
+    {
+        Fail();
+        return false;
+    }
+    this->reply_length_ = this->connection_->Receive(this->reply_, sizeof(this->reply_) - 1);
+    if (this->reply_length_ < 0)
+    {
+        Fail();
+        return false;
+    }
+    this->reply_[this->reply_length_] = '\0';
+    return true;
+}
+
+bool ApriltagClient::Client::RequestText(const char* command)
+{
+    return Request(command, std::strlen(command));
+}
+
+bool ApriltagClient::Client::AddTracker(const char* name, const char* role)
+{
+    char command[256];
+    std::snprintf(command, sizeof(command), "addtracker %s %s", name, role);
+    return RequestText(command) && SkipWord(this->reply_, "added") != nullptr;
+}
+
+bool ApriltagClient::Client::AddStation()
+{
+    return RequestText("addstation") && SkipWord(this->reply_, "added") != nullptr;
+}
+
+bool ApriltagClient::Client::AddHipMove()
+{
+    //alreadyadded is fine too, the controller exists either way
+    return RequestText("addhipmove") && (SkipWord(this->reply_, "added") != nullptr || SkipWord(this->reply_, "alreadyadded") != nullptr);
+}
+
+int ApriltagClient::Client::NumTrackers()
+{
+    if (!RequestText("numtrackers"))
+        return -1;
+    const char* rest = SkipWord(this->reply_, "numtrackers");
+    double count;
+    if (rest == nullptr || !ReadNumbers(rest, &count, 1))
+        return -1;
+    return (int)count;
+}
+
+ApriltagClient::Status ApriltagClient::Client::UpdatePose(uint32_t idx, const Pose& pose, double age)
+{
+    Protocol::UpdatePoseMessage message = PoseMessage(Protocol::MessageType::UpdatePose, idx, pose, age);
+
+    Protocol::StatusReply reply;
+    if (!Request(&message, sizeof(message)) || !Protocol::Decode(this->reply_, this->reply_length_, reply))
+        return Status::Malformed;
+    return reply.status;
+}
+
+ApriltagClient::Status ApriltagClient::Client::UpdatePoseAt(uint32_t idx, const Pose& pose, double capture_time)
+{
+    //without a clock sync, the best we can do is tell the driver how old the pose is now
+    if (!this->clock_synced_)
+        return UpdatePose(idx, pose, Now() - capture_time);
+
+    Protocol::UpdatePoseMessage message = PoseMessage(Protocol::MessageType::UpdatePoseAt, idx, pose, ToDriverTime(capture_time));
+
+    Protocol::StatusReply reply;
+    if (!Request(&message, sizeof(message)) || !Protocol::Decode(this->reply_, this->reply_length_, reply))
+        return Status::Malformed;
+    return reply.status;
+}
+
+bool ApriltagClient::Client::UpdatePoses(const PoseSample* samples, size_t count, Status* status)
+{
+    Protocol::UpdatePoseBatchMessage message;
+    for (size_t sent = 0; sent < count; sent += message.count)
+    {
+        message.header = NextHeader(Protocol::MessageType::UpdatePoseBatch);
+        message.count = (uint32_t)std::min<size_t>(count - sent, Protocol::kMaxBatchSize);
+        CopySamples(message, samples + sent);
+
+        Protocol::BatchStatusReply reply;
+        if (!Request(&message, Protocol::BatchMessageSize(message.count)))
+            return false;
+        bool valid = DecodeBatchReply(this->reply_, this->reply_length_, reply) && reply.count == message.count;
+        if (status != nullptr)
+        {
+            for (uint32_t i = 0; i < message.count; i++)
+                status[sent + i] = valid ? (Status)reply.status[i] : Status::Malformed;
+        }
+    }
+    return true;
+}
+
+ApriltagClient::Status ApriltagClient::Client::UpdateStation(uint32_t idx, const Pose& pose)
+{
+    Protocol::UpdateStationMessage message{};
+    message.header = NextHeader(Protocol::MessageType::UpdateStation);
+    message.idx = idx;
+    std::memcpy(message.position, pose.position, sizeof(message.position));
+    std::memcpy(message.rotation, pose.rotation, sizeof(message.rotation));
+
+    Protocol::StatusReply reply;
+    if (!Request(&message, sizeof(message)) || !Protocol::Decode(this->reply_, this->reply_length_, reply))
+        return Status::Malformed;
+    return reply.status;
+}
+
+ApriltagClient::Status ApriltagClient::Client::HipMoveInput(float x, float y, float rx, float ry, float a, float b)
+{
+    Protocol::HipMoveInputMessage message{ NextHeader(Protocol::MessageType::HipMoveInput), x, y, rx, ry, a, b };
+
+    Protocol::StatusReply reply;
+    if (!Request(&message, sizeof(message)) || !Protocol::Decode(this->reply_, this->reply_length_, reply))
+        return Status::Malformed;
+    return reply.status;
+}
+
+ApriltagClient::Status ApriltagClient::Client::GetTrackerPose(uint32_t idx, double time_offset, Pose& pose, int* prediction_status)
+{
+    Protocol::GetTrackerPoseMessage message{ NextHeader(Protocol::MessageType::GetTrackerPose), idx, time_offset };
+
+    if (!Request(&message, sizeof(message)))
+        return Status::Malformed;
+    return DecodeTrackerPose(this->reply_, this->reply_length_, pose, prediction_status);
+}
+
+uint32_t ApriltagClient::Client::GetTrackerPoseAsync(uint32_t idx, double time_offset)
+{
+    PendingQuery* query = nullptr;
+    for (PendingQuery& candidate : this->queries_)
+    {
+        if (candidate.request_id == 0)
+        {
+            query = &candidate;
+            break;
+        }
+    }
+    if (query == nullptr)
+        return 0;
+
+    Protocol::GetTrackerPoseMessage message{ NextHeader(Protocol::MessageType::GetTrackerPose), idx, time_offset };
+    if (!SendAsync(&message, sizeof(message)))
+        return 0;
+
+    query->request_id = message.header.request_id;
+    query->done = false;
+    return query->request_id;
+}
+
+ApriltagClient::Status ApriltagClient::Client::WaitTrackerPose(uint32_t request, Pose& pose, int* prediction_status)
+{
+    PendingQuery* query = nullptr;
+    for (PendingQuery& candidate : this->queries_)
+    {
+        if (request != 0 && candidate.request_id == request)
+            query = &candidate;
+    }
+    if (query == nullptr)
+        return Status::Malformed;
+
+    //a failed connection clears every slot, so the request is gone too
+    while (!query->done)
+    {
+        if (this->connection_ == nullptr || !ReceiveAsync())
+            return Status::Malformed;
+    }
+
+    Status status = DecodeTrackerPose(query->reply, query->length, pose, prediction_status);
+    *query = PendingQuery();
+    return status;
+}
+
+bool ApriltagClient::Client::GetDevicePose(uint32_t idx, Pose& pose, double prediction)
+{
+    char command[64];
+    std::snprintf(command, sizeof(command), "getdevicepose %u %f", idx, prediction);
+    if (!RequestText(command))
+        return false;
+
+    //devicepose <idx> x y z qw qx qy qz
+    const char* rest = SkipWord(this->reply_, "devicepose");
+    double values[8];
+    if (rest == nullptr || !ReadNumbers(rest, values, 8))
+        return false;
+    std::memcpy(pose.position, values + 1, sizeof(pose.position));
+    std::memcpy(pose.rotation, values + 4, sizeof(pose.rotation));
+    return true;
+}
+
+bool ApriltagClient::Client::SubscribeDevicePoses(const uint32_t* indices, size_t count)
+{
+    char command[512] = "subscribe";
+    size_t used = std::strlen(command);
+    uint64_t devices = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (indices[i] >= ExampleDriver::SharedMemory::kMaxDevices)
+            return false;
+        devices |= uint64_t(1) << indices[i];
+    }
+    //listed from the mask, so duplicates are sent once and the command always fits
+    for (uint32_t i = 0; i < ExampleDriver::SharedMemory::kMaxDevices; i++)
+    {
+        if (devices & (uint64_t(1) << i))
+            used += std::snprintf(command + used, sizeof(command) - used, " %u", i);
+    }
+    if (!RequestText(command))
+        return false;
+
+    //subscribed <shared memory name> <version> <max devices>
+    const char* rest = SkipWord(this->reply_, "subscribed");
+    char name[128];
+    int version, max_devices;
+    if (rest == nullptr || std::sscanf(rest, "%127s %d %d", name, &version, &max_devices) != 3
+        || version != ExampleDriver::SharedMemory::kVersion || max_devices != (int)ExampleDriver::SharedMemory::kMaxDevices)
+        return false;
+    if (this->shared_memory_.Get() == nullptr && !this->shared_memory_.Open(name, false))
+        return false;
+
+    this->subscribed_devices_ = devices;
+    return true;
+}
+
+bool ApriltagClient::Client::ReadDevicePose(uint32_t idx, DevicePose& pose) const
+{
+    ExampleDriver::SharedMemory::Region* region = this->shared_memory_.Get();
+    if (region == nullptr || idx >= ExampleDriver::SharedMemory::kMaxDevices || (this->subscribed_devices_ & (uint64_t(1) << idx)) == 0)
+        return false;
+    return ExampleDriver::SharedMemory::Read(region->devices[idx], pose) && pose.time != 0;
+}
+
+uint32_t ApriltagClient::Client::DeviceFrame() const
+{
+    ExampleDriver::SharedMemory::Region* region = this->shared_memory_.Get();
+    if (region == nullptr || this->subscribed_devices_ == 0)
+        return 0;
+    return region->device_frame.load(std::memory_order_acquire);
+}
+
+bool ApriltagClient::Client::SyncTime(FrameTiming& timing)
+{
+    if (!RequestText("synctime"))
+        return false;
+
+    double values[4];
+    if (!ReadNumbers(this->reply_, values, 4))
+        return false;
+    timing.frame_time = values[0];
+    timing.since_last_frame = values[1];
+    timing.now = values[2];
+    timing.last_frame = values[3];
+    return true;
+}
+
+bool ApriltagClient::Client::SyncClock()
+{
+    Protocol::ClockSyncMessage message{ NextHeader(Protocol::MessageType::ClockSync), Now() };
+
+    Protocol::ClockSyncReply reply;
+    if (!Request(&message, sizeof(message)) || !Protocol::Decode(this->reply_, this->reply_length_, reply)
+        || reply.header.type != Protocol::MessageType::ClockSyncReply)
+        return false;
+
+    this->clock_offset_ = reply.offset;
+    this->clock_drift_ = reply.drift;
+    this->clock_reference_ = reply.client_time;
+    this->clock_synced_ = true;
+    return true;
+}
+
+double ApriltagClient::Client::Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ApriltagClient::Client::SendAsync(const void* message, size_t length)
+{
+    if (this->connection_ == nullptr)
+        return false;
+    //keep at most window_ requests in flight, waiting for whichever reply comes next
+    while (this->in_flight_ >= this->window_)
+    {
+        if (!ReceiveAsync())
+            return false;
+    }
+    if (!this->connection_->Send(static_cast<const char*>(message), length))
+    {
+        Fail();
+        return false;
+    }
+    this->in_flight_++;
+    this->stats_.sent++;
+    return true;
+}
+
+bool ApriltagClient::Client::ReceiveAsync()
+{
+    this->reply_length_ = this->connection_->Receive(this->reply_, sizeof(this->reply_));
+    if (this->reply_length_ < 0)
+    {
+        Fail();
+        return false;
+    }
+    this->in_flight_--;
+
+    if (!Protocol::IsBinaryMessage(this->reply_, this->reply_length_))
+        return true;
+    Protocol::Header header = Protocol::DecodeHeader(this->reply_, this->reply_length_);
+
+    //answers to queries are kept until WaitTrackerPose collects them
+    for (PendingQuery& query : this->queries_)
+    {
+        if (query.request_id != 0 && query.request_id == header.request_id)
+        {
+            query.length = std::min(this->reply_length_, (int)sizeof(query.reply));
+            std::memcpy(query.reply, this->reply_, query.length);
+            query.done = true;
+            return true;
+        }
+    }
+
+    if (header.type == Protocol::MessageType::BatchStatusReply)
+    {
+        Protocol::BatchStatusReply reply;
+        if (!DecodeBatchReply(this->reply_, this->reply_length_, reply))
+            reply.count = 0;
+        for (uint32_t i = 0; i < reply.count; i++)
+        {
+            Status status = (Status)reply.status[i];
+            if (status == Status::Updated)
+                this->stats_.updated++;
+            else
+            {
+                this->stats_.failed++;
+                this->stats_.last_error = status;
+            }
+        }
+    }
+    else
+    {
+        Protocol::StatusReply reply;
+        Status status = Protocol::Decode(this->reply_, this->reply_length_, reply) ? reply.status : Status::Malformed;
+        if (status == Status::Updated)
+            this->stats_.updated++;
+        else
+        {
+            this->stats_.failed++;
+            this->stats_.last_error = status;
+        }
+    }
+    return true;
+}
+
+bool ApriltagClient::Client::SendNoReply(const void* message, size_t length)
+{
+    if (this->connection_ == nullptr)
+        return false;
+    if (!this->connection_->Send(static_cast<const char*>(message), length))
+    {
+        Fail();
+        return false;
+    }
+    this->stats_.sent++;
+    return true;
+}
+
+bool ApriltagClient::Client::UpdatePoseAsync(uint32_t idx, const Pose& pose, double age)
+{
+    Protocol::UpdatePoseMessage message = PoseMessage(Protocol::MessageType::UpdatePose, idx, pose, age);
+    return SendAsync(&message, sizeof(message));
+}
+
+bool ApriltagClient::Client::UpdatePosesAsync(const PoseSample* samples, size_t count)
+{
+    Protocol::UpdatePoseBatchMessage message;
+    for (size_t sent = 0; sent < count; sent += message.count)
+    {
+        message.header = NextHeader(Protocol::MessageType::UpdatePoseBatch);
+        message.count = (uint32_t)std::min<size_t>(count - sent, Protocol::kMaxBatchSize);
+        CopySamples(message, samples + sent);
+        if (!SendAsync(&message, Protocol::BatchMessageSize(message.count)))
+            return false;
+    }
+    return true;
+}
+
+bool ApriltagClient::Client::SendPose(uint32_t idx, const Pose& pose, double age)
+{
+    Protocol::UpdatePoseMessage message = PoseMessage(Protocol::MessageType::UpdatePose, idx, pose, age, Protocol::kFlagNoReply);
+    return SendNoReply(&message, sizeof(message));
+}
+
+bool ApriltagClient::Client::SendPoseAt(uint32_t idx, const Pose& pose, double capture_time)
+{
+    if (!this->clock_synced_)
+        return SendPose(idx, pose, Now() - capture_time);
+
+    Protocol::UpdatePoseMessage message = PoseMessage(Protocol::MessageType::UpdatePoseAt, idx, pose, ToDriverTime(capture_time), Protocol::kFlagNoReply);
+    return SendNoReply(&message, sizeof(message));
+}
+
+bool ApriltagClient::Client::SendPoses(const PoseSample* samples, size_t count)
+{
+    Protocol::UpdatePoseBatchMessage message;
+    for (size_t sent = 0; sent < count; sent += message.count)
+    {
+        message.header = NextHeader(Protocol::MessageType::UpdatePoseBatch, Protocol::kFlagNoReply);
+        message.count = (uint32_t)std::min<size_t>(count - sent, Protocol::kMaxBatchSize);
+        CopySamples(message, samples + sent);
+        if (!SendNoReply(&message, Protocol::BatchMessageSize(message.count)))
+            return false;
+    }
+    return true;
+}
+
+bool ApriltagClient::Client::Flush()
+{
+    if (this->connection_ == nullptr)
+        return false;
+    while (this->in_flight_ > 0)
+    {
+        if (!ReceiveAsync())
+            return false;
+    }
+    return true;
+}
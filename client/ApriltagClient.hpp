@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <Driver/Protocol.hpp>
+#include <Driver/SharedMemory.hpp>
+#include <Driver/Transport.hpp>
+
+// Client side of the driver's pipe protocol, for tracking apps. One Client is one persistent connection to the driver;
+// it is not thread safe, use one Client per thread. Pose updates go out as binary Protocol messages built in place,
+// so the calls made every frame never allocate.
+namespace ApriltagClient {
+
+    using ExampleDriver::Protocol::Status;
+    using ExampleDriver::Protocol::PoseSample;
+    using ExampleDriver::SharedMemory::DevicePose;
+
+    struct Pose {
+        double position[3];
+        double rotation[4];     // w, x, y, z
+    };
+
+    // Frame timing of the driver as reported by synctime, all in ms
+    struct FrameTiming {
+        double frame_time;          // average time between frames
+        double since_last_frame;
+        double now;                 // driver session time
+        double last_frame;          // driver session time of the last frame
+    };
+
+    // Outcome of the requests sent with the Async and Send calls. Only Async requests get replies, so only they are
+    // counted as updated or failed.
+    struct AsyncStats {
+        uint64_t sent = 0;
+        uint64_t updated = 0;       // poses stored
+        uint64_t failed = 0;        // poses refused, see last_error
+        Status last_error = Status::Updated;
+    };
+
+    class Client {
+    public:
+        static constexpr int kDefaultWindow = 32;       // Async requests in flight before waiting for the oldest reply
+        static constexpr int kMaxQueries = 16;          // GetTrackerPoseAsync requests waiting to be collected
+
+        Client() = default;
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        /// <summary>
+        /// Connects to the driver and checks it speaks our version of the binary protocol
+        /// </summary>
+        /// <param name="name">Pipe or socket name, without any platform prefix</param>
+        /// <returns>False if the driver could not be reached or uses another protocol version</returns>
+        bool Connect(const char* name = "ApriltagPipeIn", int timeout_ms = 2000);
+        void Disconnect();
+        bool Connected() const { return connection_ != nullptr; }
+
+        /// <summary>
+        /// Names the camera this client's poses come from, the driver fuses the observations of different cameras of
+        /// one tracker (see fusion_window). Every camera needs its own id, 0 (the default) names none and is never fused.
+        /// Batch samples with a source of 0 get this one.
+        /// </summary>
+        void SetSource(uint32_t source) { source_ = source; }
+        uint32_t Source() const { return source_; }
+
+        /// <summary>
+        /// Adds a tracker, see the addtracker command. Trackers are numbered in the order they were added.
+        /// </summary>
+        /// <returns>True if the driver added it</returns>
+        bool AddTracker(const char* name, const char* role);
+        bool AddStation();
+        bool AddHipMove();
+
+        /// <summary>
+        /// Number of trackers the driver has
+        /// </summary>
+        /// <returns>The count, -1 on error</returns>
+        int NumTrackers();
+
+        /// <summary>
+        /// Sends one pose sample and waits for the driver to store it
+        /// </summary>
+        /// <param name="age">How long ago the pose was captured, in seconds</param>
+        Status UpdatePose(uint32_t idx, const Pose& pose, double age);
+
+        /// <summary>
+        /// Sends one pose sample with its capture time on this client's clock (see Now). Once SyncClock has run the driver
+        /// gets the exact capture time no matter how long the message took, before that the pose's age is sent instead.
+        /// </summary>
+        Status UpdatePoseAt(uint32_t idx, const Pose& pose, double capture_time);
+
+        /// <summary>
+        /// Sends any number of samples, in messages of up to Protocol::kMaxBatchSize samples
+        /// </summary>
+        /// <param name="status">Optional, receives the Status of every sample</param>
+        /// <returns>False if the connection failed, per sample results are in status</returns>
+        bool UpdatePoses(const PoseSample* samples, size_t count, Status* status = nullptr);
+
+        Status UpdateStation(uint32_t idx, const Pose& pose);
+        Status HipMoveInput(float x, float y, float rx, float ry, float a, float b);
+
+        /// <summary>
+        /// The driver's filtered pose of one of its trackers
+        /// </summary>
+        /// <param name="time_offset">How far in the past to evaluate the pose, in seconds</param>
+        /// <param name="prediction_status">Optional, 0 if the pose could be predicted normally</param>
+        Status GetTrackerPose(uint32_t idx, double time_offset, Pose& pose, int* prediction_status = nullptr);
+
+        /// <summary>
+        /// Pose of any SteamVR device, 0 being the HMD, see getdevicepose
+        /// </summary>
+        /// <param name="prediction">Seconds ahead to predict the pose, 0 is the current pose as ReadDevicePose sees it</param>
+        /// <returns>False on error</returns>
+        bool GetDevicePose(uint32_t idx, Pose& pose, double prediction = 0);
+
+        /// <summary>
+        /// Has the driver publish the poses of these SteamVR devices to shared memory every frame, for ReadDevicePose.
+        /// Replaces the previous subscription, a count of 0 ends it. Ends with the connection as well.
+        /// </summary>
+        /// <param name="indices">Device indices, 0 being the HMD, up to SharedMemory::kMaxDevices</param>
+        /// <returns>False if the driver refused or the shared memory could not be mapped</returns>
+        bool SubscribeDevicePoses(const uint32_t* indices, size_t count);
+
+        /// <summary>
+        /// Latest pose of a subscribed device, straight from shared memory without talking to the driver
+        /// </summary>
+        /// <returns>False if the device is not subscribed or was never published</returns>
+        bool ReadDevicePose(uint32_t idx, DevicePose& pose) const;
+
+        /// <summary>
+        /// Counts the frames the driver published device poses in, a reader can wait for it to change
+        /// </summary>
+        /// <returns>The count, 0 without a subscription</returns>
+        uint32_t DeviceFrame() const;
+
+        /// <summary>
+        /// The driver's frame timing, for phase locking a camera to the frames
+        /// </summary>
+        /// <returns>False on error</returns>
+        bool SyncTime(FrameTiming& timing);
+
+        /// <summary>
+        /// One clock sync exchange, the driver answers with its running estimate of this connection's clock.
+        /// Call every second or so while sending UpdatePoseAt.
+        /// </summary>
+        /// <returns>False on error</returns>
+        bool SyncClock();
+        bool ClockSynced() const { return clock_synced_; }
+
+        /// <summary>
+        /// This client's clock in seconds: steady_clock, the time base of capture times given to UpdatePoseAt
+        /// </summary>
+        static double Now();
+
+        /// <summary>
+        /// Sends a pose sample without waiting for the reply. Up to the window size of requests are in flight at once,
+        /// beyond that each call first waits for the oldest reply. Results are counted in Stats.
+        /// </summary>
+        /// <returns>False if the connection failed</returns>
+        bool UpdatePoseAsync(uint32_t idx, const Pose& pose, double age);
+        bool UpdatePosesAsync(const PoseSample* samples, size_t count);
+
+        /// <summary>
+        /// Fire and forget versions of UpdatePose, UpdatePoseAt and UpdatePoses: the driver stores the samples without
+        /// replying, so these never wait for anything but the connection. Errors such as an invalid idx go unnoticed.
+        /// </summary>
+        /// <returns>False if the connection failed</returns>
+        bool SendPose(uint32_t idx, const Pose& pose, double age);
+        bool SendPoseAt(uint32_t idx, const Pose& pose, double capture_time);
+        bool SendPoses(const PoseSample* samples, size_t count);
+
+        /// <summary>
+        /// Asks for a tracker's pose without waiting for the answer, pose uploads can go on in the meantime.
+        /// Collect the answer with WaitTrackerPose.
+        /// </summary>
+        /// <returns>Id of the request, 0 if the connection failed or kMaxQueries requests are already waiting</returns>
+        uint32_t GetTrackerPoseAsync(uint32_t idx, double time_offset);
+
+        /// <summary>
+        /// Waits for the answer to a GetTrackerPoseAsync request, replies to other requests are handled on the way
+        /// </summary>
+        /// <param name="request">Id returned by GetTrackerPoseAsync, every id can be waited for once</param>
+        /// <returns>As GetTrackerPose, Malformed for an unknown request or if the connection failed</returns>
+        Status WaitTrackerPose(uint32_t request, Pose& pose, int* prediction_status = nullptr);
+
+        /// <summary>
+        /// Waits for the replies of every request in flight. Answers to GetTrackerPoseAsync are kept for WaitTrackerPose.
+        /// </summary>
+        /// <returns>False if the connection failed</returns>
+        bool Flush();
+
+        void SetWindow(int window) { window_ = window < 1 ? 1 : window; }
+        int InFlight() const { return in_flight_; }
+        const AsyncStats& Stats() const { return stats_; }
+
+    private:
+        // A GetTrackerPoseAsync request, request_id 0 marks a free slot
+        struct PendingQuery {
+            uint32_t request_id = 0;
+            bool done = false;
+            int length = 0;
+            char reply[sizeof(ExampleDriver::Protocol::TrackerPoseReply)];
+        };
+
+        // Header with the next request id
+        ExampleDriver::Protocol::Header NextHeader(ExampleDriver::Protocol::MessageType type, uint32_t flags = 0);
+        ExampleDriver::Protocol::UpdatePoseMessage PoseMessage(ExampleDriver::Protocol::MessageType type, uint32_t idx, const Pose& pose, double time, uint32_t flags = 0);
+        // Fills the message with its count of samples, tagged with this client's source where they name none
+        void CopySamples(ExampleDriver::Protocol::UpdatePoseBatchMessage& message, const PoseSample* samples) const;
+        double ToDriverTime(double capture_time) const;
+
+        // Waits for everything in flight, sends the message and receives its reply into reply_
+        bool Request(const void* message, size_t length);
+        bool RequestText(const char* command);
+        bool SendAsync(const void* message, size_t length);
+        bool SendNoReply(const void* message, size_t length);
+        bool ReceiveAsync();
+        void Fail();
+
+        std::unique_ptr<ExampleDriver::IConnection> connection_;
+        char reply_[1024];
+        int reply_length_ = 0;
+        int window_ = kDefaultWindow;
+        int in_flight_ = 0;             // replies still to come, of Async calls and queries
+        uint32_t next_request_id_ = 0;
+        PendingQuery queries_[kMaxQueries];
+        ExampleDriver::SharedMemory::Mapping shared_memory_;
+        uint64_t subscribed_devices_ = 0;
+        uint32_t source_ = 0;
+        AsyncStats stats_;
+        bool clock_synced_ = false;
+        double clock_offset_ = 0;       // driver session seconds - client seconds, at clock_reference_
+        double clock_drift_ = 0;
+        double clock_reference_ = 0;
+    };
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ExampleDriver {
+
+    // The one time base of the driver: steady_clock, which never jumps when the wall clock is adjusted,
+    // counted from the start of the session. Sample times, predictions and frame timing all use it.
+    namespace Clock {
+
+        using Source = std::chrono::steady_clock;
+
+        /// <summary>
+        /// Start of the session, fixed by the first call (VRDriver::Init makes that call)
+        /// </summary>
+        inline Source::time_point Epoch()
+        {
+            static const Source::time_point epoch = Source::now();
+            return epoch;
+        }
+
+        /// <summary>
+        /// Nanoseconds since the start of the session
+        /// </summary>
+        inline int64_t NowNanoseconds()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Source::now() - Epoch()).count();
+        }
+
+        /// <summary>
+        /// Seconds since the start of the session. A double keeps well under a microsecond of resolution for years.
+        /// </summary>
+        inline double Now()
+        {
+            return std::chrono::duration<double>(Source::now() - Epoch()).count();
+        }
+
+        /// <summary>
+        /// Session seconds of a point in time
+        /// </summary>
+        inline double ToSeconds(Source::time_point time)
+        {
+            return std::chrono::duration<double>(time - Epoch()).count();
+        }
+
+        /// <summary>
+        /// Converts raw steady_clock seconds, as written by other processes (see SharedMemory::Now), to session seconds
+        /// </summary>
+        inline double FromSteadySeconds(double steady_seconds)
+        {
+            return steady_seconds - std::chrono::duration<double>(Epoch().time_since_epoch()).count();
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#include "ClockSync.hpp"
+
+#include <cmath>
+
+void ExampleDriver::ClockSync::Reset()
+{
+    head_ = 0;
+    count_ = 0;
+    reference_ = 0;
+    offset_ = 0;
+    drift_ = 0;
+}
+
+void ExampleDriver::ClockSync::AddExchange(double client_time, double receive_time)
+{
+    //a client clock that jumped back makes the old exchanges meaningless. Smaller steps back are requests that overtook each other.
+    if (count_ > 0 && client_time < client_time_[(head_ + count_ - 1) % kWindow] - kMaxReorder)
+        Reset();
+
+    int slot = (head_ + count_) % kWindow;
+    if (count_ == kWindow)
+        head_ = (head_ + 1) % kWindow;
+    else
+        count_++;
+
+    client_time_[slot] = client_time;
+    difference_[slot] = receive_time - client_time;
+
+    Fit();
+}
+
+void ExampleDriver::ClockSync::Fit()
+{
+    //lowest difference of every group of exchanges, oldest group first. The newest group may be incomplete.
+    double min_time[kWindow / kGroup];
+    double min_difference[kWindow / kGroup];
+    int groups = 0;
+    for (int start = 0; start < count_; start += kGroup)
+    {
+        int best = (head_ + start) % kWindow;
+        for (int i = start + 1; i < count_ && i < start + kGroup; i++)
+        {
+            int slot = (head_ + i) % kWindow;
+            if (difference_[slot] < difference_[best])
+                best = slot;
+        }
+        min_time[groups] = client_time_[best];
+        min_difference[groups] = difference_[best];
+        groups++;
+    }
+
+    //least squares line through the minima, around the newest one so the offset is accurate where it is used
+    reference_ = min_time[groups - 1];
+    double sum_t = 0, sum_d = 0, sum_tt = 0, sum_td = 0;
+    for (int i = 0; i < groups; i++)
+    {
+        double t = min_time[i] - reference_;
+        sum_t += t;
+        sum_d += min_difference[i];
+        sum_tt += t * t;
+        sum_td += t * min_difference[i];
+    }
+
+    double denominator = groups * sum_tt - sum_t * sum_t;
+    if (groups < 2 || reference_ - min_time[0] < kMinDriftSpan || std::fabs(denominator) < 1e-12)
+    {
+        //not enough spread in time for a drift yet, use the lowest difference seen
+        offset_ = min_difference[0];
+        for (int i = 1; i < groups; i++)
+            offset_ = std::fmin(offset_, min_difference[i]);
+        drift_ = 0;
+        return;
+    }
+
+    drift_ = (groups * sum_td - sum_t * sum_d) / denominator;
+    offset_ = (sum_d - drift_ * sum_t) / groups;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// Estimates how the clock of one pipe client maps onto the session clock of the driver.
+    /// Every clocksync exchange gives a pair of client send time and driver receive time, their difference is the clock offset
+    /// plus the one-way pipe delay. Queueing only ever adds delay, so the smallest differences are the ones closest to the true offset:
+    /// the window is split into groups, the minimum of each group is kept, and a line through those minima gives offset and drift.
+    /// The offset still contains the smallest one-way delay of the window, which on a local pipe is tens of microseconds.
+    /// Clients that want it exact compute the offset themselves from the round trip, which the clocksync reply also allows.
+    /// </summary>
+    class ClockSync {
+    public:
+        static constexpr int kWindow = 64;      // exchanges kept
+        static constexpr int kGroup = 8;        // exchanges per minimum
+        static constexpr double kMaxReorder = 1;        // seconds
+        static constexpr double kMinDriftSpan = 10;     // seconds the exchanges must span before a drift is fitted, shorter spans give more noise than drift
+
+        /// <summary>
+        /// Forgets all exchanges
+        /// </summary>
+        void Reset();
+
+        /// <summary>
+        /// Records one exchange. Both times are in seconds.
+        /// </summary>
+        /// <param name="client_time">Client clock when the request was sent</param>
+        /// <param name="receive_time">Driver session time when the request arrived</param>
+        void AddExchange(double client_time, double receive_time);
+
+        bool Valid() const { return count_ > 0; }
+
+        /// <summary>
+        /// Driver session time minus client time, at the given client time
+        /// </summary>
+        double Offset(double client_time) const { return offset_ + drift_ * (client_time - reference_); }
+
+        /// <summary>
+        /// How much faster the driver clock runs than the client clock, in seconds per second
+        /// </summary>
+        double Drift() const { return drift_; }
+
+        double ToDriverTime(double client_time) const { return client_time + Offset(client_time); }
+
+    private:
+        // refits offset_ and drift_ from the stored exchanges
+        void Fit();
+
+        double client_time_[kWindow] = {};
+        double difference_[kWindow] = {};       // receive time - client time
+        int head_ = 0;      // slot of the oldest exchange
+        int count_ = 0;
+
+        double reference_ = 0;      // client time the offset is given at
+        double offset_ = 0;
+        double drift_ = 0;
+    };
+}
@@ -1,5 +1,4 @@
 #include "ControllerDevice.hpp"
-#include <Windows.h>
 
 ExampleDriver::ControllerDevice::ControllerDevice(std::string serial, ControllerDevice::Handedness handedness):
     serial_(serial),
@@ -51,27 +50,22 @@ void ExampleDriver::ControllerDevice::SetDirection(float x, float y, float rx, f
     }
 }
 
+void ExampleDriver::ControllerDevice::OnEvent(const vr::VREvent_t& event)
+{
+    // Only haptic vibration of this device's component is subscribed to
+    if (event.eventType == vr::VREvent_Input_HapticVibration)
+        this->did_vibrate_ = true;
+}
+
 void ExampleDriver::ControllerDevice::Update()
 {
-    if (this->device_index_ == vr::k_unTrackedDeviceIndexInvalid)
+    vr::TrackedDeviceIndex_t device_index = this->device_index_.load(std::memory_order_acquire);
+    if (device_index == vr::k_unTrackedDeviceIndexInvalid)
         return;
 
-    // Check if this device was asked to be identified
-    auto events = GetDriver()->GetOpenVREvents();
-    for (auto event : events) {
-        // Note here, event.trackedDeviceIndex does not necissarily equal this->device_index_, not sure why, but the component handle will match so we can just use that instead
-        //if (event.trackedDeviceIndex == this->device_index_) {
-        if (event.eventType == vr::EVREventType::VREvent_Input_HapticVibration) {
-            if (event.data.hapticVibration.componentHandle == this->haptic_component_) {
-                this->did_vibrate_ = true;
-            }
-        }
-        //}
-    }
-
     // Check if we need to keep vibrating
     if (this->did_vibrate_) {
-        this->vibrate_anim_state_ += (GetDriver()->GetLastFrameTime().count()/1000.f);
+        this->vibrate_anim_state_ += std::chrono::duration<float>(GetDriver()->GetLastFrameTime()).count();
         if (this->vibrate_anim_state_ > 1.0f) {
             this->did_vibrate_ = false;
             this->vibrate_anim_state_ = 0.0f;
@@ -101,7 +95,7 @@ void ExampleDriver::ControllerDevice::Update()
     */
 
     // Post pose
-    GetDriver()->GetDriverHost()->TrackedDevicePoseUpdated(this->device_index_, pose, sizeof(vr::DriverPose_t));
+    GetDriver()->PostPose(device_index, pose);
     this->last_pose_ = pose;
 }
 
@@ -122,12 +116,10 @@ vr::TrackedDeviceIndex_t ExampleDriver::ControllerDevice::GetDeviceIndex()
 
 vr::EVRInitError ExampleDriver::ControllerDevice::Activate(uint32_t unObjectId)
 {
-    this->device_index_ = unObjectId;
-
     GetDriver()->Log("Activating controller " + this->serial_);
 
     // Get the properties handle
-    auto props = GetDriver()->GetProperties()->TrackedDeviceToPropertyContainer(this->device_index_);
+    auto props = GetDriver()->GetProperties()->TrackedDeviceToPropertyContainer(unObjectId);
 
     // Setup inputs and outputs
    
@@ -178,12 +170,19 @@ vr::EVRInitError ExampleDriver::ControllerDevice::Activate(uint32_t unObjectId)
     GetDriver()->GetProperties()->SetStringProperty(props, vr::Prop_NamedIconPathDeviceStandby_String, controller_not_ready_file.c_str());
     GetDriver()->GetProperties()->SetStringProperty(props, vr::Prop_NamedIconPathDeviceAlertLow_String, controller_not_ready_file.c_str());
 
+    // Get told when this device is asked to vibrate
+    GetDriver()->GetInput()->CreateHapticComponent(props, "/output/haptic", &this->haptic_component_);
+    GetDriver()->SubscribeEvent(vr::VREvent_Input_HapticVibration, this->haptic_component_, this);
+
+    // Poses are posted from here on, the device is set up
+    this->device_index_.store(unObjectId, std::memory_order_release);
+
     return vr::EVRInitError::VRInitError_None;
 }
 
 void ExampleDriver::ControllerDevice::Deactivate()
 {
-    this->device_index_ = vr::k_unTrackedDeviceIndexInvalid;
+    this->device_index_.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_release);
 }
 
 void ExampleDriver::ControllerDevice::EnterStandby()
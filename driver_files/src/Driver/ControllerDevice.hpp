@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cmath>
 
@@ -24,6 +25,7 @@ namespace ExampleDriver {
             // Inherited via IVRDevice
             virtual std::string GetSerial() override;
             virtual void Update() override;
+            virtual void OnEvent(const vr::VREvent_t& event) override;
             virtual vr::TrackedDeviceIndex_t GetDeviceIndex() override;
             virtual DeviceType GetDeviceType() override;
             virtual Handedness GetHandedness();
@@ -38,7 +40,8 @@ namespace ExampleDriver {
             virtual vr::DriverPose_t GetPose() override;
 
     private:
-        vr::TrackedDeviceIndex_t device_index_ = vr::k_unTrackedDeviceIndexInvalid;
+        // Set by SteamVR's Activate and Deactivate, read by the threads posting poses
+        std::atomic<vr::TrackedDeviceIndex_t> device_index_{ vr::k_unTrackedDeviceIndexInvalid };
         std::string serial_;
         Handedness handedness_;
 
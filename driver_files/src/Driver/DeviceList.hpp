@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// A list of devices that the pipe side appends to while RunFrame iterates it.
+    /// Every Add publishes a new immutable copy of the list. Devices are never removed, so every
+    /// published copy is kept until the driver shuts down and readers never need a lock or a reference count.
+    /// </summary>
+    template<typename T>
+    class DeviceList {
+    public:
+        using List = std::vector<std::shared_ptr<T>>;
+
+        DeviceList()
+        {
+            versions_.push_back(std::make_unique<List>());
+            published_.store(versions_.back().get(), std::memory_order_release);
+        }
+
+        DeviceList(const DeviceList&) = delete;
+        DeviceList& operator=(const DeviceList&) = delete;
+
+        /// <summary>
+        /// Appends a device. Callers must serialize Add against each other.
+        /// </summary>
+        void Add(std::shared_ptr<T> device)
+        {
+            auto next = std::make_unique<List>(*versions_.back());
+            next->push_back(std::move(device));
+            published_.store(next.get(), std::memory_order_release);
+            versions_.push_back(std::move(next));
+        }
+
+        /// <summary>
+        /// Returns the latest published list, safe to call from any thread. The returned list never changes,
+        /// so take it once and iterate that instead of calling Get repeatedly.
+        /// </summary>
+        const List& Get() const
+        {
+            return *published_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::vector<std::unique_ptr<List>> versions_;
+        std::atomic<List*> published_;
+    };
+}
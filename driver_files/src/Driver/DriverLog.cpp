@@ -0,0 +1,202 @@
+#include "DriverLog.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <openvr_driver.h>
+
+namespace {
+    //the text of a message ends in a newline, SteamVR does not add one
+    void Terminate(char* text, int length, int size)
+    {
+        length = std::min(std::max(length, 0), size - 2);
+        text[length] = '\n';
+        text[length + 1] = '\0';
+    }
+}
+
+ExampleDriver::LogSite::LogSite(const char* format, std::string context):
+    format_(format),
+    context_(std::move(context))
+{
+    DriverLog& log = DriverLog::Get();
+    std::lock_guard<std::mutex> lock(log.sites_mutex_);
+    log.sites_.push_back(this);
+}
+
+ExampleDriver::LogSite::~LogSite()
+{
+    DriverLog& log = DriverLog::Get();
+    std::lock_guard<std::mutex> lock(log.sites_mutex_);
+    log.sites_.erase(std::remove(log.sites_.begin(), log.sites_.end(), this), log.sites_.end());
+}
+
+void ExampleDriver::LogSite::Count(double value)
+{
+    count_.fetch_add(1, std::memory_order_relaxed);
+    double max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        ;
+}
+
+ExampleDriver::DriverLog& ExampleDriver::DriverLog::Get()
+{
+    //never destroyed, the log sites of devices can be torn down after static destructors ran
+    static DriverLog* log = new DriverLog();
+    return *log;
+}
+
+ExampleDriver::DriverLog::DriverLog()
+{
+    for (int i = 0; i < kQueueSize; i++)
+        entries_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+void ExampleDriver::DriverLog::Start()
+{
+    if (thread_.joinable())
+        return;
+
+    running_ = true;
+    thread_ = std::thread(&DriverLog::FlushThread, this);
+}
+
+void ExampleDriver::DriverLog::Stop()
+{
+    if (!thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        running_ = false;
+    }
+    wake_.notify_one();
+    thread_.join();
+
+    //the thread is gone, this side is the only reader now
+    Flush();
+    Report();
+}
+
+void ExampleDriver::DriverLog::Write(const char* message)
+{
+    uint64_t position;
+    Entry* entry = Claim(position);
+    if (entry == nullptr)
+        return;
+
+    size_t length = std::min(std::strlen(message), size_t(kMessageSize - 2));
+    std::memcpy(entry->text, message, length);
+    Terminate(entry->text, int(length), kMessageSize);
+    Publish(entry, position);
+}
+
+void ExampleDriver::DriverLog::Printf(const char* format, ...)
+{
+    uint64_t position;
+    Entry* entry = Claim(position);
+    if (entry == nullptr)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(entry->text, kMessageSize - 1, format, args);
+    va_end(args);
+    Terminate(entry->text, length, kMessageSize);
+    Publish(entry, position);
+}
+
+ExampleDriver::DriverLog::Entry* ExampleDriver::DriverLog::Claim(uint64_t& position)
+{
+    position = head_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Entry& entry = entries_[position % kQueueSize];
+        int64_t lag = int64_t(entry.sequence.load(std::memory_order_acquire)) - int64_t(position);
+        if (lag == 0)
+        {
+            //free and nobody else took it yet
+            if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return &entry;
+        }
+        else if (lag < 0)
+        {
+            //still holds a message from a lap ago, the queue is full
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else
+        {
+            position = head_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void ExampleDriver::DriverLog::Publish(Entry* entry, uint64_t position)
+{
+    entry->sequence.store(position + 1, std::memory_order_release);
+}
+
+void ExampleDriver::DriverLog::Flush()
+{
+    for (;;)
+    {
+        Entry& entry = entries_[tail_ % kQueueSize];
+        if (entry.sequence.load(std::memory_order_acquire) != tail_ + 1)
+            break;
+
+        vr::VRDriverLog()->Log(entry.text);
+        entry.sequence.store(tail_ + kQueueSize, std::memory_order_release);
+        tail_++;
+    }
+}
+
+void ExampleDriver::DriverLog::Report()
+{
+    char line[kMessageSize];
+    {
+        std::lock_guard<std::mutex> lock(sites_mutex_);
+        for (LogSite* site : sites_)
+        {
+            uint64_t count = site->count_.exchange(0, std::memory_order_relaxed);
+            if (count == 0)
+                continue;
+            double max = site->max_.exchange(0, std::memory_order_relaxed);
+            int length = std::snprintf(line, sizeof(line) - 1, site->format_, site->context_.c_str(), (unsigned long long)count, max);
+            Terminate(line, length, sizeof(line));
+            vr::VRDriverLog()->Log(line);
+        }
+    }
+
+    uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        int length = std::snprintf(line, sizeof(line) - 1, "Log queue full, dropped %llu messages", (unsigned long long)dropped);
+        Terminate(line, length, sizeof(line));
+        vr::VRDriverLog()->Log(line);
+    }
+}
+
+void ExampleDriver::DriverLog::FlushThread()
+{
+    std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (running_)
+    {
+        wake_.wait_for(lock, std::chrono::milliseconds(kFlushInterval), [this] { return !running_; });
+        lock.unlock();
+
+        Flush();
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::milliseconds(kReportInterval))
+        {
+            Report();
+            last_report = now;
+        }
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// A log message that can happen hundreds of times a second, like a dropped pose. Counting one is a couple of
+    /// relaxed atomics; DriverLog formats and writes one line per site and second, with the count and the largest value.
+    /// </summary>
+    class LogSite {
+    public:
+        /// <summary>
+        /// The format gets the context (%s), how many times the site was hit (%llu) and the largest value (%f), in that order
+        /// </summary>
+        LogSite(const char* format, std::string context = "");
+        ~LogSite();
+
+        LogSite(const LogSite&) = delete;
+        LogSite& operator=(const LogSite&) = delete;
+
+        void Count(double value);
+
+    private:
+        friend class DriverLog;
+
+        const char* format_;
+        std::string context_;
+        std::atomic<uint64_t> count_{ 0 };
+        std::atomic<double> max_{ 0 };
+    };
+
+    /// <summary>
+    /// The driver's log. Write only copies the message into a fixed size lock-free queue, a background thread hands
+    /// the queued messages to SteamVR and reports every LogSite once a second. A full queue drops messages rather than
+    /// blocking the caller, the flushing thread reports how many.
+    /// </summary>
+    class DriverLog {
+    public:
+        static constexpr int kQueueSize = 256;          // messages, a power of two
+        static constexpr int kMessageSize = 512;        // longer messages are cut off
+        static constexpr int kFlushInterval = 20;       // ms between passes of the flushing thread
+        static constexpr int kReportInterval = 1000;    // ms between reports of the log sites
+
+        static DriverLog& Get();
+
+        /// <summary>
+        /// Starts the flushing thread, the driver context has to be set up
+        /// </summary>
+        void Start();
+
+        /// <summary>
+        /// Stops the flushing thread and writes whatever is still queued
+        /// </summary>
+        void Stop();
+
+        /// <summary>
+        /// Queues one line, safe to call from any thread. Messages written before Start wait for it.
+        /// </summary>
+        void Write(const char* message);
+        void Write(const std::string& message) { Write(message.c_str()); }
+
+        /// <summary>
+        /// Formats into the queue, without allocating
+        /// </summary>
+        void Printf(const char* format, ...);
+
+    private:
+        friend class LogSite;
+
+        struct Entry {
+            std::atomic<uint64_t> sequence;
+            char text[kMessageSize];
+        };
+
+        DriverLog();
+
+        // Claims the next free entry, nullptr if the queue is full. Publish hands it to the flushing thread.
+        Entry* Claim(uint64_t& position);
+        void Publish(Entry* entry, uint64_t position);
+        void Flush();
+        void Report();
+        void FlushThread();
+
+        // Bounded multi-producer queue, every entry's sequence tells whose turn it is (Vyukov)
+        Entry entries_[kQueueSize];
+        std::atomic<uint64_t> head_{ 0 };
+        uint64_t tail_ = 0;                             // only touched by the flushing side
+        std::atomic<uint64_t> dropped_{ 0 };
+
+        // Registered sites, the lock is only taken when one is created or destroyed and once per report
+        std::mutex sites_mutex_;
+        std::vector<LogSite*> sites_;
+
+        std::thread thread_;
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;
+        bool running_ = false;
+    };
+}
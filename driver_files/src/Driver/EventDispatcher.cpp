@@ -0,0 +1,48 @@
+#include "EventDispatcher.hpp"
+
+#include <Driver/IVRDevice.hpp>
+
+ExampleDriver::EventDispatcher::EventDispatcher()
+{
+    this->versions_.push_back(std::make_unique<Table>());
+    this->published_.store(this->versions_.back().get(), std::memory_order_release);
+}
+
+void ExampleDriver::EventDispatcher::Subscribe(vr::EVREventType type, uint64_t target, IVRDevice* device)
+{
+    //a device that never created the component would otherwise collect the events of every other such device
+    if (type == vr::VREvent_Input_HapticVibration && target == vr::k_ulInvalidInputComponentHandle)
+        return;
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto next = std::make_unique<Table>(*this->versions_.back());
+    (*next)[Key{ (uint32_t)type, target }] = device;
+    this->published_.store(next.get(), std::memory_order_release);
+    this->versions_.push_back(std::move(next));
+}
+
+void ExampleDriver::EventDispatcher::Dispatch(Span<const vr::VREvent_t> events)
+{
+    if (events.empty())
+        return;
+
+    const Table& subscribers = *this->published_.load(std::memory_order_acquire);
+    for (const vr::VREvent_t& event : events)
+    {
+        auto subscriber = subscribers.find(Key{ event.eventType, Target(event) });
+        if (subscriber != subscribers.end())
+            subscriber->second->OnEvent(event);
+    }
+}
+
+uint64_t ExampleDriver::EventDispatcher::Target(const vr::VREvent_t& event)
+{
+    switch (event.eventType)
+    {
+    case vr::VREvent_Input_HapticVibration:
+        //trackedDeviceIndex does not necessarily match the device, the component handle always does
+        return event.data.hapticVibration.componentHandle;
+    default:
+        return event.trackedDeviceIndex;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <openvr_driver.h>
+
+#include <Driver/Span.hpp>
+
+namespace ExampleDriver {
+
+    class IVRDevice;
+
+    /// <summary>
+    /// Hands each OpenVR event of a frame to the one device that subscribed to it, instead of every device scanning every event.
+    /// Events are looked up by type and target: the input component for input events such as haptic vibration,
+    /// the device index for everything else. Lookups do not allocate, so dispatching costs the same per event at any device count.
+    /// Like DeviceList, every Subscribe publishes a new immutable copy of the table and keeps the old ones until the driver shuts
+    /// down. Devices subscribe once when they are activated, so there are few copies, and Dispatch never takes a lock.
+    /// </summary>
+    class EventDispatcher {
+    public:
+        EventDispatcher();
+
+        EventDispatcher(const EventDispatcher&) = delete;
+        EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+        /// <summary>
+        /// Delivers events of the given type and target to device->OnEvent. A later subscription for the same type and target replaces it.
+        /// Safe to call from any thread, devices usually subscribe from Activate.
+        /// </summary>
+        /// <param name="target">Input component handle for input events, device index otherwise. Invalid handles are ignored.</param>
+        void Subscribe(vr::EVREventType type, uint64_t target, IVRDevice* device);
+
+        /// <summary>
+        /// Delivers every event to its subscriber, if it has one
+        /// </summary>
+        void Dispatch(Span<const vr::VREvent_t> events);
+
+        /// <summary>
+        /// What an event is addressed to, in the sense of Subscribe
+        /// </summary>
+        static uint64_t Target(const vr::VREvent_t& event);
+
+    private:
+        struct Key {
+            uint32_t type;
+            uint64_t target;
+
+            bool operator==(const Key& other) const { return type == other.type && target == other.target; }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const { return std::hash<uint64_t>()(key.target * 31 + key.type); }
+        };
+
+        using Table = std::unordered_map<Key, IVRDevice*, KeyHash>;
+
+        std::mutex mutex_;      // serializes subscriptions, they come from SteamVR and pipe threads
+        std::vector<std::unique_ptr<Table>> versions_;
+        std::atomic<const Table*> published_{ nullptr };     // read by RunFrame
+    };
+}
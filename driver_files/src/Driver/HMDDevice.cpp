@@ -1,5 +1,18 @@
 #include "HMDDevice.hpp"
+
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <strings.h>
+#define _stricmp strcasecmp
+
+// Keyboard controls for the example HMD are only implemented on Windows
+static short GetAsyncKeyState(int) { return 0; }
+#define VK_LEFT 0x25
+#define VK_UP 0x26
+#define VK_RIGHT 0x27
+#define VK_DOWN 0x28
+#endif
 
 ExampleDriver::HMDDevice::HMDDevice(std::string serial):serial_(serial)
 {
@@ -18,7 +31,7 @@ void ExampleDriver::HMDDevice::Update()
     // Setup pose for this frame
     auto pose = IVRDevice::MakeDefaultPose();
 
-    float delta_seconds = GetDriver()->GetLastFrameTime().count() / 1000.0f;
+    float delta_seconds = std::chrono::duration<float>(GetDriver()->GetLastFrameTime()).count();
 
     // Get orientation
     this->rot_y_ += (1.0f * (GetAsyncKeyState(VK_RIGHT) == 0) - 1.0f * (GetAsyncKeyState(VK_LEFT) == 0)) * delta_seconds;
@@ -26,9 +39,9 @@ void ExampleDriver::HMDDevice::Update()
     this->rot_x_ = std::fmax(this->rot_x_, -3.14159f/2);
     this->rot_x_ = std::fmin(this->rot_x_, 3.14159f/2);
 
-    linalg::vec<float, 4> y_quat{ 0, std::sinf(this->rot_y_ / 2), 0, std::cosf(this->rot_y_ / 2) };
+    linalg::vec<float, 4> y_quat{ 0, std::sin(this->rot_y_ / 2), 0, std::cos(this->rot_y_ / 2) };
 
-    linalg::vec<float, 4> x_quat{ std::sinf(this->rot_x_ / 2), 0, 0, std::cosf(this->rot_x_ / 2) };
+    linalg::vec<float, 4> x_quat{ std::sin(this->rot_x_ / 2), 0, 0, std::cos(this->rot_x_ / 2) };
 
     linalg::vec<float, 4> pose_rot = linalg::qmul(y_quat, x_quat);
 
@@ -54,7 +67,7 @@ void ExampleDriver::HMDDevice::Update()
     pose.vecPosition[2] = (float) this->pos_z_;
 
     // Post pose
-    GetDriver()->GetDriverHost()->TrackedDevicePoseUpdated(this->device_index_, pose, sizeof(vr::DriverPose_t));
+    GetDriver()->PostPose(this->device_index_, pose);
     this->last_pose_ = pose;
 }
 
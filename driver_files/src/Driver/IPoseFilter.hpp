@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+
+namespace ExampleDriver {
+
+    enum class PoseFilterType {
+        Regression,
+        Kalman,
+        OneEuro
+    };
+
+    /// <summary>
+    /// Parses the filter name used by the settings command: regression, kalman or oneeuro
+    /// </summary>
+    /// <returns>False if the name is not a known filter</returns>
+    inline bool ParsePoseFilterType(const std::string& name, PoseFilterType& type)
+    {
+        if (name == "regression")
+            type = PoseFilterType::Regression;
+        else if (name == "kalman")
+            type = PoseFilterType::Kalman;
+        else if (name == "oneeuro")
+            type = PoseFilterType::OneEuro;
+        else
+            return false;
+        return true;
+    }
+
+    /// <summary>
+    /// Turns the pose samples of one tracker into a pose at any requested time.
+    /// Poses are double[7]: x, y, z, qw, qx, qy, qz. Times are absolute capture times in seconds.
+    /// Implementations keep their state in fixed size members, so copying a filter or feeding it samples never allocates.
+    /// </summary>
+    class IPoseFilter {
+    public:
+        /// <summary>
+        /// Forgets every sample
+        /// </summary>
+        virtual void Reset() = 0;
+
+        /// <summary>
+        /// Forgets samples captured before oldest. Called for every incoming sample, even ones that end up dropped.
+        /// </summary>
+        virtual void Expire(double oldest) = 0;
+
+        /// <summary>
+        /// Feeds a sample to the filter
+        /// </summary>
+        /// <returns>False if the filter could not use the sample</returns>
+        virtual bool AddSample(double time, const double pose[]) = 0;
+
+        /// <summary>
+        /// Estimates the pose at time
+        /// </summary>
+        /// <returns>False if the filter has not seen enough samples yet, pose is left untouched then</returns>
+        virtual bool Predict(double time, double pose[]) const = 0;
+
+        /// <summary>
+        /// Estimates how fast the pose changes at time
+        /// </summary>
+        /// <param name="velocity">m/s</param>
+        /// <param name="angular_velocity">World frame axis times rad/s</param>
+        /// <returns>False if the filter has not seen enough samples yet</returns>
+        virtual bool Velocity(double time, double velocity[], double angular_velocity[]) const = 0;
+
+        virtual ~IPoseFilter() = default;
+    };
+}
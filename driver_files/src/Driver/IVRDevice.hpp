@@ -20,6 +20,13 @@ namespace ExampleDriver {
         /// </summary>
         virtual void Update() = 0;
 
+        /// <summary>
+        /// Receives an OpenVR event this device subscribed to with IVRDriver::SubscribeEvent.
+        /// Called from RunFrame, before the devices are updated.
+        /// </summary>
+        /// <param name="event">The event</param>
+        virtual void OnEvent(const vr::VREvent_t& event) {}
+
         /// <summary>
         /// Returns the OpenVR device index
         /// This should be 0 for HMDs
@@ -4,6 +4,7 @@
 #include <chrono>
 
 #include <Driver/IVRDevice.hpp>
+#include <Driver/Span.hpp>
 
 namespace ExampleDriver {
 
@@ -15,20 +16,29 @@ namespace ExampleDriver {
         /// <summary>
         /// Returns all devices being managed by this driver
         /// </summary>
-        /// <returns>All managed devices</returns>
-        virtual std::vector<std::shared_ptr<IVRDevice>> GetDevices() = 0;
+        /// <returns>All managed devices. The list never changes, adding a device publishes a new one.</returns>
+        virtual const std::vector<std::shared_ptr<IVRDevice>>& GetDevices() = 0;
 
         /// <summary>
-        /// Returns all OpenVR events that happened on the current frame
+        /// Returns the OpenVR events that happened on the current frame. A frame holds at most 64, the events of a
+        /// larger burst were already dispatched as they were polled and only the last of them are returned.
         /// </summary>
-        /// <returns>Current frame's OpenVR events</returns>
-        virtual std::vector<vr::VREvent_t> GetOpenVREvents() = 0;
+        /// <returns>Current frame's OpenVR events, only valid until the next frame and only to be read from RunFrame</returns>
+        virtual Span<const vr::VREvent_t> GetOpenVREvents() = 0;
 
         /// <summary>
-        /// Returns the milliseconds between last frame and this frame
+        /// Has events of a type sent to a device's OnEvent, instead of the device looking through GetOpenVREvents every frame
         /// </summary>
-        /// <returns>MS between last frame and this frame</returns>
-        virtual std::chrono::milliseconds GetLastFrameTime() = 0;
+        /// <param name="type">Event type</param>
+        /// <param name="target">Input component handle for input events such as haptic vibration, device index for all other events</param>
+        /// <param name="device">Device to receive the events</param>
+        virtual void SubscribeEvent(vr::EVREventType type, uint64_t target, IVRDevice* device) = 0;
+
+        /// <summary>
+        /// Returns the time between last frame and this frame
+        /// </summary>
+        /// <returns>Time between last frame and this frame, at full steady_clock resolution</returns>
+        virtual std::chrono::nanoseconds GetLastFrameTime() = 0;
 
         /// <summary>
         /// Adds a device to the driver
@@ -62,6 +72,19 @@ namespace ExampleDriver {
         /// <returns>OpenVR VRServerDriverHost pointer</returns>
         virtual vr::IVRServerDriverHost* GetDriverHost() = 0;
 
+        /// <summary>
+        /// Posts a device's pose to SteamVR, and to the session recording if one is running
+        /// </summary>
+        /// <param name="device_index">OpenVR device index</param>
+        /// <param name="pose">New pose</param>
+        virtual void PostPose(uint32_t device_index, const vr::DriverPose_t& pose) = 0;
+
+        /// <summary>
+        /// Stops the pose publisher thread if it runs, and waits for it. Devices it posts call this before they are
+        /// deactivated, so no pose is posted for a device SteamVR already let go of.
+        /// </summary>
+        virtual void StopPosePublisher() = 0;
+
         /// <summary>
         /// Writes a log message
         /// </summary>
@@ -0,0 +1,155 @@
+#include "KalmanFilter.hpp"
+
+#include <Driver/Quaternion.hpp>
+
+namespace {
+    //how unsure we are of the velocity of a tracker we just started seeing, (m/s)^2 or (rad/s)^2
+    constexpr double kInitialRateVariance = 1.0;
+}
+
+void ExampleDriver::KalmanFilter::Axis::Start(double start_value, double value_variance)
+{
+    value = start_value;
+    rate = 0;
+    p00 = value_variance;
+    p01 = 0;
+    p11 = kInitialRateVariance;
+}
+
+void ExampleDriver::KalmanFilter::Axis::Advance(double dt, double accel_variance)
+{
+    //x' = F x, P' = F P F^T + Q with F = [1 dt; 0 1] and Q the white acceleration noise over dt
+    double dt2 = dt * dt;
+    value += rate * dt;
+    p00 += 2 * dt * p01 + dt2 * p11 + accel_variance * dt2 * dt2 / 4;
+    p01 += dt * p11 + accel_variance * dt2 * dt / 2;
+    p11 += accel_variance * dt2;
+}
+
+void ExampleDriver::KalmanFilter::Axis::Correct(double measured, double measurement_variance)
+{
+    //only the value is measured, H = [1 0]
+    double s = p00 + measurement_variance;
+    double k0 = p00 / s;
+    double k1 = p01 / s;
+    double residual = measured - value;
+
+    value += k0 * residual;
+    rate += k1 * residual;
+
+    p11 -= k1 * p01;
+    p01 *= (1 - k0);
+    p00 *= (1 - k0);
+}
+
+void ExampleDriver::KalmanFilter::Configure(double process_noise, double measurement_noise)
+{
+    if (process_noise > 0)
+        process_noise_ = process_noise;
+    if (measurement_noise > 0)
+        measurement_noise_ = measurement_noise;
+}
+
+void ExampleDriver::KalmanFilter::Reset()
+{
+    initialized_ = false;
+}
+
+void ExampleDriver::KalmanFilter::Expire(double oldest)
+{
+    //a tracker that has been gone for a while starts over instead of coasting on its old velocity
+    if (initialized_ && last_time_ < oldest)
+        Reset();
+}
+
+bool ExampleDriver::KalmanFilter::AddSample(double time, const double pose[])
+{
+    double position_noise = measurement_noise_ * measurement_noise_;
+    double rotation_noise = position_noise * kRadiansPerMeter * kRadiansPerMeter;
+
+    if (!initialized_)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            position_[i].Start(pose[i], position_noise);
+            rotation_[i].Start(0, rotation_noise);
+        }
+        for (int i = 0; i < 4; i++)
+            orientation_[i] = pose[3 + i];
+        Quaternion::Normalize(orientation_);
+        last_time_ = time;
+        initialized_ = true;
+        return true;
+    }
+
+    if (time < last_time_)
+        return false;
+
+    double dt = time - last_time_;
+    last_time_ = time;
+
+    double position_accel = process_noise_ * process_noise_;
+    double rotation_accel = position_accel * kRadiansPerMeter * kRadiansPerMeter;
+
+    for (int i = 0; i < 3; i++)
+    {
+        position_[i].Advance(dt, position_accel);
+        position_[i].Correct(pose[i], position_noise);
+    }
+
+    //move the nominal orientation along the angular velocity, the error angles stay zero
+    double rate[3] = { rotation_[0].rate * dt, rotation_[1].rate * dt, rotation_[2].rate * dt };
+    double advanced[4];
+    Quaternion::Rotate(orientation_, rate, advanced);
+
+    double measured[4] = { pose[3], pose[4], pose[5], pose[6] };
+    Quaternion::Normalize(measured);
+    double error[3];
+    Quaternion::Difference(advanced, measured, error);
+
+    for (int i = 0; i < 3; i++)
+    {
+        rotation_[i].Advance(dt, rotation_accel);
+        rotation_[i].value = 0;     //already applied to the nominal orientation above
+        rotation_[i].Correct(error[i], rotation_noise);
+    }
+
+    //fold the estimated error angle back into the nominal orientation
+    double correction[3] = { rotation_[0].value, rotation_[1].value, rotation_[2].value };
+    Quaternion::Rotate(advanced, correction, orientation_);
+    for (int i = 0; i < 3; i++)
+        rotation_[i].value = 0;
+
+    return true;
+}
+
+bool ExampleDriver::KalmanFilter::Predict(double time, double pose[]) const
+{
+    if (!initialized_)
+        return false;
+
+    double dt = time - last_time_;
+    for (int i = 0; i < 3; i++)
+        pose[i] = position_[i].value + position_[i].rate * dt;
+
+    double rate[3] = { rotation_[0].rate * dt, rotation_[1].rate * dt, rotation_[2].rate * dt };
+    Quaternion::Rotate(orientation_, rate, pose + 3);
+    return true;
+}
+
+bool ExampleDriver::KalmanFilter::Velocity(double time, double velocity[], double angular_velocity[]) const
+{
+    double pose[7];
+    if (!Predict(time, pose))
+        return false;
+
+    double body_rate[3];
+    for (int i = 0; i < 3; i++)
+    {
+        velocity[i] = position_[i].rate;
+        body_rate[i] = rotation_[i].rate;
+    }
+    //the filter keeps the angular velocity in the frame of the tracker
+    Quaternion::RotateVector(pose + 3, body_rate, angular_velocity);
+    return true;
+}
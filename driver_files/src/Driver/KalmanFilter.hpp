@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Driver/IPoseFilter.hpp>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// Constant velocity Kalman filter. Position is filtered directly, rotation as an error state:
+    /// the filter keeps a nominal orientation and angular velocity and estimates the small rotation between the nominal
+    /// and the measured orientation, which is folded back into the nominal after every sample. That keeps the
+    /// quaternion unit length and avoids filtering its four components as if they were independent.
+    /// Samples have to arrive in capture order, late samples are dropped.
+    /// </summary>
+    class KalmanFilter : public IPoseFilter {
+    public:
+        static constexpr double kDefaultProcessNoise = 8.0;        // m/s^2, how hard a tracker can accelerate
+        static constexpr double kDefaultMeasurementNoise = 0.01;   // m, jitter of the incoming positions
+        static constexpr double kRadiansPerMeter = 2.0;            // rotation noise relative to the position noise
+
+        /// <summary>
+        /// Sets the noise model, values of zero or less keep the current setting
+        /// </summary>
+        void Configure(double process_noise, double measurement_noise);
+
+        // Inherited via IPoseFilter
+        virtual void Reset() override;
+        virtual void Expire(double oldest) override;
+        virtual bool AddSample(double time, const double pose[]) override;
+        virtual bool Predict(double time, double pose[]) const override;
+        virtual bool Velocity(double time, double velocity[], double angular_velocity[]) const override;
+
+    private:
+        // One axis of the constant velocity model with its 2x2 covariance. The noise is the same in every direction,
+        // so the three axes never correlate and can be filtered independently.
+        struct Axis {
+            double value = 0;
+            double rate = 0;
+            double p00 = 0;
+            double p01 = 0;
+            double p11 = 0;
+
+            void Start(double start_value, double value_variance);
+            void Advance(double dt, double accel_variance);
+            void Correct(double measured, double measurement_variance);
+        };
+
+        Axis position_[3];
+        Axis rotation_[3];              // value is the error angle, zero between samples, rate is the angular velocity
+        double orientation_[4] = { 1, 0, 0, 0 };
+        double last_time_ = 0;
+        bool initialized_ = false;
+
+        double process_noise_ = kDefaultProcessNoise;
+        double measurement_noise_ = kDefaultMeasurementNoise;
+    };
+}
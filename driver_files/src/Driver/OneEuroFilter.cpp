@@ -0,0 +1,126 @@
+#include "OneEuroFilter.hpp"
+
+#include <cmath>
+
+#include <Driver/Quaternion.hpp>
+
+namespace {
+    //smoothing factor of a first order low pass with the given cutoff over dt
+    double Alpha(double cutoff, double dt)
+    {
+        const double pi = 3.14159265358979323846;
+        double tau = 1.0 / (2 * pi * cutoff);
+        return 1.0 / (1.0 + tau / dt);
+    }
+}
+
+void ExampleDriver::OneEuroFilter::Configure(double min_cutoff, double beta)
+{
+    if (min_cutoff > 0)
+        min_cutoff_ = min_cutoff;
+    if (beta > 0)
+        beta_ = beta;
+}
+
+void ExampleDriver::OneEuroFilter::Reset()
+{
+    initialized_ = false;
+}
+
+void ExampleDriver::OneEuroFilter::Expire(double oldest)
+{
+    if (initialized_ && last_time_ < oldest)
+        Reset();
+}
+
+bool ExampleDriver::OneEuroFilter::AddSample(double time, const double pose[])
+{
+    if (!initialized_)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            position_[i] = pose[i];
+            last_position_[i] = pose[i];
+            velocity_[i] = 0;
+            angular_velocity_[i] = 0;
+        }
+        for (int i = 0; i < 4; i++)
+            orientation_[i] = pose[3 + i];
+        Quaternion::Normalize(orientation_);
+        for (int i = 0; i < 4; i++)
+            last_orientation_[i] = orientation_[i];
+        last_time_ = time;
+        initialized_ = true;
+        return true;
+    }
+
+    //the filter needs time to pass between samples
+    if (time <= last_time_)
+        return false;
+
+    double dt = time - last_time_;
+    last_time_ = time;
+    double derivative_alpha = Alpha(kDerivativeCutoff, dt);
+
+    for (int i = 0; i < 3; i++)
+    {
+        double raw_velocity = (pose[i] - last_position_[i]) / dt;
+        velocity_[i] += derivative_alpha * (raw_velocity - velocity_[i]);
+        double cutoff = min_cutoff_ + beta_ * std::abs(velocity_[i]);
+        position_[i] += Alpha(cutoff, dt) * (pose[i] - position_[i]);
+        last_position_[i] = pose[i];
+    }
+
+    double measured[4] = { pose[3], pose[4], pose[5], pose[6] };
+    Quaternion::Normalize(measured);
+    double raw_rotation[3];
+    Quaternion::Difference(last_orientation_, measured, raw_rotation);
+    for (int i = 0; i < 4; i++)
+        last_orientation_[i] = measured[i];
+
+    for (int i = 0; i < 3; i++)
+        angular_velocity_[i] += derivative_alpha * (raw_rotation[i] / dt - angular_velocity_[i]);
+    double speed = std::sqrt(angular_velocity_[0] * angular_velocity_[0] +
+        angular_velocity_[1] * angular_velocity_[1] +
+        angular_velocity_[2] * angular_velocity_[2]);
+
+    //slerp towards the measurement by the low pass factor
+    double delta[3];
+    Quaternion::Difference(orientation_, measured, delta);
+    double alpha = Alpha(min_cutoff_ + beta_ * speed, dt);
+    for (int i = 0; i < 3; i++)
+        delta[i] *= alpha;
+    double smoothed[4];
+    Quaternion::Rotate(orientation_, delta, smoothed);
+    for (int i = 0; i < 4; i++)
+        orientation_[i] = smoothed[i];
+
+    return true;
+}
+
+bool ExampleDriver::OneEuroFilter::Predict(double time, double pose[]) const
+{
+    if (!initialized_)
+        return false;
+
+    double dt = time - last_time_;
+    for (int i = 0; i < 3; i++)
+        pose[i] = position_[i] + velocity_[i] * dt;
+
+    double rotation[3] = { angular_velocity_[0] * dt, angular_velocity_[1] * dt, angular_velocity_[2] * dt };
+    Quaternion::Rotate(orientation_, rotation, pose + 3);
+    return true;
+}
+
+bool ExampleDriver::OneEuroFilter::Velocity(double time, double velocity[], double angular_velocity[]) const
+{
+    double pose[7];
+    if (!Predict(time, pose))
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        velocity[i] = velocity_[i];
+    //the filter keeps the angular velocity in the frame of the tracker
+    Quaternion::RotateVector(pose + 3, angular_velocity_, angular_velocity);
+    return true;
+}
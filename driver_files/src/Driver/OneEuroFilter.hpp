@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Driver/IPoseFilter.hpp>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// One Euro filter (Casiez et al. 2012): a low pass whose cutoff rises with speed, so a tracker at rest is smoothed
+    /// heavily while a moving one lags little. Rotation is smoothed along the sphere with its angular speed.
+    /// Predictions extrapolate along the filtered velocities. Samples have to arrive in capture order, late samples are dropped.
+    /// </summary>
+    class OneEuroFilter : public IPoseFilter {
+    public:
+        static constexpr double kDefaultMinCutoff = 1.5;     // Hz, smoothing at rest
+        static constexpr double kDefaultBeta = 2.0;          // how fast the cutoff rises with speed
+        static constexpr double kDerivativeCutoff = 1.0;     // Hz, smoothing of the speed itself
+
+        /// <summary>
+        /// Sets the filter parameters, values of zero or less keep the current setting
+        /// </summary>
+        void Configure(double min_cutoff, double beta);
+
+        // Inherited via IPoseFilter
+        virtual void Reset() override;
+        virtual void Expire(double oldest) override;
+        virtual bool AddSample(double time, const double pose[]) override;
+        virtual bool Predict(double time, double pose[]) const override;
+        virtual bool Velocity(double time, double velocity[], double angular_velocity[]) const override;
+
+    private:
+        double position_[3] = {};
+        double velocity_[3] = {};
+        double orientation_[4] = { 1, 0, 0, 0 };
+        double angular_velocity_[3] = {};
+        double last_position_[3] = {};          // raw previous sample, the speeds are measured between raw samples
+        double last_orientation_[4] = { 1, 0, 0, 0 };
+        double last_time_ = 0;
+        bool initialized_ = false;
+
+        double min_cutoff_ = kDefaultMinCutoff;
+        double beta_ = kDefaultBeta;
+    };
+}
@@ -0,0 +1,111 @@
+#ifdef _WIN32
+
+#include "Transport.hpp"
+#include <Windows.h>
+
+namespace {
+
+    std::string PipePath(const std::string& name)
+    {
+        return "\\\\.\\pipe\\" + name;
+    }
+
+    class PipeConnection : public ExampleDriver::IConnection {
+    public:
+        PipeConnection(HANDLE pipe, bool server):
+            pipe_(pipe),
+            server_(server)
+        {
+        }
+
+        ~PipeConnection()
+        {
+            if (server_)
+                DisconnectNamedPipe(pipe_);
+            CloseHandle(pipe_);
+        }
+
+        virtual int Receive(char* buffer, size_t size) override
+        {
+            DWORD dwRead;
+            //ERROR_MORE_DATA also returns FALSE, a message bigger than our buffer is treated as a broken client
+            if (ReadFile(pipe_, buffer, (DWORD)size, &dwRead, NULL) == FALSE)
+                return -1;
+            return (int)dwRead;
+        }
+
+        virtual bool Send(const char* data, size_t length) override
+        {
+            DWORD dwWritten;
+            return WriteFile(pipe_, data, (DWORD)length, &dwWritten, NULL) != FALSE;
+        }
+
+    private:
+        HANDLE pipe_;
+        bool server_;
+    };
+
+    class PipeServer : public ExampleDriver::ITransportServer {
+    public:
+        PipeServer(const std::string& name):
+            path_(PipePath(name))
+        {
+        }
+
+        virtual std::unique_ptr<ExampleDriver::IConnection> Accept() override
+        {
+            //every connected client gets its own instance of the pipe, so several apps can stay connected at once
+            HANDLE pipe = CreateNamedPipeA(path_.c_str(),
+                PIPE_ACCESS_DUPLEX,
+                PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
+                PIPE_UNLIMITED_INSTANCES,
+                ExampleDriver::kMaxMessageSize,
+                ExampleDriver::kMaxMessageSize,
+                NMPWAIT_USE_DEFAULT_WAIT,
+                NULL);
+
+            if (pipe == INVALID_HANDLE_VALUE)
+                return nullptr;
+
+            //a client may connect between CreateNamedPipe and ConnectNamedPipe, which is reported as ERROR_PIPE_CONNECTED
+            if (ConnectNamedPipe(pipe, NULL) == FALSE && GetLastError() != ERROR_PIPE_CONNECTED)
+            {
+                CloseHandle(pipe);
+                return nullptr;
+            }
+
+            return std::make_unique<PipeConnection>(pipe, true);
+        }
+
+    private:
+        std::string path_;
+    };
+}
+
+std::unique_ptr<ExampleDriver::ITransportServer> ExampleDriver::CreateTransportServer(const std::string& name)
+{
+    return std::make_unique<PipeServer>(name);
+}
+
+std::unique_ptr<ExampleDriver::IConnection> ExampleDriver::ConnectTransport(const std::string& name, int timeout_ms)
+{
+    std::string path = PipePath(name);
+
+    HANDLE pipe = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (pipe == INVALID_HANDLE_VALUE)
+    {
+        //all instances are busy accepting, wait for one to free up
+        if (!WaitNamedPipeA(path.c_str(), timeout_ms))
+            return nullptr;
+        pipe = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE)
+            return nullptr;
+    }
+
+    DWORD mode = PIPE_READMODE_MESSAGE;
+    SetNamedPipeHandleState(pipe, &mode, NULL, NULL);
+
+    return std::make_unique<PipeConnection>(pipe, false);
+}
+
+#endif
@@ -0,0 +1,227 @@
+#include "PoseBatch.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POSE_BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(POSE_BATCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define POSE_BATCH_TARGET(isa) __attribute__((target(isa)))
+#else
+#define POSE_BATCH_TARGET(isa)
+#endif
+
+namespace {
+    using ExampleDriver::SampleRing;
+
+    // Every kernel fits lanes [0, stride) with the same sequence of operations as RegressionFilter::Predict:
+    //   slope = (avg(tv) - avg(v) avg(t)) / (avg(t2) - avg(t)^2), y = avg(v) + slope (eval - avg(t)),
+    //   and y = avg(v), slope = 0 when the channel barely moves.
+    // Rows are passed in PoseBatch order: count, t, t2, eval, v[7], v2[7], tv[7], pred[7], slope[7].
+    struct Rows {
+        const double* count;
+        const double* t;
+        const double* t2;
+        const double* eval;
+        const double* v[SampleRing::kChannels];
+        const double* v2[SampleRing::kChannels];
+        const double* tv[SampleRing::kChannels];
+        double* pred[SampleRing::kChannels];
+        double* slope[SampleRing::kChannels];
+    };
+
+    constexpr double kFlatVariance = 0.00000001;
+
+    void PredictScalar(const Rows& r, size_t stride)
+    {
+        for (size_t l = 0; l < stride; l++)
+        {
+            double n = r.count[l];
+            double avg_time = r.t[l] / n;
+            double var_time = (r.t2[l] / n) - (avg_time * avg_time);
+            double dt = r.eval[l] - avg_time;
+            for (int c = 0; c < SampleRing::kChannels; c++)
+            {
+                double avg_val = r.v[c][l] / n;
+                double avg_val2 = r.v2[c][l] / n;
+                double avg_tval = r.tv[c][l] / n;
+
+                double b = (avg_tval - (avg_val * avg_time)) / var_time;
+                double y = avg_val + b * dt;
+                if (std::abs(avg_val2 - (avg_val * avg_val)) < kFlatVariance)
+                {
+                    y = avg_val;
+                    b = 0;
+                }
+                r.pred[c][l] = y;
+                r.slope[c][l] = b;
+            }
+        }
+    }
+
+#ifdef POSE_BATCH_X86
+    POSE_BATCH_TARGET("sse2")
+    void PredictSse2(const Rows& r, size_t stride)
+    {
+        const __m128d sign = _mm_set1_pd(-0.0);
+        const __m128d flat = _mm_set1_pd(kFlatVariance);
+        for (size_t l = 0; l < stride; l += 2)
+        {
+            __m128d n = _mm_loadu_pd(r.count + l);
+            __m128d avg_time = _mm_div_pd(_mm_loadu_pd(r.t + l), n);
+            __m128d var_time = _mm_sub_pd(_mm_div_pd(_mm_loadu_pd(r.t2 + l), n), _mm_mul_pd(avg_time, avg_time));
+            __m128d dt = _mm_sub_pd(_mm_loadu_pd(r.eval + l), avg_time);
+            for (int c = 0; c < SampleRing::kChannels; c++)
+            {
+                __m128d avg_val = _mm_div_pd(_mm_loadu_pd(r.v[c] + l), n);
+                __m128d avg_val2 = _mm_div_pd(_mm_loadu_pd(r.v2[c] + l), n);
+                __m128d avg_tval = _mm_div_pd(_mm_loadu_pd(r.tv[c] + l), n);
+
+                __m128d b = _mm_div_pd(_mm_sub_pd(avg_tval, _mm_mul_pd(avg_val, avg_time)), var_time);
+                __m128d y = _mm_add_pd(avg_val, _mm_mul_pd(b, dt));
+                __m128d var_val = _mm_andnot_pd(sign, _mm_sub_pd(avg_val2, _mm_mul_pd(avg_val, avg_val)));
+                __m128d is_flat = _mm_cmplt_pd(var_val, flat);
+                y = _mm_or_pd(_mm_and_pd(is_flat, avg_val), _mm_andnot_pd(is_flat, y));
+                b = _mm_andnot_pd(is_flat, b);
+                _mm_storeu_pd(r.pred[c] + l, y);
+                _mm_storeu_pd(r.slope[c] + l, b);
+            }
+        }
+    }
+
+    POSE_BATCH_TARGET("avx")
+    void PredictAvx(const Rows& r, size_t stride)
+    {
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        const __m256d flat = _mm256_set1_pd(kFlatVariance);
+        for (size_t l = 0; l < stride; l += 4)
+        {
+            __m256d n = _mm256_loadu_pd(r.count + l);
+            __m256d avg_time = _mm256_div_pd(_mm256_loadu_pd(r.t + l), n);
+            __m256d var_time = _mm256_sub_pd(_mm256_div_pd(_mm256_loadu_pd(r.t2 + l), n), _mm256_mul_pd(avg_time, avg_time));
+            __m256d dt = _mm256_sub_pd(_mm256_loadu_pd(r.eval + l), avg_time);
+            for (int c = 0; c < SampleRing::kChannels; c++)
+            {
+                __m256d avg_val = _mm256_div_pd(_mm256_loadu_pd(r.v[c] + l), n);
+                __m256d avg_val2 = _mm256_div_pd(_mm256_loadu_pd(r.v2[c] + l), n);
+                __m256d avg_tval = _mm256_div_pd(_mm256_loadu_pd(r.tv[c] + l), n);
+
+                __m256d b = _mm256_div_pd(_mm256_sub_pd(avg_tval, _mm256_mul_pd(avg_val, avg_time)), var_time);
+                __m256d y = _mm256_add_pd(avg_val, _mm256_mul_pd(b, dt));
+                __m256d var_val = _mm256_andnot_pd(sign, _mm256_sub_pd(avg_val2, _mm256_mul_pd(avg_val, avg_val)));
+                __m256d is_flat = _mm256_cmp_pd(var_val, flat, _CMP_LT_OQ);
+                y = _mm256_blendv_pd(y, avg_val, is_flat);
+                b = _mm256_andnot_pd(is_flat, b);
+                _mm256_storeu_pd(r.pred[c] + l, y);
+                _mm256_storeu_pd(r.slope[c] + l, b);
+            }
+        }
+    }
+
+    bool CpuHasAvx()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        //the OS also has to save the upper halves of the ymm registers
+        return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+        return __builtin_cpu_supports("avx");
+#endif
+    }
+
+    bool CpuHasSse2()
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        return true;
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+#else
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+#endif
+
+    using Kernel = void (*)(const Rows&, size_t);
+
+    Kernel SelectKernel()
+    {
+#ifdef POSE_BATCH_X86
+        if (CpuHasAvx())
+            return PredictAvx;
+        if (CpuHasSse2())
+            return PredictSse2;
+#endif
+        return PredictScalar;
+    }
+}
+
+void ExampleDriver::PoseBatch::Resize(size_t lanes)
+{
+    lanes_ = lanes;
+    size_t stride = (lanes + kLaneGroup - 1) / kLaneGroup * kLaneGroup;
+    if (stride == stride_)
+        return;
+
+    //the kernels also run over the padding lanes, nobody reads what comes out of them
+    stride_ = stride;
+    data_.assign(kRows * stride_, 0.0);
+    status_.assign(stride_, -1);
+}
+
+void ExampleDriver::PoseBatch::Load(size_t lane, int status, const SampleRing::Moments& moments, int count, double eval_time)
+{
+    status_[lane] = status;
+    RowData(kCount)[lane] = count;
+    RowData(kTime)[lane] = moments.t;
+    RowData(kTime2)[lane] = moments.t2;
+    RowData(kEvalTime)[lane] = eval_time;
+    for (int c = 0; c < SampleRing::kChannels; c++)
+    {
+        RowData(kValue + c)[lane] = moments.v[c];
+        RowData(kValue2 + c)[lane] = moments.v2[c];
+        RowData(kTimeValue + c)[lane] = moments.tv[c];
+    }
+}
+
+void ExampleDriver::PoseBatch::Predict()
+{
+    //picked once, the CPU does not change under us
+    static const Kernel kernel = SelectKernel();
+
+    Rows rows;
+    rows.count = RowData(kCount);
+    rows.t = RowData(kTime);
+    rows.t2 = RowData(kTime2);
+    rows.eval = RowData(kEvalTime);
+    for (int c = 0; c < SampleRing::kChannels; c++)
+    {
+        rows.v[c] = RowData(kValue + c);
+        rows.v2[c] = RowData(kValue2 + c);
+        rows.tv[c] = RowData(kTimeValue + c);
+        rows.pred[c] = RowData(kPrediction + c);
+        rows.slope[c] = RowData(kSlope + c);
+    }
+    kernel(rows, stride_);
+}
+
+void ExampleDriver::PoseBatch::GetPrediction(size_t lane, double pred[]) const
+{
+    for (int c = 0; c < SampleRing::kChannels; c++)
+        pred[c] = RowData(kPrediction + c)[lane];
+}
+
+void ExampleDriver::PoseBatch::GetSlope(size_t lane, double slope[]) const
+{
+    for (int c = 0; c < SampleRing::kChannels; c++)
+        slope[c] = RowData(kSlope + c)[lane];
+}
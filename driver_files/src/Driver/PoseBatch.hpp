@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Driver/SampleRing.hpp>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// One prediction pass over every tracker. Inputs and results are stored row by row with one lane per tracker,
+    /// so Predict fits all channels of all trackers in a single vectorized loop instead of once per tracker.
+    /// Predict uses AVX or SSE2 when the CPU has them and plain C++ otherwise, all three give the same results
+    /// as RegressionFilter::Predict.
+    /// </summary>
+    class PoseBatch {
+    public:
+        static constexpr size_t kLaneGroup = 4;     // lanes are padded to the widest vector
+
+        /// <summary>
+        /// Makes room for lanes trackers, only allocates when the padded lane count changes
+        /// </summary>
+        void Resize(size_t lanes);
+
+        size_t Size() const { return lanes_; }
+
+        /// <summary>
+        /// Loads the running sums of one tracker
+        /// </summary>
+        /// <param name="status">predict_pose status of this tracker, kept for whoever applies the result</param>
+        /// <param name="eval_time">Time to predict at, relative to moments.origin</param>
+        void Load(size_t lane, int status, const SampleRing::Moments& moments, int count, double eval_time);
+
+        /// <summary>
+        /// Fits every loaded lane
+        /// </summary>
+        void Predict();
+
+        int Status(size_t lane) const { return status_[lane]; }
+        void GetPrediction(size_t lane, double pred[]) const;
+
+        /// <summary>
+        /// Rate of change of every channel per second, zero for channels that did not move
+        /// </summary>
+        void GetSlope(size_t lane, double slope[]) const;
+
+    private:
+        // row layout of data_, every row is stride_ lanes long
+        enum Row {
+            kCount,
+            kTime,
+            kTime2,
+            kEvalTime,
+            kValue,
+            kValue2 = kValue + SampleRing::kChannels,
+            kTimeValue = kValue2 + SampleRing::kChannels,
+            kPrediction = kTimeValue + SampleRing::kChannels,
+            kSlope = kPrediction + SampleRing::kChannels,
+            kRows = kSlope + SampleRing::kChannels
+        };
+
+        double* RowData(int row) { return data_.data() + row * stride_; }
+        const double* RowData(int row) const { return data_.data() + row * stride_; }
+
+        std::vector<double> data_;
+        std::vector<int> status_;
+        size_t lanes_ = 0;
+        size_t stride_ = 0;
+    };
+}
@@ -0,0 +1,303 @@
+#include "PoseFusion.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Driver/Quaternion.hpp>
+
+namespace {
+    constexpr double kVarianceRate = 0.05;      // how fast a source's error estimate follows its residuals
+
+    double Distance(const double a[], const double b[])
+    {
+        double dx = a[0] - b[0];
+        double dy = a[1] - b[1];
+        double dz = a[2] - b[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+}
+
+void ExampleDriver::PoseFusion::Configure(double window)
+{
+    window_ = std::max(0.0, window);
+    slot_count_ = 0;
+    for (Source& source : sources_)
+        source = Source();
+}
+
+int ExampleDriver::PoseFusion::Add(uint32_t source, const double pose[], double time, double now, const IPoseFilter& motion, Sample out[])
+{
+    if (window_ <= 0 || source == kNoSource)
+    {
+        for (int i = 0; i < 7; i++)
+            out[0].pose[i] = pose[i];
+        out[0].time = time;
+        out[0].observations = 1;
+        return 1;
+    }
+
+    int count = 0;
+    if (slot_count_ == kMaxSources && Close(now, motion, out[count]))
+        count++;
+
+    Source& from = FindSource(source, now);
+    if (from.seen > 0)
+    {
+        double interval = now - from.last_seen;
+        from.interval = from.seen == 1 ? interval : from.interval * 0.9 + interval * 0.1;
+    }
+    from.last_seen = now;
+    from.seen++;
+    int index = int(&from - sources_);
+
+    //a second observation by the same source, or one captured too far from the slot, belongs to another moment
+    if (slot_count_ > 0)
+    {
+        bool repeated = false;
+        for (int i = 0; i < slot_count_; i++)
+            repeated = repeated || slot_[i].source == index;
+        if ((repeated || std::abs(time - slot_start_) > window_) && Close(now, motion, out[count]))
+            count++;
+    }
+
+    if (slot_count_ == 0)
+    {
+        slot_start_ = time;
+        slot_opened_ = now;
+    }
+    Observation& observation = slot_[slot_count_++];
+    observation.source = index;
+    for (int i = 0; i < 7; i++)
+        observation.pose[i] = pose[i];
+    observation.time = time;
+
+    if (Complete(now) && Close(now, motion, out[count]))
+        count++;
+    return count;
+}
+
+bool ExampleDriver::PoseFusion::Flush(double now, double lead, const IPoseFilter& motion, Sample& out)
+{
+    //waiting for the next flush would keep the slot open past its window, up to a whole frame of added latency
+    if (slot_count_ == 0 || now + std::max(0.0, lead) - slot_opened_ < window_)
+        return false;
+
+    return Close(now, motion, out);
+}
+
+int ExampleDriver::PoseFusion::GetStats(SourceStats out[], int max) const
+{
+    int count = 0;
+    for (const Source& source : sources_)
+    {
+        if (!source.used || count >= max)
+            continue;
+        out[count++] = SourceStats{ source.id, std::sqrt(source.variance), source.accepted, source.rejected };
+    }
+    return count;
+}
+
+ExampleDriver::PoseFusion::Source& ExampleDriver::PoseFusion::FindSource(uint32_t id, double now)
+{
+    for (Source& source : sources_)
+    {
+        if (source.used && source.id == id)
+            return source;
+    }
+
+    //replace the source seen longest ago, but never one waiting in the open slot
+    Source* oldest = nullptr;
+    for (int i = 0; i < kMaxSources; i++)
+    {
+        bool in_slot = false;
+        for (int j = 0; j < slot_count_; j++)
+            in_slot = in_slot || slot_[j].source == i;
+        if (in_slot)
+            continue;
+        if (!sources_[i].used)
+        {
+            oldest = &sources_[i];
+            break;
+        }
+        if (oldest == nullptr || sources_[i].last_seen < oldest->last_seen)
+            oldest = &sources_[i];
+    }
+
+    *oldest = Source();
+    oldest->id = id;
+    oldest->used = true;
+    oldest->last_seen = now;
+    return *oldest;
+}
+
+bool ExampleDriver::PoseFusion::Active(const Source& source, double now) const
+{
+    //a source is waited for once it sends regularly, until it misses about one of its own frames.
+    //Sources are the cameras clients name, so a client that connects for every message (CallNamedPipe) counts as well.
+    return source.used && source.seen >= 2 && now - source.last_seen < source.interval * 1.5;
+}
+
+bool ExampleDriver::PoseFusion::Complete(double now) const
+{
+    for (int i = 0; i < kMaxSources; i++)
+    {
+        if (!Active(sources_[i], now))
+            continue;
+        bool in_slot = false;
+        for (int j = 0; j < slot_count_; j++)
+            in_slot = in_slot || slot_[j].source == i;
+        if (!in_slot)
+            return false;
+    }
+    return true;
+}
+
+bool ExampleDriver::PoseFusion::Close(double now, const IPoseFilter& motion, Sample& out)
+{
+    int count = slot_count_;
+    slot_count_ = 0;
+
+    double weight[kMaxSources];
+    double total = 0;
+    double time = 0;
+    for (int i = 0; i < count; i++)
+    {
+        weight[i] = 1.0 / sources_[slot_[i].source].variance;
+        total += weight[i];
+        time += weight[i] * slot_[i].time;
+    }
+    time /= total;
+
+    //move every observation along the tracker's velocity to the slot time, cameras rarely capture at the same moment
+    double velocity[3] = { 0, 0, 0 };
+    double angular_velocity[3];
+    if (count > 1 && !motion.Velocity(time, velocity, angular_velocity))
+        velocity[0] = velocity[1] = velocity[2] = 0;
+
+    double position[kMaxSources][3];
+    bool accepted[kMaxSources];
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            position[i][j] = slot_[i].pose[j] + velocity[j] * (time - slot_[i].time);
+        accepted[i] = true;
+    }
+
+    if (count == 1)
+    {
+        //nothing to compare with but the prediction, and only worth it if the other cameras keep the tracker going
+        bool watched = false;
+        for (int i = 0; i < kMaxSources; i++)
+            watched = watched || (i != slot_[0].source && Active(sources_[i], now));
+
+        double predicted[7];
+        if (watched && motion.Predict(time, predicted) && Distance(position[0], predicted) > kPredictionGate)
+            accepted[0] = false;
+    }
+    else if (count == 2)
+    {
+        //two sources cannot outvote each other, the tracker's own prediction decides which one is off
+        double variance0 = sources_[slot_[0].source].variance;
+        double variance1 = sources_[slot_[1].source].variance;
+        double gate = std::max(kGate * std::sqrt(variance0 + variance1), kMinGate);
+        if (Distance(position[0], position[1]) > gate)
+        {
+            double predicted[7];
+            int keep;
+            if (motion.Predict(time, predicted))
+            {
+                //both can be off at once, the one kept still has to be near the prediction
+                keep = Distance(position[0], predicted) <= Distance(position[1], predicted) ? 0 : 1;
+                accepted[keep] = Distance(position[keep], predicted) <= kPredictionGate;
+            }
+            else
+            {
+                keep = variance0 <= variance1 ? 0 : 1;
+            }
+            accepted[1 - keep] = false;
+        }
+    }
+    else if (count > 2)
+    {
+        //the median of every axis stays put when a minority of the sources is wrong
+        double median[3];
+        for (int j = 0; j < 3; j++)
+        {
+            double values[kMaxSources];
+            for (int i = 0; i < count; i++)
+                values[i] = position[i][j];
+            std::sort(values, values + count);
+            median[j] = count % 2 == 1 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+        }
+
+        int kept = 0;
+        int closest = 0;
+        double closest_distance = 0;
+        for (int i = 0; i < count; i++)
+        {
+            double distance = Distance(position[i], median);
+            accepted[i] = distance <= std::max(kGate * std::sqrt(sources_[slot_[i].source].variance), kMinGate);
+            kept += accepted[i];
+            if (i == 0 || distance < closest_distance)
+            {
+                closest = i;
+                closest_distance = distance;
+            }
+        }
+        if (kept == 0)
+            accepted[closest] = true;
+    }
+
+    //inverse variance weighted mean of what is left, rotations flipped onto the same hemisphere first
+    const double* reference = nullptr;
+    double fused[7] = { 0, 0, 0, 0, 0, 0, 0 };
+    double accepted_total = 0;
+    int accepted_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!accepted[i])
+            continue;
+        const double* rotation = slot_[i].pose + 3;
+        if (reference == nullptr)
+            reference = rotation;
+        double sign = rotation[0] * reference[0] + rotation[1] * reference[1] + rotation[2] * reference[2] + rotation[3] * reference[3] < 0 ? -1 : 1;
+        for (int j = 0; j < 3; j++)
+            fused[j] += weight[i] * position[i][j];
+        for (int j = 0; j < 4; j++)
+            fused[3 + j] += sign * weight[i] * rotation[j];
+        accepted_total += weight[i];
+        accepted_count++;
+    }
+    if (accepted_count == 0)
+        return false;
+    for (int j = 0; j < 3; j++)
+        fused[j] /= accepted_total;
+    if (accepted_count > 1)
+        Quaternion::Normalize(fused + 3);
+
+    //learn every source's error from how far it landed from the others. The fused pose leans towards each
+    //observation by its share of the weight, dividing that out keeps the estimate unbiased.
+    for (int i = 0; i < count; i++)
+    {
+        Source& source = sources_[slot_[i].source];
+        if (!accepted[i])
+        {
+            source.rejected++;
+            continue;
+        }
+
+        source.accepted++;
+        double share = weight[i] / accepted_total;
+        if (accepted_count < 2 || share > 0.95)
+            continue;
+        double residual = Distance(position[i], fused);
+        double variance = source.variance * (1 - kVarianceRate) + kVarianceRate * residual * residual / (1 - share);
+        source.variance = std::min(kMaxVariance, std::max(kMinVariance, variance));
+    }
+
+    for (int j = 0; j < 7; j++)
+        out.pose[j] = fused[j];
+    out.time = time;
+    out.observations = accepted_count;
+    return true;
+}
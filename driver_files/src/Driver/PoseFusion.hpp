@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+
+#include <Driver/IPoseFilter.hpp>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// Combines what several cameras (sources) see of one tracker into one sample per time slot, instead of feeding the
+    /// filter every camera's sample and letting their disagreement show up as jitter.
+    /// A slot opens with the first observation and takes every observation captured within the window of it. It closes
+    /// once every active source has contributed, when a source sends a second observation, or a window after it opened.
+    /// Observations are weighted by the inverse of their source's error variance, which is learned from how far each
+    /// source lands from the fused poses. Sources that disagree with the others are rejected: with three or more
+    /// observations by their distance from the median, with two by the tracker's own prediction. A lone observation
+    /// while other cameras are watching is checked against the prediction only, with a looser gate.
+    /// With a single source every observation closes its slot right away and passes through unchanged.
+    /// Sources are cameras named by the client, observations without a camera (kNoSource) are never fused.
+    /// Keeps everything in fixed size members, adding observations never allocates.
+    /// </summary>
+    class PoseFusion {
+    public:
+        static constexpr int kMaxSources = 8;               // per tracker, the source seen longest ago is replaced beyond that
+        static constexpr uint32_t kNoSource = 0;            // the client did not say which camera saw the pose
+        static constexpr double kPriorVariance = 1e-4;      // m^2, 1 cm rms until a source has been compared with others
+        static constexpr double kMinVariance = 1e-6;
+        static constexpr double kMaxVariance = 1e-2;
+        static constexpr double kGate = 3;                  // standard deviations a consistent observation may be off
+        static constexpr double kMinGate = 0.03;            // m, never reject closer than this
+        static constexpr double kPredictionGate = 0.1;      // m, the prediction is itself off by a few cm when the tracker turns quickly
+
+        /// <summary>
+        /// A fused sample: pose as double[7] like the filters take, time is the capture time in session seconds
+        /// </summary>
+        struct Sample {
+            double pose[7];
+            double time;
+            int observations;       // how many observations were fused, rejected ones not counted
+        };
+
+        struct SourceStats {
+            uint32_t id;
+            double rms;             // m, learned error of the source
+            uint64_t accepted;
+            uint64_t rejected;
+        };
+
+        /// <summary>
+        /// Sets the slot width in seconds, 0 (the default) passes every observation straight through. Forgets every source.
+        /// </summary>
+        void Configure(double window);
+        double Window() const { return window_; }
+
+        /// <summary>
+        /// Adds an observation of the tracker by source, captured at time and received at now (session seconds).
+        /// motion is the tracker's filter, used to move observations to the slot time and to settle disagreements.
+        /// An observation by kNoSource passes straight through and leaves the open slot alone.
+        /// </summary>
+        /// <param name="out">Gets the samples this closed, room for two: the slot the observation did not fit in and its own</param>
+        /// <returns>The number of samples written to out</returns>
+        int Add(uint32_t source, const double pose[], double time, double now, const IPoseFilter& motion, Sample out[]);
+
+        /// <summary>
+        /// Closes the open slot if its window runs out before the next flush, so no slot waits longer than the window
+        /// </summary>
+        /// <param name="lead">Seconds until the caller flushes again</param>
+        /// <returns>True if a sample was written to out</returns>
+        bool Flush(double now, double lead, const IPoseFilter& motion, Sample& out);
+
+        /// <summary>
+        /// Copies the stats of up to max known sources
+        /// </summary>
+        /// <returns>The number of sources copied</returns>
+        int GetStats(SourceStats out[], int max) const;
+
+    private:
+        struct Source {
+            uint32_t id = kNoSource;
+            bool used = false;
+            double variance = kPriorVariance;
+            double last_seen = 0;   // receive time of its newest observation
+            double interval = 0;    // smoothed seconds between its observations
+            uint64_t seen = 0;
+            uint64_t accepted = 0;
+            uint64_t rejected = 0;
+        };
+
+        struct Observation {
+            int source;             // index into sources_
+            double pose[7];
+            double time;
+        };
+
+        Source& FindSource(uint32_t id, double now);
+        bool Active(const Source& source, double now) const;
+        bool Complete(double now) const;
+        // False if every observation in the slot was rejected
+        bool Close(double now, const IPoseFilter& motion, Sample& out);
+
+        double window_ = 0;
+        Source sources_[kMaxSources];
+        Observation slot_[kMaxSources];
+        int slot_count_ = 0;
+        double slot_start_ = 0;     // capture time of the observation that opened the slot
+        double slot_opened_ = 0;    // and when it was received
+    };
+}
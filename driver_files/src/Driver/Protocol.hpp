@@ -0,0 +1,258 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace ExampleDriver {
+    namespace Protocol {
+
+        // Every binary message starts with this, so it can never be mistaken for a text command ("APTB" in memory)
+        constexpr uint32_t kMagic = 0x42545041;
+
+        // Bump whenever the layout of any message below changes
+        constexpr uint16_t kVersion = 3;
+
+        // Most pose samples a single UpdatePoseBatch message can carry
+        constexpr uint32_t kMaxBatchSize = 32;
+
+        // Header flags
+        constexpr uint32_t kFlagNoReply = 1;        // fire and forget, the driver sends no reply, not even on errors
+
+        enum class MessageType : uint16_t {
+            // requests
+            Handshake = 1,
+            UpdatePose = 2,
+            UpdateStation = 3,
+            GetTrackerPose = 4,
+            HipMoveInput = 5,
+            UpdatePoseBatch = 6,
+            ClockSync = 7,
+            UpdatePoseAt = 8,       // an UpdatePoseMessage whose time is the absolute capture time, in driver session seconds
+
+            // replies
+            HandshakeReply = 0x81,
+            StatusReply = 0x82,
+            TrackerPoseReply = 0x84,
+            BatchStatusReply = 0x86,
+            ClockSyncReply = 0x87,
+        };
+
+        enum class Status : int32_t {
+            Updated = 0,
+            IdInvalid = 1,
+            NotSpawned = 2,
+            Unrecognized = 3,
+            VersionMismatch = 4,
+            Malformed = 5,
+            Dropped = 6,
+        };
+
+#pragma pack(push, 1)
+        struct Header {
+            uint32_t magic;
+            uint16_t version;
+            MessageType type;
+            uint32_t request_id;    // chosen by the client, echoed in the reply so replies can be matched to requests
+            uint32_t flags;
+        };
+
+        struct HandshakeMessage {
+            Header header;
+            uint16_t client_version;
+        };
+
+        struct HandshakeReply {
+            Header header;
+            uint16_t driver_version;
+        };
+
+        struct UpdatePoseMessage {
+            Header header;
+            uint32_t idx;
+            uint32_t source;        // id of the camera that saw the pose, 0 for none, see PoseFusion
+            double position[3];
+            double rotation[4];     // w, x, y, z
+            double time;            // how long ago the pose was captured, in seconds
+            double smoothing;
+        };
+
+        struct UpdateStationMessage {
+            Header header;
+            uint32_t idx;
+            double position[3];
+            double rotation[4];     // w, x, y, z
+        };
+
+        struct GetTrackerPoseMessage {
+            Header header;
+            uint32_t idx;
+            double time_offset;
+        };
+
+        struct HipMoveInputMessage {
+            Header header;
+            float x, y, rx, ry, a, b;
+        };
+
+        struct PoseSample {
+            uint32_t idx;
+            uint32_t source;        // as in UpdatePoseMessage
+            double position[3];
+            double rotation[4];     // w, x, y, z
+            double time;            // how long ago the pose was captured, in seconds
+        };
+
+        // Only the first count samples are sent, see BatchMessageSize
+        struct UpdatePoseBatchMessage {
+            Header header;
+            uint32_t count;
+            PoseSample samples[kMaxBatchSize];
+        };
+
+        struct ClockSyncMessage {
+            Header header;
+            double client_time;     // client clock when sent, in seconds
+        };
+
+        struct StatusReply {
+            Header header;
+            Status status;
+        };
+
+        struct TrackerPoseReply {
+            Header header;
+            Status status;
+            uint32_t idx;
+            double pose[7];         // x, y, z, qw, qx, qy, qz
+            int32_t prediction_status;
+        };
+
+        // All times in seconds. Receive and reply time are on the driver session clock, offset and drift are the driver's
+        // estimate of this connection's clock, see ClockSync.
+        struct ClockSyncReply {
+            Header header;
+            double client_time;     // echoed from the request
+            double receive_time;
+            double reply_time;
+            double offset;          // driver session time - client time, at client_time
+            double drift;
+        };
+
+        // One Status per sample of the batch, in the order they were sent. Only the first count entries are sent.
+        struct BatchStatusReply {
+            Header header;
+            uint32_t count;
+            uint8_t status[kMaxBatchSize];
+        };
+#pragma pack(pop)
+
+        inline constexpr size_t BatchMessageSize(uint32_t count)
+        {
+            return offsetof(UpdatePoseBatchMessage, samples) + count * sizeof(PoseSample);
+        }
+
+        inline constexpr size_t BatchReplySize(uint32_t count)
+        {
+            return offsetof(BatchStatusReply, status) + count * sizeof(uint8_t);
+        }
+
+        // Magic, version and type are laid out the same in every protocol version, so a client on another version
+        // is still recognized and told which version the driver speaks
+        constexpr size_t kMinHeaderSize = offsetof(Header, request_id);
+
+        inline Header MakeHeader(MessageType type, uint32_t request_id = 0, uint32_t flags = 0)
+        {
+            return Header{ kMagic, kVersion, type, request_id, flags };
+        }
+
+        /// <summary>
+        /// Checks whether a received pipe message uses the binary encoding
+        /// </summary>
+        /// <returns>True if the message starts with a binary protocol header</returns>
+        inline bool IsBinaryMessage(const char* data, size_t length)
+        {
+            uint32_t magic;
+            if (length < kMinHeaderSize)
+                return false;
+            std::memcpy(&magic, data, sizeof(magic));
+            return magic == kMagic;
+        }
+
+        /// <summary>
+        /// Reads the header of a binary message, also from clients on other protocol versions
+        /// </summary>
+        /// <returns>The header, with the fields the message is too short for set to 0</returns>
+        inline Header DecodeHeader(const char* data, size_t length)
+        {
+            Header header{};
+            std::memcpy(&header, data, length < sizeof(Header) ? length : sizeof(Header));
+            return header;
+        }
+
+        /// <summary>
+        /// Checks whether the driver answers a message, every text message and binary message is answered unless sent
+        /// with kFlagNoReply
+        /// </summary>
+        inline bool ExpectsReply(const char* data, size_t length)
+        {
+            if (!IsBinaryMessage(data, length))
+                return true;
+            Header header = DecodeHeader(data, length);
+            return header.version != kVersion || (header.flags & kFlagNoReply) == 0;
+        }
+
+        /// <summary>
+        /// Copies a fixed size message out of the receive buffer. Messages are packed, so this avoids unaligned access.
+        /// </summary>
+        /// <returns>False if the buffer is too short for the message type</returns>
+        template<typename T>
+        inline bool Decode(const char* data, size_t length, T& out)
+        {
+            if (length < sizeof(T))
+                return false;
+            std::memcpy(&out, data, sizeof(T));
+            return true;
+        }
+
+        template<typename T>
+        inline size_t Encode(const T& message, char* out, size_t size, size_t used = sizeof(T))
+        {
+            if (size < used)
+                return 0;
+            std::memcpy(out, &message, used);
+            return used;
+        }
+
+        /// <summary>
+        /// Encodes a reply to a client on another protocol version the way version 1 laid replies out: magic, version and
+        /// type (kMinHeaderSize bytes), then the body. A version 1 client finds the driver version of a HandshakeReply or
+        /// the Status of a StatusReply right after them, later versions only need the version in the header.
+        /// </summary>
+        template<typename T>
+        inline size_t EncodeBaseReply(MessageType type, const T& body, char* out, size_t size)
+        {
+            if (size < kMinHeaderSize + sizeof(T))
+                return 0;
+            Header header = MakeHeader(type);
+            std::memcpy(out, &header, kMinHeaderSize);
+            std::memcpy(out + kMinHeaderSize, &body, sizeof(T));
+            return kMinHeaderSize + sizeof(T);
+        }
+
+        /// <summary>
+        /// Copies a batch message out of the receive buffer, validating that all announced samples are present
+        /// </summary>
+        /// <returns>False if the count is too large or the buffer is too short</returns>
+        inline bool DecodeBatch(const char* data, size_t length, UpdatePoseBatchMessage& out)
+        {
+            if (length < BatchMessageSize(0))
+                return false;
+            std::memcpy(&out, data, BatchMessageSize(0));
+            if (out.count > kMaxBatchSize || length < BatchMessageSize(out.count))
+                return false;
+            std::memcpy(out.samples, data + BatchMessageSize(0), out.count * sizeof(PoseSample));
+            return true;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cmath>
+
+namespace ExampleDriver {
+
+    // Small quaternion helpers for the pose filters. Quaternions are double[4] in the same w, x, y, z order
+    // the poses use, rotation vectors are double[3] (axis times angle in radians).
+    namespace Quaternion {
+
+        inline void Normalize(double q[])
+        {
+            double mag = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+            for (int i = 0; i < 4; i++)
+                q[i] /= mag;
+        }
+
+        // out = a * b, out may not alias a or b
+        inline void Multiply(const double a[], const double b[], double out[])
+        {
+            out[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+            out[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+            out[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+            out[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+        }
+
+        inline void Conjugate(const double q[], double out[])
+        {
+            out[0] = q[0];
+            out[1] = -q[1];
+            out[2] = -q[2];
+            out[3] = -q[3];
+        }
+
+        // rotation vector -> unit quaternion
+        inline void Exp(const double v[], double out[])
+        {
+            double angle = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            //sin(angle/2)/angle, its limit for tiny angles keeps this exact near zero
+            double scale = angle < 1e-9 ? 0.5 : std::sin(angle / 2) / angle;
+            out[0] = std::cos(angle / 2);
+            out[1] = v[0] * scale;
+            out[2] = v[1] * scale;
+            out[3] = v[2] * scale;
+        }
+
+        // unit quaternion -> rotation vector, always the short way around
+        inline void Log(const double q[], double out[])
+        {
+            double sign = q[0] < 0 ? -1 : 1;
+            double vec = std::sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+            double angle = 2 * std::atan2(vec, sign * q[0]);
+            double scale = vec < 1e-9 ? 2 * sign : sign * angle / vec;
+            out[0] = q[1] * scale;
+            out[1] = q[2] * scale;
+            out[2] = q[3] * scale;
+        }
+
+        // rotation vector that turns from into to, in the frame of from
+        inline void Difference(const double from[], const double to[], double out[])
+        {
+            double inverse[4];
+            double delta[4];
+            Conjugate(from, inverse);
+            Multiply(inverse, to, delta);
+            Log(delta, out);
+        }
+
+        // q rotated further by the rotation vector v (in the frame of q)
+        inline void Rotate(const double q[], const double v[], double out[])
+        {
+            double delta[4];
+            Exp(v, delta);
+            Multiply(q, delta, out);
+            Normalize(out);
+        }
+
+        // v rotated by q
+        inline void RotateVector(const double q[], const double v[], double out[])
+        {
+            double p[4] = { 0, v[0], v[1], v[2] };
+            double inverse[4];
+            double qp[4];
+            double result[4];
+            Conjugate(q, inverse);
+            Multiply(q, p, qp);
+            Multiply(qp, inverse, result);
+            out[0] = result[1];
+            out[1] = result[2];
+            out[2] = result[3];
+        }
+
+        // world frame angular velocity (rad/s) of an orientation q changing at q_dot per second, q need not be unit length
+        inline void AngularVelocity(const double q[], const double q_dot[], double out[])
+        {
+            //w = 2 q_dot q*, with both scaled to the unit quaternion
+            double mag2 = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+            double inverse[4];
+            double w[4];
+            Conjugate(q, inverse);
+            Multiply(q_dot, inverse, w);
+            out[0] = 2 * w[1] / mag2;
+            out[1] = 2 * w[2] / mag2;
+            out[2] = 2 * w[3] / mag2;
+        }
+
+        // spherical interpolation from a (t = 0) to b (t = 1)
+        inline void Slerp(const double a[], const double b[], double t, double out[])
+        {
+            double v[3];
+            Difference(a, b, v);
+            for (int i = 0; i < 3; i++)
+                v[i] *= t;
+            Rotate(a, v, out);
+        }
+    }
+}
@@ -0,0 +1,320 @@
+#include "Recording.hpp"
+
+#include <chrono>
+#include <cstring>
+
+#include <Driver/Clock.hpp>
+#include <Driver/Quaternion.hpp>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ExampleDriver::Recording::PoseRecord ExampleDriver::Recording::MakePoseRecord(const vr::DriverPose_t& pose)
+{
+    PoseRecord record = {};
+    double world[4] = { pose.qWorldFromDriverRotation.w, pose.qWorldFromDriverRotation.x, pose.qWorldFromDriverRotation.y, pose.qWorldFromDriverRotation.z };
+    double rotation[4] = { pose.qRotation.w, pose.qRotation.x, pose.qRotation.y, pose.qRotation.z };
+
+    Quaternion::RotateVector(world, pose.vecPosition, record.position);
+    Quaternion::RotateVector(world, pose.vecVelocity, record.velocity);
+    Quaternion::Multiply(world, rotation, record.rotation);
+    for (int i = 0; i < 3; i++)
+        record.position[i] += pose.vecWorldFromDriverTranslation[i];
+
+    record.result = pose.result;
+    record.flags = (pose.poseIsValid ? kPoseValid : 0) | (pose.deviceIsConnected ? kDeviceConnected : 0);
+    return record;
+}
+
+namespace {
+    //marks room at the end of the ring that a record did not fit in, the low bits are its size
+    constexpr uint32_t kSkip = 0x80000000u;
+}
+
+ExampleDriver::Recording::Writer::~Writer()
+{
+    Stop();
+}
+
+bool ExampleDriver::Recording::Writer::Start(const std::string& path)
+{
+    Stop();
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    FileHeader header = {};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.header_size = sizeof(FileHeader);
+    header.start_time = Clock::Now();
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        std::fclose(file);
+        return false;
+    }
+
+    //the ring is allocated once here, Append never allocates. No Append touches it until active_ is set below.
+    if (this->buffer_ == nullptr)
+    {
+        this->buffer_.reset(new char[kBufferSize]);
+        this->marks_.reset(new std::atomic<uint32_t>[kBufferSize / 8]);
+    }
+    for (size_t i = 0; i < kBufferSize / 8; i++)
+        this->marks_[i].store(0, std::memory_order_relaxed);
+    this->head_.store(0, std::memory_order_relaxed);
+    this->tail_.store(0, std::memory_order_relaxed);
+    this->records_ = 0;
+    this->dropped_ = 0;
+    this->stopping_ = false;
+    this->file_ = file;
+    this->active_ = true;
+    this->thread_ = std::thread(&ExampleDriver::Recording::Writer::WriterThread, this);
+    return true;
+}
+
+void ExampleDriver::Recording::Writer::Stop()
+{
+    if (!this->thread_.joinable())
+        return;
+
+    //no Append starts after this, the ones already copying in never block, so waiting them out is short.
+    //the writer thread then finds every record marked on its last pass.
+    this->active_ = false;
+    while (this->appending_.load() != 0)
+        std::this_thread::yield();
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->stopping_ = true;
+    }
+    this->wake_.notify_one();
+    this->thread_.join();
+
+    std::fclose(this->file_);
+    this->file_ = nullptr;
+}
+
+void ExampleDriver::Recording::Writer::RecordMessage(uint16_t connection, const char* data, size_t length, double time)
+{
+    if (Active())
+        Append(RecordType::Message, connection, time, data, length);
+}
+
+void ExampleDriver::Recording::Writer::RecordPose(uint32_t device_index, const vr::DriverPose_t& pose, double time)
+{
+    if (!Active())
+        return;
+    PoseRecord record = MakePoseRecord(pose);
+    Append(RecordType::Pose, (uint16_t)device_index, time, &record, sizeof(record));
+}
+
+void ExampleDriver::Recording::Writer::Append(RecordType type, uint16_t source, double time, const void* payload, size_t size)
+{
+    RecordHeader header;
+    header.size = (uint32_t)size;
+    header.type = type;
+    header.source = source;
+    header.time = time;
+    size_t record_size = RecordSize(size);
+
+    //counted before active_ is checked again, so either Stop waits for this record or this sees the recording stopped
+    this->appending_.fetch_add(1);
+    if (!this->active_.load())
+    {
+        this->appending_.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    uint64_t position = this->head_.load(std::memory_order_relaxed);
+    uint64_t tail;
+    size_t skip;
+    for (;;)
+    {
+        size_t offset = position % kBufferSize;
+        skip = offset + record_size > kBufferSize ? kBufferSize - offset : 0;
+        tail = this->tail_.load(std::memory_order_acquire);
+        if (position + skip + record_size - tail > kBufferSize)
+        {
+            this->dropped_++;
+            this->appending_.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        if (this->head_.compare_exchange_weak(position, position + skip + record_size, std::memory_order_relaxed))
+            break;
+    }
+    if (skip > 0)
+    {
+        this->marks_[(position % kBufferSize) / 8].store(kSkip | (uint32_t)skip, std::memory_order_release);
+        position += skip;
+    }
+
+    size_t offset = position % kBufferSize;
+    char* out = this->buffer_.get() + offset;
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), payload, size);
+    std::memset(out + sizeof(header) + size, 0, record_size - sizeof(header) - size);
+    this->marks_[offset / 8].store((uint32_t)record_size, std::memory_order_release);
+
+    this->records_++;
+    //wakes the writer once, when this record takes the ring past half full
+    uint64_t used = position + record_size - tail;
+    if (used > kBufferSize / 2 && used - record_size - skip <= kBufferSize / 2)
+        this->wake_.notify_one();
+    this->appending_.fetch_sub(1, std::memory_order_release);
+}
+
+void ExampleDriver::Recording::Writer::WriterThread()
+{
+    uint64_t tail = this->tail_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex_);
+            this->wake_.wait_for(lock, std::chrono::milliseconds(kFlushInterval),
+                [this, tail]() { return this->stopping_ || this->head_.load(std::memory_order_relaxed) - tail > kBufferSize / 2; });
+            stopping = this->stopping_;
+        }
+
+        //writes out marked records from the tail, stopping at the first one still being copied in
+        bool written = false;
+        for (;;)
+        {
+            size_t offset = tail % kBufferSize;
+            uint32_t mark = this->marks_[offset / 8].load(std::memory_order_acquire);
+            if (mark == 0)
+                break;
+            this->marks_[offset / 8].store(0, std::memory_order_relaxed);
+            size_t size = mark & ~kSkip;
+            if ((mark & kSkip) == 0)
+            {
+                //consecutive records up to the end of the ring go out in one write
+                while (offset + size < kBufferSize)
+                {
+                    uint32_t next = this->marks_[(offset + size) / 8].load(std::memory_order_acquire);
+                    if (next == 0 || (next & kSkip) != 0)
+                        break;
+                    this->marks_[(offset + size) / 8].store(0, std::memory_order_relaxed);
+                    size += next;
+                }
+                std::fwrite(this->buffer_.get() + offset, 1, size, this->file_);
+                written = true;
+            }
+            //hands the room back only after it was written out
+            tail += size;
+            this->tail_.store(tail, std::memory_order_release);
+        }
+        if (written)
+            std::fflush(this->file_);
+        if (stopping)
+            return;
+    }
+}
+
+ExampleDriver::Recording::Reader::~Reader()
+{
+    Close();
+}
+
+bool ExampleDriver::Recording::Reader::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(FileHeader))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return false;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    handle_ = mapping;
+    size_ = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(FileHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    size_ = (size_t)info.st_size;
+#endif
+
+    data_ = static_cast<const char*>(view);
+    if (Header()->magic != kMagic || Header()->version != kVersion || Header()->header_size < sizeof(FileHeader))
+    {
+        Close();
+        return false;
+    }
+
+    Rewind();
+    return true;
+}
+
+void ExampleDriver::Recording::Reader::Close()
+{
+    if (data_ == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(handle_);
+#else
+    munmap(const_cast<char*>(data_), size_);
+#endif
+
+    data_ = nullptr;
+    handle_ = nullptr;
+    size_ = 0;
+}
+
+bool ExampleDriver::Recording::Reader::Next(Record& record)
+{
+    if (data_ == nullptr || cursor_ + sizeof(RecordHeader) > size_)
+        return false;
+
+    auto header = reinterpret_cast<const RecordHeader*>(data_ + cursor_);
+    size_t record_size = RecordSize(header->size);
+    //a record the writer did not finish, the recording ends before it
+    if (record_size > size_ - cursor_)
+        return false;
+
+    record.header = header;
+    record.payload = data_ + cursor_ + sizeof(RecordHeader);
+    cursor_ += record_size;
+    return true;
+}
+
+void ExampleDriver::Recording::Reader::Rewind()
+{
+    cursor_ = data_ == nullptr ? 0 : Header()->header_size;
+}
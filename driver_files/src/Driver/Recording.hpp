@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <openvr_driver.h>
+
+namespace ExampleDriver {
+
+    // Session recordings: an append-only file of every pipe message the driver received and every pose it posted,
+    // for reproducing tracking problems offline. The file is a FileHeader followed by records, each a RecordHeader
+    // and its payload padded to 8 bytes, so a mapped file can be read in place. A recording cut short by a crash
+    // simply ends at the last complete record.
+    namespace Recording {
+
+        constexpr uint32_t kMagic = 0x43455241;     // "AREC"
+        constexpr uint16_t kVersion = 1;
+
+        struct FileHeader {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t header_size;   // sizeof(FileHeader), records start here
+            double start_time;      // session seconds the recording started
+        };
+
+        enum class RecordType : uint16_t {
+            Message = 1,    // a pipe message as received, source is the connection
+            Pose = 2,       // a PoseRecord, source is the device index
+        };
+
+        struct RecordHeader {
+            uint32_t size;          // payload bytes, without the padding
+            RecordType type;
+            uint16_t source;
+            double time;            // session seconds
+        };
+
+        // The parts of a posted vr::DriverPose_t needed to compare driver builds
+        struct PoseRecord {
+            double position[3];     // world space, m
+            double rotation[4];     // world space, w, x, y, z
+            double velocity[3];     // world space, m/s
+            int32_t result;         // vr::ETrackingResult
+            uint32_t flags;         // kPoseValid | kDeviceConnected
+        };
+
+        constexpr uint32_t kPoseValid = 1;
+        constexpr uint32_t kDeviceConnected = 2;
+
+        /// <summary>
+        /// Padded size of a record with size payload bytes
+        /// </summary>
+        inline size_t RecordSize(size_t size)
+        {
+            return sizeof(RecordHeader) + ((size + 7) & ~size_t(7));
+        }
+
+        /// <summary>
+        /// Converts a posted pose, its rotations are applied so the record is in world space
+        /// </summary>
+        PoseRecord MakePoseRecord(const vr::DriverPose_t& pose);
+
+        /// <summary>
+        /// Records into a file from a writer thread of its own. Recording claims room in a fixed size ring with a
+        /// compare and swap and copies the record in, it never takes a lock or waits for the disk or another recording
+        /// thread; when the ring is full the record is dropped and counted. Start and Stop must not be called
+        /// concurrently with each other, Record* may be called from any thread.
+        /// </summary>
+        class Writer {
+        public:
+            static constexpr size_t kBufferSize = 1 << 20;      // bytes, a multiple of 8, the writer thread drains it every kFlushInterval
+            static constexpr int kFlushInterval = 100;          // ms
+
+            Writer() = default;
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+            ~Writer();
+
+            /// <summary>
+            /// Starts recording into a new file, stopping any recording in progress
+            /// </summary>
+            /// <returns>False if the file could not be created</returns>
+            bool Start(const std::string& path);
+
+            /// <summary>
+            /// Writes out everything recorded so far and closes the file
+            /// </summary>
+            void Stop();
+
+            bool Active() const { return active_.load(std::memory_order_relaxed); }
+
+            void RecordMessage(uint16_t connection, const char* data, size_t length, double time);
+            void RecordPose(uint32_t device_index, const vr::DriverPose_t& pose, double time);
+
+            uint64_t Records() const { return records_.load(std::memory_order_relaxed); }
+            uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+        private:
+            void Append(RecordType type, uint16_t source, double time, const void* payload, size_t size);
+            void WriterThread();
+
+            std::atomic<bool> active_{ false };
+            // Records are claimed at head_ and handed back at tail_, both count bytes since Start. A record never
+            // wraps around the end of buffer_, the room left there is claimed as a skip instead. Once a record is
+            // copied in, its size is stored in the mark of its first 8 bytes, the writer thread writes out marked
+            // records in order from tail_ and clears their marks.
+            std::unique_ptr<char[]> buffer_;                    // kBufferSize bytes, allocated once
+            std::unique_ptr<std::atomic<uint32_t>[]> marks_;    // one per 8 bytes of buffer_
+            std::atomic<uint64_t> head_{ 0 };
+            std::atomic<uint64_t> tail_{ 0 };
+            std::atomic<int> appending_{ 0 };                   // Append calls that may still touch the ring, Stop waits for them
+            std::mutex mutex_;                                  // only for the writer thread's sleep, Append never takes it
+            std::condition_variable wake_;
+            bool stopping_ = false;
+            std::FILE* file_ = nullptr;
+            std::thread thread_;
+            std::atomic<uint64_t> records_{ 0 };
+            std::atomic<uint64_t> dropped_{ 0 };
+        };
+
+        /// <summary>
+        /// Read only mapping of a recording
+        /// </summary>
+        class Reader {
+        public:
+            struct Record {
+                const RecordHeader* header;
+                const char* payload;
+            };
+
+            Reader() = default;
+            Reader(const Reader&) = delete;
+            Reader& operator=(const Reader&) = delete;
+            ~Reader();
+
+            /// <summary>
+            /// Maps a recording and checks its header
+            /// </summary>
+            /// <returns>True on success</returns>
+            bool Open(const std::string& path);
+            void Close();
+
+            const FileHeader* Header() const { return reinterpret_cast<const FileHeader*>(data_); }
+
+            /// <summary>
+            /// Walks the records in file order, starting over after Rewind
+            /// </summary>
+            /// <returns>False after the last complete record</returns>
+            bool Next(Record& record);
+            void Rewind();
+
+        private:
+            const char* data_ = nullptr;
+            size_t size_ = 0;
+            size_t cursor_ = 0;
+            void* handle_ = nullptr;
+        };
+    }
+}
@@ -0,0 +1,89 @@
+#include "RegressionFilter.hpp"
+
+#include <cmath>
+
+#include <Driver/Quaternion.hpp>
+
+void ExampleDriver::RegressionFilter::Configure(int max_saved)
+{
+    samples_.Reset(max_saved);
+}
+
+void ExampleDriver::RegressionFilter::Reset()
+{
+    samples_.Reset(samples_.Capacity());
+}
+
+void ExampleDriver::RegressionFilter::Expire(double oldest)
+{
+    //no need to touch the remaining samples since they store absolute times
+    samples_.ExpireBefore(oldest);
+}
+
+bool ExampleDriver::RegressionFilter::AddSample(double time, const double pose[])
+{
+    return samples_.Insert(time, pose);
+}
+
+bool ExampleDriver::RegressionFilter::Predict(double time, double pose[]) const
+{
+    return Predict(samples_.GetMoments(), samples_.Size(), time, pose);
+}
+
+bool ExampleDriver::RegressionFilter::Velocity(double time, double velocity[], double angular_velocity[]) const
+{
+    return Velocity(samples_.GetMoments(), samples_.Size(), time, velocity, angular_velocity);
+}
+
+bool ExampleDriver::RegressionFilter::Predict(const SampleRing::Moments& moments, int count, double time, double pose[])
+{
+    double slope[SampleRing::kChannels];
+    return Fit(moments, count, time, pose, slope);
+}
+
+bool ExampleDriver::RegressionFilter::Velocity(const SampleRing::Moments& moments, int count, double time, double velocity[], double angular_velocity[])
+{
+    double pose[SampleRing::kChannels];
+    double slope[SampleRing::kChannels];
+    if (!Fit(moments, count, time, pose, slope))
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        velocity[i] = slope[i];
+    Quaternion::AngularVelocity(pose + 3, slope + 3, angular_velocity);
+    return true;
+}
+
+bool ExampleDriver::RegressionFilter::Fit(const SampleRing::Moments& m, int count, double time, double pose[], double slope[])
+{
+    if (count < kMinSamples)
+        return false;
+
+    //least squares fit of every channel against capture time, straight from the running sums the ring keeps,
+    //so this costs the same no matter how many samples are saved:
+    //slope = cov(t, v) / var(t), evaluated at the requested time. PoseBatch runs the exact same steps for all trackers at once.
+    double n = count;
+    double avg_time = m.t / n;
+    double var_time = (m.t2 / n) - (avg_time * avg_time);
+    double eval_time = time - m.origin;
+
+    for (int i = 0; i < SampleRing::kChannels; i++)
+    {
+        double avg_val = m.v[i] / n;
+        double avg_val2 = m.v2[i] / n;
+        double avg_tval = m.tv[i] / n;
+
+        double b = (avg_tval - (avg_val * avg_time)) / var_time;
+        double y = avg_val + b * (eval_time - avg_time);
+
+        if (std::abs(avg_val2 - (avg_val * avg_val)) < 0.00000001)               //bloody floating point rounding errors
+        {
+            y = avg_val;
+            b = 0;
+        }
+
+        pose[i] = y;
+        slope[i] = b;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Driver/IPoseFilter.hpp>
+#include <Driver/SampleRing.hpp>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// The original predictor: a least squares line through every saved sample, per channel, evaluated at the requested time.
+    /// </summary>
+    class RegressionFilter : public IPoseFilter {
+    public:
+        static constexpr int kMinSamples = 4;
+
+        /// <summary>
+        /// Keeps up to max_saved samples, drops the ones already saved
+        /// </summary>
+        void Configure(int max_saved);
+
+        const SampleRing& Samples() const { return samples_; }
+
+        /// <summary>
+        /// Predict and Velocity from nothing but the running sums of count samples, as kept by SampleRing.
+        /// Lets a copy of the sums stand in for the whole filter.
+        /// </summary>
+        static bool Predict(const SampleRing::Moments& moments, int count, double time, double pose[]);
+        static bool Velocity(const SampleRing::Moments& moments, int count, double time, double velocity[], double angular_velocity[]);
+
+        // Inherited via IPoseFilter
+        virtual void Reset() override;
+        virtual void Expire(double oldest) override;
+        virtual bool AddSample(double time, const double pose[]) override;
+        virtual bool Predict(double time, double pose[]) const override;
+        virtual bool Velocity(double time, double velocity[], double angular_velocity[]) const override;
+
+    private:
+        // the fitted line of every channel at time: its value and its slope per second
+        static bool Fit(const SampleRing::Moments& moments, int count, double time, double pose[], double slope[]);
+
+        SampleRing samples_;
+    };
+}
@@ -0,0 +1,95 @@
+#include "SampleRing.hpp"
+
+ExampleDriver::SampleRing::SampleRing(int capacity)
+{
+    Reset(capacity);
+}
+
+void ExampleDriver::SampleRing::Reset(int capacity)
+{
+    capacity_ = capacity;
+    data_.assign((size_t)capacity * (kChannels + 1), 0.0);
+    head_ = 0;
+    count_ = 0;
+    moments_ = Moments();
+    inserts_since_rebuild_ = 0;
+}
+
+void ExampleDriver::SampleRing::ExpireBefore(double time)
+{
+    while (count_ > 0 && data_[head_] < time)
+    {
+        Accumulate(head_, -1);
+        head_ = (head_ + 1) % capacity_;
+        count_--;
+    }
+}
+
+void ExampleDriver::SampleRing::CopySlot(int from, int to)
+{
+    for (int k = 0; k <= kChannels; k++)
+        data_[k * capacity_ + to] = data_[k * capacity_ + from];
+}
+
+bool ExampleDriver::SampleRing::Insert(double time, const double values[])
+{
+    if (count_ == capacity_)
+    {
+        if (time < Time(count_ - 1))
+            return false;
+
+        //make room by dropping the oldest sample
+        Accumulate(head_, -1);
+        head_ = (head_ + 1) % capacity_;
+        count_--;
+    }
+
+    //append after the newest sample, then move it back past any newer samples, which only happens for late samples
+    int slot = (head_ + count_) % capacity_;
+    int moved = 0;
+    while (moved < count_)
+    {
+        int prev = (slot + capacity_ - 1) % capacity_;
+        if (data_[prev] <= time)
+            break;
+        CopySlot(prev, slot);
+        slot = prev;
+        moved++;
+    }
+
+    data_[slot] = time;
+    for (int k = 0; k < kChannels; k++)
+        data_[(k + 1) * capacity_ + slot] = values[k];
+    count_++;
+
+    //an empty ring starts over at a fresh origin, a busy one is rebuilt every so often
+    if (count_ == 1 || ++inserts_since_rebuild_ >= kRebuildInterval * capacity_)
+        Rebuild();
+    else
+        Accumulate(slot, 1);
+
+    return true;
+}
+
+void ExampleDriver::SampleRing::Accumulate(int slot, double sign)
+{
+    double t = data_[slot] - moments_.origin;
+    moments_.t += sign * t;
+    moments_.t2 += sign * t * t;
+    for (int k = 0; k < kChannels; k++)
+    {
+        double v = data_[(k + 1) * capacity_ + slot];
+        moments_.v[k] += sign * v;
+        moments_.v2[k] += sign * v * v;
+        moments_.tv[k] += sign * t * v;
+    }
+}
+
+void ExampleDriver::SampleRing::Rebuild()
+{
+    moments_ = Moments();
+    moments_.origin = Time(0);
+    for (int i = 0; i < count_; i++)
+        Accumulate(Slot(i), 1);
+    inserts_since_rebuild_ = 0;
+}
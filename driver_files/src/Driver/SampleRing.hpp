@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// Fixed capacity history of pose samples, kept sorted by capture time.
+    /// Storage is one contiguous structure of arrays block: all capture times, then all values of channel 0, and so on,
+    /// so a pass over one channel touches consecutive memory. Samples arriving in order are appended in O(1),
+    /// only late samples have to be moved into place.
+    /// The ring also keeps running sums of the stored samples, so a linear regression over them costs the same at any capacity.
+    /// </summary>
+    class SampleRing {
+    public:
+        static constexpr int kChannels = 7;     // x, y, z, qw, qx, qy, qz
+
+        // Sums over all stored samples, updated on every insert and removal.
+        // Times are taken relative to origin to keep the squares small enough for double precision.
+        struct Moments {
+            double origin = 0;
+            double t = 0;
+            double t2 = 0;
+            double v[kChannels] = {};
+            double v2[kChannels] = {};
+            double tv[kChannels] = {};
+        };
+
+        explicit SampleRing(int capacity = 10);
+
+        /// <summary>
+        /// Drops all samples and changes the capacity
+        /// </summary>
+        void Reset(int capacity);
+
+        int Capacity() const { return capacity_; }
+        int Size() const { return count_; }
+
+        // Samples are indexed newest first: 0 is the most recently captured sample
+        double Time(int i) const { return data_[Slot(i)]; }
+        double Value(int channel, int i) const { return data_[(channel + 1) * capacity_ + Slot(i)]; }
+
+        const Moments& GetMoments() const { return moments_; }
+
+        /// <summary>
+        /// Drops every sample captured before time
+        /// </summary>
+        void ExpireBefore(double time);
+
+        /// <summary>
+        /// Inserts a sample at its place in capture time order, dropping the oldest sample if the ring is full
+        /// </summary>
+        /// <param name="time">Absolute capture time of the sample</param>
+        /// <param name="values">kChannels values of the sample</param>
+        /// <returns>False if the ring is full and the sample is older than all of them</returns>
+        bool Insert(double time, const double values[]);
+
+    private:
+        static constexpr int kRebuildInterval = 16;     // in multiples of the capacity
+
+        int Slot(int i) const { return (head_ + count_ - 1 - i) % capacity_; }
+
+        void CopySlot(int from, int to);
+
+        // adds (sign 1) or removes (sign -1) a stored sample from the running sums
+        void Accumulate(int slot, double sign);
+
+        // recomputes the sums from scratch around a new origin, bounding both rounding drift and the size of the times
+        void Rebuild();
+
+        std::vector<double> data_;
+        int capacity_ = 0;
+        int head_ = 0;      // slot of the oldest sample
+        int count_ = 0;
+
+        Moments moments_;
+        int inserts_since_rebuild_ = 0;
+    };
+}
@@ -0,0 +1,100 @@
+#include "SharedMemory.hpp"
+
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+ExampleDriver::SharedMemory::Mapping::~Mapping()
+{
+    Close();
+}
+
+bool ExampleDriver::SharedMemory::Mapping::Open(const std::string& name, bool create)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE mapping;
+    if (create)
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(Region), name.c_str());
+    else
+        mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (mapping == NULL)
+        return false;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Region));
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    handle_ = mapping;
+#else
+    std::string shm_name = "/" + name;
+    int fd = shm_open(shm_name.c_str(), create ? (O_CREAT | O_RDWR) : O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    if (create && ftruncate(fd, sizeof(Region)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    name_ = shm_name;
+#endif
+
+    created_ = create;
+    Region* region = static_cast<Region*>(view);
+
+    if (create)
+    {
+        //start every ring empty, a client restarting later picks up from the indices stored here
+        region = new (view) Region();
+        region->magic = kMagic;
+        region->version = kVersion;
+        region->max_trackers = kMaxTrackers;
+        region->ring_size = kRingSize;
+        region->max_devices = kMaxDevices;
+    }
+    else if (region->magic != kMagic || region->version != kVersion)
+    {
+        Unmap(region);
+        return false;
+    }
+
+    //RunFrame reads the region without taking any lock, publish it only now that it is set up
+    region_.store(region, std::memory_order_release);
+    return true;
+}
+
+void ExampleDriver::SharedMemory::Mapping::Close()
+{
+    Region* region = region_.exchange(nullptr, std::memory_order_acq_rel);
+    if (region != nullptr)
+        Unmap(region);
+}
+
+void ExampleDriver::SharedMemory::Mapping::Unmap(Region* region)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(region);
+    CloseHandle(handle_);
+#else
+    munmap(region, sizeof(Region));
+    if (created_)
+        shm_unlink(name_.c_str());
+#endif
+
+    handle_ = nullptr;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace ExampleDriver {
+    namespace SharedMemory {
+
+        constexpr uint32_t kMagic = 0x4d505441;     // "ATPM"
+        constexpr uint16_t kVersion = 2;
+        constexpr uint32_t kMaxTrackers = 64;
+        constexpr uint32_t kRingSize = 16;          // must be a power of two
+        constexpr uint32_t kMaxDevices = 64;        // vr::k_unMaxTrackedDeviceCount
+
+        static_assert((kRingSize & (kRingSize - 1)) == 0, "kRingSize must be a power of two");
+        static_assert(std::atomic<uint32_t>::is_always_lock_free, "ring indices must be lock free to work across processes");
+
+        struct Sample {
+            double position[3];
+            double rotation[4];     // w, x, y, z
+            double capture_time;    // steady clock seconds, see Now()
+        };
+
+        // Single producer (the tracking client), single consumer (VRDriver::RunFrame).
+        // Indices only ever increase and wrap around naturally, the slot is index % kRingSize.
+        struct PoseRing {
+            alignas(64) std::atomic<uint32_t> write_index;
+            alignas(64) std::atomic<uint32_t> read_index;
+            alignas(64) Sample samples[kRingSize];
+        };
+
+        // Pose of a SteamVR device in tracking space, as returned by GetRawTrackedDevicePoses
+        struct DevicePose {
+            double position[3];
+            double rotation[4];     // w, x, y, z
+            double velocity[3];
+            double time;            // steady clock seconds when the driver read the pose, see Now()
+            uint32_t valid;         // nonzero if the device is connected and its pose is valid
+        };
+
+        // Single writer (VRDriver::RunFrame), any number of readers. The sequence is odd while the pose is written,
+        // a reader that saw it odd or changed while copying has a torn copy and tries again.
+        struct DevicePoseSlot {
+            alignas(64) std::atomic<uint32_t> sequence;
+            DevicePose pose;
+        };
+
+        struct Region {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t max_trackers;
+            uint32_t ring_size;
+            uint32_t max_devices;
+            PoseRing rings[kMaxTrackers];
+
+            // Poses of the devices clients subscribed to, updated every frame. device_frame is bumped after each update,
+            // so a reader can tell whether anything changed without looking at the slots.
+            alignas(64) std::atomic<uint32_t> device_frame;
+            DevicePoseSlot devices[kMaxDevices];
+        };
+
+        /// <summary>
+        /// Time base for Sample::capture_time. steady_clock is system wide on every platform we run on,
+        /// so the client and the driver read the same clock.
+        /// </summary>
+        inline double Now()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /// <summary>
+        /// Producer side: queues a sample for the driver
+        /// </summary>
+        /// <returns>False if the ring is full and the sample was not queued</returns>
+        inline bool Push(PoseRing& ring, const Sample& sample)
+        {
+            uint32_t write = ring.write_index.load(std::memory_order_relaxed);
+            if (write - ring.read_index.load(std::memory_order_acquire) >= kRingSize)
+                return false;
+            ring.samples[write % kRingSize] = sample;
+            ring.write_index.store(write + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// <summary>
+        /// Consumer side: takes the oldest queued sample
+        /// </summary>
+        /// <returns>False if the ring is empty</returns>
+        inline bool Pop(PoseRing& ring, Sample& sample)
+        {
+            uint32_t read = ring.read_index.load(std::memory_order_relaxed);
+            if (read == ring.write_index.load(std::memory_order_acquire))
+                return false;
+            sample = ring.samples[read % kRingSize];
+            ring.read_index.store(read + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// <summary>
+        /// Writer side: replaces the pose in a slot
+        /// </summary>
+        inline void Publish(DevicePoseSlot& slot, const DevicePose& pose)
+        {
+            uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+            slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&slot.pose, &pose, sizeof(pose));
+            slot.sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        /// <summary>
+        /// Reader side: copies the pose in a slot
+        /// </summary>
+        /// <returns>False if every attempt overlapped a write, which takes a writer stuck in the middle of one</returns>
+        inline bool Read(const DevicePoseSlot& slot, DevicePose& pose)
+        {
+            for (int attempt = 0; attempt < 1000; attempt++)
+            {
+                uint32_t before = slot.sequence.load(std::memory_order_acquire);
+                if (before & 1)
+                    continue;
+                std::memcpy(&pose, &slot.pose, sizeof(pose));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) == before)
+                    return true;
+            }
+            return false;
+        }
+
+        /// <summary>
+        /// A named shared memory mapping of a Region: CreateFileMapping on Windows, shm_open elsewhere
+        /// </summary>
+        class Mapping {
+        public:
+            Mapping() = default;
+            Mapping(const Mapping&) = delete;
+            Mapping& operator=(const Mapping&) = delete;
+            ~Mapping();
+
+            /// <summary>
+            /// Maps the region, creating and initialising it if create is set
+            /// </summary>
+            /// <returns>True on success</returns>
+            bool Open(const std::string& name, bool create);
+            void Close();
+
+            /// <summary>
+            /// The mapped region, nullptr until Open succeeded. Safe to call from any thread while one thread opens it.
+            /// </summary>
+            Region* Get() const { return region_.load(std::memory_order_acquire); }
+
+        private:
+            void Unmap(Region* region);
+
+            // Only stored once the region is initialised, so a reader that sees it also sees the initialised header
+            std::atomic<Region*> region_{ nullptr };
+            void* handle_ = nullptr;
+            std::string name_;
+            bool created_ = false;
+        };
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef _WIN32
+
+#include "Transport.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    std::string SocketPath(const std::string& name)
+    {
+        const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+        if (runtime_dir != nullptr && runtime_dir[0] != '\0')
+            return std::string(runtime_dir) + "/" + name;
+        return "/tmp/" + name;
+    }
+
+    bool MakeAddress(const std::string& path, sockaddr_un& addr)
+    {
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            return false;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    class SocketConnection : public ExampleDriver::IConnection {
+    public:
+        SocketConnection(int fd):
+            fd_(fd)
+        {
+        }
+
+        ~SocketConnection()
+        {
+            close(fd_);
+        }
+
+        virtual int Receive(char* buffer, size_t size) override
+        {
+            //SOCK_SEQPACKET keeps message boundaries like a message mode pipe, MSG_TRUNC reports the real length
+            ssize_t received = recv(fd_, buffer, size, MSG_TRUNC);
+            if (received <= 0 || (size_t)received > size)
+                return -1;
+            return (int)received;
+        }
+
+        virtual bool Send(const char* data, size_t length) override
+        {
+            return send(fd_, data, length, MSG_NOSIGNAL) == (ssize_t)length;
+        }
+
+    private:
+        int fd_;
+    };
+
+    class SocketServer : public ExampleDriver::ITransportServer {
+    public:
+        SocketServer(int fd, const std::string& path):
+            fd_(fd),
+            path_(path)
+        {
+        }
+
+        ~SocketServer()
+        {
+            close(fd_);
+            unlink(path_.c_str());
+        }
+
+        virtual std::unique_ptr<ExampleDriver::IConnection> Accept() override
+        {
+            int client = accept(fd_, nullptr, nullptr);
+            if (client < 0)
+                return nullptr;
+            return std::make_unique<SocketConnection>(client);
+        }
+
+    private:
+        int fd_;
+        std::string path_;
+    };
+}
+
+std::unique_ptr<ExampleDriver::ITransportServer> ExampleDriver::CreateTransportServer(const std::string& name)
+{
+    std::string path = SocketPath(name);
+
+    sockaddr_un addr;
+    if (!MakeAddress(path, addr))
+        return nullptr;
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0)
+        return nullptr;
+
+    //a socket file left behind by a crashed vrserver would make bind fail
+    unlink(path.c_str());
+
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    return std::make_unique<SocketServer>(fd, path);
+}
+
+std::unique_ptr<ExampleDriver::IConnection> ExampleDriver::ConnectTransport(const std::string& name, int timeout_ms)
+{
+    sockaddr_un addr;
+    if (!MakeAddress(SocketPath(name), addr))
+        return nullptr;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;)
+    {
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        if (fd < 0)
+            return nullptr;
+
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0)
+            return std::make_unique<SocketConnection>(fd);
+        close(fd);
+
+        //the driver may not be listening yet, keep retrying like WaitNamedPipe would
+        if (std::chrono::steady_clock::now() >= deadline)
+            return nullptr;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+#endif
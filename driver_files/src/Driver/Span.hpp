@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// Non-owning view of contiguous elements, for handing out buffers without copying them (std::span is C++20).
+    /// Only valid as long as the buffer it was taken from is not changed.
+    /// </summary>
+    template<typename T>
+    class Span {
+    public:
+        Span() = default;
+        Span(T* data, size_t size) : data_(data), size_(size) {}
+
+        T* begin() const { return data_; }
+        T* end() const { return data_ + size_; }
+        T& operator[](size_t i) const { return data_[i]; }
+        T* data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+    private:
+        T* data_ = nullptr;
+        size_t size_ = 0;
+    };
+}
@@ -0,0 +1,120 @@
+#include "Telemetry.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    int HighestBit(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanReverse64(&bit, value);
+        return (int)bit;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+}
+
+int ExampleDriver::Histogram::Index(int64_t value)
+{
+    const int64_t exact = (int64_t)1 << kSubBucketBits;
+    const int half = 1 << (kSubBucketBits - 1);
+
+    value = std::min(std::max(value, (int64_t)0), (int64_t)1 << kMaxBits);
+    if (value < exact)
+        return (int)value;
+
+    //keep the top kSubBucketBits bits of the value, the highest of them is always set
+    int shift = HighestBit((uint64_t)value) - kSubBucketBits + 1;
+    int top = (int)(value >> shift);
+    return (int)exact + (shift - 1) * half + (top - half);
+}
+
+double ExampleDriver::Histogram::BucketMiddle(int index)
+{
+    const int exact = 1 << kSubBucketBits;
+    const int half = 1 << (kSubBucketBits - 1);
+
+    if (index < exact)
+        return index;
+
+    int shift = (index - exact) / half + 1;
+    int top = (index - exact) % half + half;
+    return (double)((int64_t)top << shift) + (double)((int64_t)1 << shift) / 2;
+}
+
+void ExampleDriver::Histogram::Record(int64_t nanoseconds)
+{
+    counts_[Index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(std::max(nanoseconds, (int64_t)0), std::memory_order_relaxed);
+}
+
+void ExampleDriver::Histogram::Read(Snapshot& snapshot) const
+{
+    //not one atomic snapshot, a value recorded meanwhile may or may not be in it, which does not matter for statistics
+    snapshot.count = 0;
+    for (int i = 0; i < kBuckets; i++)
+    {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.sum = (double)sum_.load(std::memory_order_relaxed);
+}
+
+ExampleDriver::Histogram::Snapshot ExampleDriver::Histogram::Snapshot::operator-(const Snapshot& older) const
+{
+    Snapshot difference;
+    for (int i = 0; i < kBuckets; i++)
+        difference.counts[i] = counts[i] - older.counts[i];
+    difference.count = count - older.count;
+    difference.sum = sum - older.sum;
+    return difference;
+}
+
+double ExampleDriver::Histogram::Snapshot::Percentile(double fraction) const
+{
+    if (count == 0)
+        return 0;
+
+    //rank of the wanted value, counting from 1
+    uint64_t rank = std::max((uint64_t)1, (uint64_t)(fraction * count + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return BucketMiddle(i);
+    }
+    return BucketMiddle(kBuckets - 1);
+}
+
+ExampleDriver::Telemetry& ExampleDriver::Telemetry::Get()
+{
+    static Telemetry telemetry;
+    return telemetry;
+}
+
+const ExampleDriver::Histogram& ExampleDriver::Telemetry::At(int i) const
+{
+    const Histogram* histograms[kHistograms] = { &frame_interval, &tracker_update, &message_handling, &sample_age, &prediction_horizon };
+    return *histograms[i];
+}
+
+const char* ExampleDriver::Telemetry::Name(int i)
+{
+    static const char* names[kHistograms] = { "frame_interval", "tracker_update", "message_handling", "sample_age", "prediction_horizon" };
+    return names[i];
+}
+
+std::string ExampleDriver::Telemetry::Format(const char* name, const Histogram::Snapshot& snapshot)
+{
+    char line[160];
+    std::snprintf(line, sizeof(line), "%s %llu %.3f %.3f %.3f %.3f %.3f %.3f", name, (unsigned long long)snapshot.count,
+        snapshot.Mean() / 1e6, snapshot.Percentile(0.5) / 1e6, snapshot.Percentile(0.9) / 1e6,
+        snapshot.Percentile(0.99) / 1e6, snapshot.Percentile(0.999) / 1e6, snapshot.Max() / 1e6);
+    return line;
+}
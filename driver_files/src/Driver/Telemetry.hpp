@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// Lock-free latency histogram in the style of HdrHistogram: buckets are exact below 32 ns, above that every doubling of the value
+    /// is split into 16 buckets, so any value is known to within about 3% at any magnitude up to about two minutes.
+    /// Record is a couple of relaxed atomic adds and may be called from any thread.
+    /// </summary>
+    class Histogram {
+    public:
+        static constexpr int kSubBucketBits = 5;
+        static constexpr int kMaxBits = 37;     // 2^37 ns, about 137 s, larger values are counted there
+        static constexpr int kBuckets = (kMaxBits - kSubBucketBits + 2) * (1 << (kSubBucketBits - 1)) + 1;
+
+        // Counts at one moment. Subtracting an older snapshot gives the counts of the time in between.
+        struct Snapshot {
+            uint64_t counts[kBuckets] = {};
+            uint64_t count = 0;
+            double sum = 0;     // ns
+
+            Snapshot operator-(const Snapshot& older) const;
+
+            /// <summary>
+            /// Value below which the given fraction of the recorded values lie, in ns
+            /// </summary>
+            double Percentile(double fraction) const;
+            double Mean() const { return count > 0 ? sum / count : 0; }
+            double Max() const { return Percentile(1); }
+        };
+
+        /// <summary>
+        /// Counts one value, in ns. Negative values count as 0.
+        /// </summary>
+        void Record(int64_t nanoseconds);
+        void RecordSeconds(double seconds) { Record((int64_t)(seconds * 1e9)); }
+
+        void Read(Snapshot& snapshot) const;
+
+    private:
+        static int Index(int64_t value);
+        static double BucketMiddle(int index);
+
+        std::atomic<uint64_t> counts_[kBuckets]{};
+        std::atomic<int64_t> sum_{ 0 };
+    };
+
+    /// <summary>
+    /// Timing histograms of the whole driver, shared by every thread. Queried with the stats pipe command and,
+    /// if stats_log_interval is set, written to the driver log every so many seconds.
+    /// </summary>
+    struct Telemetry {
+        Histogram frame_interval;       // between RunFrame calls
+        Histogram tracker_update;       // finishing the prediction of one tracker after the batched fit, and posting it
+        Histogram message_handling;     // handling one pipe message, not counting the wait for the command lock
+        Histogram sample_age;           // age of pose samples when they are stored
+        Histogram prediction_horizon;   // how far past its newest sample a posted pose was predicted
+
+        static constexpr int kHistograms = 5;
+
+        static Telemetry& Get();
+
+        // for iterating over all histograms
+        const Histogram& At(int i) const;
+        static const char* Name(int i);
+
+        /// <summary>
+        /// One line per histogram: name, count, then mean, p50, p90, p99, p99.9 and max in ms
+        /// </summary>
+        static std::string Format(const char* name, const Histogram::Snapshot& snapshot);
+    };
+}
@@ -1,5 +1,4 @@
 #include "TrackerDevice.hpp"
-#include <Windows.h>
 
 void normalizeQuat(double pose[])
 {
@@ -16,9 +15,59 @@ void normalizeQuat(double pose[])
     pose[6] /= mag;
 }
 
+void ExampleDriver::PoseSnapshot::CopyFrom(const PoseHistory& history)
+{
+    //only what the selected filter predicts from, the regression's samples stay behind
+    filter = history.filter;
+    switch (filter)
+    {
+    case PoseFilterType::Kalman:
+        kalman = history.kalman;
+        break;
+    case PoseFilterType::OneEuro:
+        one_euro = history.one_euro;
+        break;
+    default:
+        moments = history.regression.Samples().GetMoments();
+        samples = history.regression.Samples().Size();
+        break;
+    }
+    last_update = history.last_update;
+    last_capture = history.last_capture;
+    smoothing = history.smoothing;
+}
+
+bool ExampleDriver::PoseSnapshot::Predict(double time, double pose[]) const
+{
+    switch (filter)
+    {
+    case PoseFilterType::Kalman:
+        return kalman.Predict(time, pose);
+    case PoseFilterType::OneEuro:
+        return one_euro.Predict(time, pose);
+    default:
+        return RegressionFilter::Predict(moments, samples, time, pose);
+    }
+}
+
+bool ExampleDriver::PoseSnapshot::Velocity(double time, double velocity[], double angular_velocity[]) const
+{
+    switch (filter)
+    {
+    case PoseFilterType::Kalman:
+        return kalman.Velocity(time, velocity, angular_velocity);
+    case PoseFilterType::OneEuro:
+        return one_euro.Velocity(time, velocity, angular_velocity);
+    default:
+        return RegressionFilter::Velocity(moments, samples, time, velocity, angular_velocity);
+    }
+}
+
 ExampleDriver::TrackerDevice::TrackerDevice(std::string serial, std::string role):
     serial_(serial),
-    role_(role)
+    role_(role),
+    dropped_far_log_("%s: dropped %llu poses in the last second, max error %.2f m", serial),
+    dropped_outside_log_("%s: dropped %llu poses outside of the playspace in the last second, max distance %.1f m", serial)
 {
     this->last_pose_ = MakeDefaultPose();
     this->isSetup = false;
@@ -39,60 +88,168 @@ void ExampleDriver::TrackerDevice::reinit(int msaved, double mtime, double msmoo
     else if (msmooth > 0.99)
         msmooth = 0.99;
 
-    max_saved = msaved;
-    std::vector<std::vector<double>> temp(msaved, std::vector<double>(8,-1));
-    prev_positions = temp;
-    max_time = mtime;
-    smoothing = msmooth;
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
+
+    history_.regression.Configure(msaved);
+    history_.kalman.Reset();
+    history_.one_euro.Reset();
+    history_.max_time = mtime;
+    history_.smoothing = msmooth;
+
+    publish_history();
 
     //Log("Settings changed! " + std::to_string(msaved) + " " + std::to_string(mtime));
 }
 
+void ExampleDriver::TrackerDevice::set_filter(PoseFilterType filter, double param1, double param2)
+{
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
+
+    //the parameters mean something different to every filter, see their Configure
+    if (filter == PoseFilterType::Kalman)
+        history_.kalman.Configure(param1, param2);
+    else if (filter == PoseFilterType::OneEuro)
+        history_.one_euro.Configure(param1, param2);
+
+    //start the filter from scratch rather than from whatever it saw the last time it was used
+    history_.filter = filter;
+    history_.Filter().Reset();
+
+    publish_history();
+}
+
+void ExampleDriver::TrackerDevice::set_fusion_window(double window)
+{
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
+    this->fusion_.Configure(window);
+}
+
+int ExampleDriver::TrackerDevice::get_fusion_stats(PoseFusion::SourceStats stats[], int max)
+{
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
+    return this->fusion_.GetStats(stats, max);
+}
+
+void ExampleDriver::TrackerDevice::OnEvent(const vr::VREvent_t& event)
+{
+    // Only haptic vibration of this device's component is subscribed to
+    if (event.eventType == vr::VREvent_Input_HapticVibration)
+        this->did_vibrate_ = true;
+}
+
 void ExampleDriver::TrackerDevice::Update()
 {
-    if (this->device_index_ == vr::k_unTrackedDeviceIndexInvalid)
+    //VRDriver::RunFrame predicts every tracker at once through load_prediction and apply_prediction, this is the same for one tracker
+    handle_events();
+
+    fetch_history();
+    const PoseSnapshot& history = this->published_history_.Front();
+    double eval_time;
+    double next_pose[7];
+    double velocity[3];
+    double angular_velocity[3];
+    int status = predict_motion(history, eval_time, next_pose, velocity, angular_velocity);
+    if (status == 0)
+        Telemetry::Get().prediction_horizon.RecordSeconds(eval_time - history.last_capture);
+    post_pose(status, eval_time, next_pose, velocity, angular_velocity);
+}
+
+void ExampleDriver::TrackerDevice::load_prediction(PoseBatch& batch, size_t lane)
+{
+    //only the regression runs batched, the other filters predict in apply_prediction. fetch_history was called before.
+    const PoseSnapshot& history = this->published_history_.Front();
+    if (history.filter != PoseFilterType::Regression)
         return;
 
-    // Check if this device was asked to be identified
-    auto events = GetDriver()->GetOpenVREvents();
-    for (auto event : events) {
-        // Note here, event.trackedDeviceIndex does not necissarily equal this->device_index_, not sure why, but the component handle will match so we can just use that instead
-        //if (event.trackedDeviceIndex == this->device_index_) {
-        if (event.eventType == vr::EVREventType::VREvent_Input_HapticVibration) {
-            if (event.data.hapticVibration.componentHandle == this->haptic_component_) {
-                this->did_vibrate_ = true;
-            }
-        }
-        //}
+    int status = prediction_time(history.last_update, 0, this->batch_time_);
+    if (history.samples < RegressionFilter::kMinSamples)
+        status = -1;
+    batch.Load(lane, status, history.moments, history.samples, this->batch_time_ - history.moments.origin);
+}
+
+void ExampleDriver::TrackerDevice::apply_prediction(const PoseBatch& batch, size_t lane)
+{
+    const PoseSnapshot& history = this->published_history_.Front();
+    double eval_time;
+    double next_pose[7];
+    double velocity[3];
+    double angular_velocity[3];
+    int status;
+    if (history.filter == PoseFilterType::Regression)
+    {
+        double slope[7];
+        eval_time = this->batch_time_;
+        status = batch.Status(lane);
+        batch.GetPrediction(lane, next_pose);
+        batch.GetSlope(lane, slope);
+        //same as RegressionFilter::Velocity
+        for (int i = 0; i < 3; i++)
+            velocity[i] = slope[i];
+        Quaternion::AngularVelocity(next_pose + 3, slope + 3, angular_velocity);
     }
+    else
+    {
+        status = predict_motion(history, eval_time, next_pose, velocity, angular_velocity);
+    }
+    if (status == 0)
+        Telemetry::Get().prediction_horizon.RecordSeconds(eval_time - history.last_capture);
+    post_pose(status, eval_time, next_pose, velocity, angular_velocity);
+}
+
+bool ExampleDriver::TrackerDevice::fetch_history()
+{
+    // Pick up the newest history the pipe side has published, never waits on it
+    return this->published_history_.Fetch();
+}
+
+void ExampleDriver::TrackerDevice::handle_events()
+{
+    if (this->device_index_.load(std::memory_order_acquire) == vr::k_unTrackedDeviceIndexInvalid)
+        return;
 
     // Check if we need to keep vibrating
     if (this->did_vibrate_) {
-        this->vibrate_anim_state_ += (GetDriver()->GetLastFrameTime().count() / 1000.f);
+        this->vibrate_anim_state_ += std::chrono::duration<float>(GetDriver()->GetLastFrameTime()).count();
         if (this->vibrate_anim_state_ > 1.0f) {
             this->did_vibrate_ = false;
             this->vibrate_anim_state_ = 0.0f;
         }
     }
+}
+
+void ExampleDriver::TrackerDevice::get_post_stats(uint64_t& count, double& rate, double& jitter) const
+{
+    count = this->post_count_.load(std::memory_order_relaxed);
+    double interval = this->post_interval_.load(std::memory_order_relaxed);
+    rate = interval > 0 ? 1.0 / interval : 0;
+    jitter = this->post_jitter_.load(std::memory_order_relaxed);
+}
+
+void ExampleDriver::TrackerDevice::post_pose(int status, double pose_time, double next_pose[], const double velocity[], const double angular_velocity[])
+{
+    //read once, Deactivate may clear it while this runs
+    vr::TrackedDeviceIndex_t device_index = this->device_index_.load(std::memory_order_acquire);
+    if (device_index == vr::k_unTrackedDeviceIndexInvalid)
+        return;
 
     // Setup pose for this frame
     auto pose = this->last_pose_;
 
     // Update time delta (for working out velocity)
-    std::chrono::milliseconds time_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
-    double time_since_epoch_seconds = time_since_epoch.count() / 1000.0;
-    double pose_time_delta_seconds = (time_since_epoch - _pose_timestamp).count() / 1000.0;
+    double call_time = Clock::Now();
+    double pose_time_delta_seconds = call_time - _pose_timestamp;
 
     // Update pose timestamp
 
-    _pose_timestamp = time_since_epoch;
+    _pose_timestamp = call_time;
     
     // Copy the previous position data
     double previous_position[3] = { 0 };
     std::copy(std::begin(pose.vecPosition), std::end(pose.vecPosition), std::begin(previous_position));
 
-    double next_pose[7];
-    if (get_next_pose(0, next_pose) != 0)
+    double smoothing = this->published_history_.Front().smoothing;
+
+    if (status != 0)
         return;
 
     normalizeQuat(next_pose);
@@ -102,21 +259,15 @@ void ExampleDriver::TrackerDevice::Update()
     pose.vecPosition[1] = next_pose[1] * (1 - smoothing) + pose.vecPosition[1] * smoothing;
     pose.vecPosition[2] = next_pose[2] * (1 - smoothing) + pose.vecPosition[2] * smoothing;
 
-    pose.qRotation.w = next_pose[3] * (1 - smoothing) + pose.qRotation.w * smoothing;
-    pose.qRotation.x = next_pose[4] * (1 - smoothing) + pose.qRotation.x * smoothing;
-    pose.qRotation.y = next_pose[5] * (1 - smoothing) + pose.qRotation.y * smoothing;
-    pose.qRotation.z = next_pose[6] * (1 - smoothing) + pose.qRotation.z * smoothing;
-
-    //normalize
-    double mag = sqrt(pose.qRotation.w * pose.qRotation.w +
-        pose.qRotation.x * pose.qRotation.x +
-        pose.qRotation.y * pose.qRotation.y +
-        pose.qRotation.z * pose.qRotation.z);
+    //blend rotations along the sphere, blending the components and normalizing cuts corners on big turns
+    double previous_rotation[4] = { pose.qRotation.w, pose.qRotation.x, pose.qRotation.y, pose.qRotation.z };
+    double rotation[4];
+    Quaternion::Slerp(next_pose + 3, previous_rotation, smoothing, rotation);
 
-    pose.qRotation.w /= mag;
-    pose.qRotation.x /= mag;
-    pose.qRotation.y /= mag;
-    pose.qRotation.z /= mag;
+    pose.qRotation.w = rotation[0];
+    pose.qRotation.x = rotation[1];
+    pose.qRotation.y = rotation[2];
+    pose.qRotation.z = rotation[3];
 
     /*
     if (pose_time_delta_seconds > 0)            //unless we get two pose updates at the same time, update velocity so steamvr can do some interpolation
@@ -129,31 +280,65 @@ void ExampleDriver::TrackerDevice::Update()
     
     */
 
-    pose.poseTimeOffset = 0;
+    //let SteamVR extrapolate between our updates from the velocities of the fitted model. The pose was predicted for
+    //pose_time, a moment before this call.
+    for (int i = 0; i < 3; i++)
+    {
+        pose.vecVelocity[i] = velocity[i];
+        pose.vecAngularVelocity[i] = angular_velocity[i];
+    }
+    pose.poseTimeOffset = pose_time - call_time;
 
     //pose.vecVelocity[0] = (pose.vecPosition[0] - previous_position[0]) / pose_time_delta_seconds;
     //pose.vecVelocity[1] = (pose.vecPosition[1] - previous_position[1]) / pose_time_delta_seconds;
     //pose.vecVelocity[2] = (pose.vecPosition[2] - previous_position[2]) / pose_time_delta_seconds;
 
     // Post pose
-    GetDriver()->GetDriverHost()->TrackedDevicePoseUpdated(this->device_index_, pose, sizeof(vr::DriverPose_t));
+    GetDriver()->PostPose(device_index, pose);
     this->last_pose_ = pose;
+
+    //smoothed interval between posts and how much it wanders, for the publisherstats command
+    std::chrono::steady_clock::time_point posted = std::chrono::steady_clock::now();
+    uint64_t count = this->post_count_.load(std::memory_order_relaxed);
+    if (count > 0)
+    {
+        double interval = std::chrono::duration<double>(posted - this->last_post_time_).count();
+        double avg_interval = this->post_interval_.load(std::memory_order_relaxed);
+        if (count == 1)
+            avg_interval = interval;
+        double jitter = this->post_jitter_.load(std::memory_order_relaxed);
+        jitter = jitter * 0.95 + std::abs(interval - avg_interval) * 0.05;
+        avg_interval = avg_interval * 0.95 + interval * 0.05;
+        this->post_interval_.store(avg_interval, std::memory_order_relaxed);
+        this->post_jitter_.store(jitter, std::memory_order_relaxed);
+    }
+    this->last_post_time_ = posted;
+    this->post_count_.store(count + 1, std::memory_order_relaxed);
 }
 
 void ExampleDriver::TrackerDevice::Log(std::string message)
 {
-    std::string message_endl = message + "\n";
-    vr::VRDriverLog()->Log(message_endl.c_str());
+    DriverLog::Get().Write(message);
+}
+
+void ExampleDriver::TrackerDevice::publish_history()
+{
+    this->published_history_.Back().CopyFrom(this->history_);
+    this->published_history_.Publish();
+    this->staged_ = false;
 }
 
 int ExampleDriver::TrackerDevice::get_next_pose(double time_offset, double pred[])
 {
-    int statuscode = 0;
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
+    return predict_pose(this->history_, time_offset, pred);
+}
 
-    std::chrono::milliseconds time_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
-    double time_since_epoch_seconds = time_since_epoch.count() / 1000.0;
+int ExampleDriver::TrackerDevice::prediction_time(double last_update, double time_offset, double& eval_time)
+{
+    int statuscode = 0;
 
-    double req_time = time_since_epoch_seconds - time_offset;
+    double req_time = Clock::Now() - time_offset;
 
     double new_time = last_update - req_time;
 
@@ -163,94 +348,136 @@ int ExampleDriver::TrackerDevice::get_next_pose(double time_offset, double pred[
         statuscode = 1;
     }
 
-    int curr_saved = 0;
-    //double pred[7] = {0};
+    //new_time is an age, count back from the last update
+    eval_time = last_update - new_time;
+    return statuscode;
+}
 
-    double avg_time = 0;
-    double avg_time2 = 0;
-    for (int i = 0; i < max_saved; i++)
-    {
-        if (prev_positions[i][0] < 0)
-            break;
-        curr_saved++;
-        avg_time += prev_positions[i][0];
-        avg_time2 += (prev_positions[i][0] * prev_positions[i][0]);
-    }
+int ExampleDriver::TrackerDevice::predict_motion(const PoseSnapshot& history, double& eval_time, double pred[], double velocity[], double angular_velocity[])
+{
+    int statuscode = prediction_time(history.last_update, 0, eval_time);
+
+    if (!history.Predict(eval_time, pred) || !history.Velocity(eval_time, velocity, angular_velocity))
+        statuscode = -1;
+    return statuscode;
+}
 
-    //Log("saved values: " + std::to_string(curr_saved));
+int ExampleDriver::TrackerDevice::predict_pose(const PoseHistory& history, double time_offset, double pred[])
+{
+    double eval_time;
+    int statuscode = prediction_time(history.last_update, time_offset, eval_time);
 
-    //printf("curr saved %d\n", curr_saved);
-    if (curr_saved < 4)
+    if (!history.Filter().Predict(eval_time, pred))
     {
         //printf("Too few values");
         statuscode = -1;
-        return statuscode;
-        //return 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0;
     }
-    avg_time /= curr_saved;
-    avg_time2 /= curr_saved;
+    return statuscode;
+}
 
-    //printf("avg time %f\n", avg_time);
+int ExampleDriver::TrackerDevice::save_current_pose(double a, double b, double c, double w, double x, double y, double z, double time_offset)
+{
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
 
-    double st = 0;
-    for (int j = 0; j < curr_saved; j++)
-    {
-        st += ((prev_positions[j][0] - avg_time) * (prev_positions[j][0] - avg_time));
-    }
-    st = sqrt(st * (1.0 / curr_saved));
+    int statuscode = store_pose(a, b, c, w, x, y, z, time_offset);
+    publish_history();
+    return statuscode;
+}
 
+int ExampleDriver::TrackerDevice::add_observation(uint32_t source, double a, double b, double c, double w, double x, double y, double z, double time_offset)
+{
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
 
-    for (int i = 1; i < 8; i++)
-    {
-        double avg_val = 0;
-        double avg_val2 = 0;
-        double avg_tval = 0;
-        for (int ii = 0; ii < curr_saved; ii++)
-        {
-            avg_val += prev_positions[ii][i];
-            avg_tval += (prev_positions[ii][0] * prev_positions[ii][i]);
-            avg_val2 += (prev_positions[ii][i] * prev_positions[ii][i]);
-        }
-        avg_val /= curr_saved;
-        avg_tval /= curr_saved;
-        avg_val2 /= curr_saved;
+    double pose[7] = { a, b, c, w, x, y, z };
+    bool stored;
+    int statuscode = observe(source, pose, time_offset, stored);
+    if (stored)
+        publish_history();
+    return statuscode;
+}
+
+int ExampleDriver::TrackerDevice::stage_observation(uint32_t source, double a, double b, double c, double w, double x, double y, double z, double time_offset)
+{
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
 
-        //printf("--avg: %f\n", avg_val);
+    //like add_observation, but RunFrame only sees the sample once publish_staged runs, with the rest of its batch
+    double pose[7] = { a, b, c, w, x, y, z };
+    bool stored;
+    int statuscode = observe(source, pose, time_offset, stored);
+    this->staged_ = this->staged_ || stored;
+    return statuscode;
+}
 
-        double sv = 0;
-        for (int j = 0; j < curr_saved; j++)
-        {
-            sv += ((prev_positions[j][i] - avg_val) * (prev_positions[j][i] - avg_val));
-        }
-        sv = sqrt(sv * (1.0 / curr_saved));
+void ExampleDriver::TrackerDevice::publish_staged()
+{
+    std::lock_guard<std::mutex> lock(this->write_mutex_);
+    if (this->staged_)
+        publish_history();
+}
 
-        //printf("----sv: %f\n", sv);
+int ExampleDriver::TrackerDevice::observe(uint32_t source, const double pose[], double time_offset, bool& stored)
+{
+    //called with write_mutex_ held. 0 if the observation was stored or is waiting for the other cameras, 1 if the sample
+    //it ended up in was dropped
+    double now = Clock::Now();
+    PoseFusion::Sample fused[2];
+    int count = this->fusion_.Add(source, pose, now - time_offset, now, this->history_.Filter(), fused);
 
-        double rxy = (avg_tval - (avg_val * avg_time)) / sqrt((avg_time2 - (avg_time * avg_time)) * (avg_val2 - (avg_val * avg_val)));
-        double b = rxy * (sv / st);
-        double a = avg_val - (b * avg_time);
+    int statuscode = 0;
+    for (int i = 0; i < count; i++)
+        statuscode = store_fused(fused[i], now);
+    stored = count > 0;
+    return statuscode;
+}
 
-        //printf("a: %f, b: %f\n", a, b);
+void ExampleDriver::TrackerDevice::flush_observations(double lead)
+{
+    //called every frame, like drain_samples it does not wait for a pipe client. lead is the time until the next call.
+    std::unique_lock<std::mutex> lock(this->write_mutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
 
-        double y = a + b * new_time;
-        //Log("aha: " + std::to_string(y) + std::to_string(avg_val));
-        if (abs(avg_val2 - (avg_val * avg_val)) < 0.00000001)               //bloody floating point rounding errors
-            y = avg_val;
+    double now = Clock::Now();
+    PoseFusion::Sample fused;
+    if (!this->fusion_.Flush(now, lead, this->history_.Filter(), fused))
+        return;
 
-        pred[i - 1] = y;
-        //printf("<<<< %f --> %f\n",y, pred[i-1]);
+    store_fused(fused, now);
+    publish_history();
+}
+
+int ExampleDriver::TrackerDevice::store_fused(const PoseFusion::Sample& sample, double now)
+{
+    const double* pose = sample.pose;
+    return store_pose(pose[0], pose[1], pose[2], pose[3], pose[4], pose[5], pose[6], std::max(0.0, now - sample.time));
+}
 
+void ExampleDriver::TrackerDevice::drain_samples(SharedMemory::PoseRing& ring, double now)
+{
+    //called from RunFrame, if a pipe client is writing right now leave the samples for the next frame instead of waiting
+    std::unique_lock<std::mutex> lock(this->write_mutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
 
+    SharedMemory::Sample sample;
+    bool drained = false;
+    while (SharedMemory::Pop(ring, sample))
+    {
+        store_pose(sample.position[0], sample.position[1], sample.position[2],
+            sample.rotation[0], sample.rotation[1], sample.rotation[2], sample.rotation[3], std::max(0.0, now - sample.capture_time));
+        drained = true;
     }
-    //printf("::: %f\n", pred[0]);
-    return statuscode;
-    //return pred[0], pred[1], pred[2], pred[3], pred[4], pred[5], pred[6];
+
+    if (drained)
+        publish_history();
 }
 
-void ExampleDriver::TrackerDevice::save_current_pose(double a, double b, double c, double w, double x, double y, double z, double time_offset)
+int ExampleDriver::TrackerDevice::store_pose(double a, double b, double c, double w, double x, double y, double z, double time_offset)
 {
-    double next_pose[7];
-    int pose_valid = get_next_pose(time_offset, next_pose);
+    Telemetry::Get().sample_age.RecordSeconds(time_offset);
+
+    double next_pose[7] = { 0 };
+    int pose_valid = predict_pose(this->history_, time_offset, next_pose);
 
     double dot = x * next_pose[4] + y * next_pose[5] + z * next_pose[6] + w * next_pose[3];
 
@@ -263,24 +490,18 @@ void ExampleDriver::TrackerDevice::save_current_pose(double a, double b, double
     } 
 
     //update times
-    std::chrono::milliseconds time_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
-    double time_since_epoch_seconds = time_since_epoch.count() / 1000.0;
+    double time_since_epoch_seconds = Clock::Now();
 
     //Log("time since epoch: " + std::to_string(time_since_epoch_seconds));
     
     //lock_t curr_time = clock();
     //clock_t capture_time = curr_time - (timeOffset*1000);
     double curr_time = time_since_epoch_seconds;
-    double time_since_update = curr_time - this->last_update;
-    this->last_update = curr_time;
+    this->history_.last_update = curr_time;
 
-    for (int i = 0; i < max_saved; i++)
-    {
-        if (prev_positions[i][0] >= 0)
-            prev_positions[i][0] += time_since_update;
-        if (prev_positions[i][0] > max_time)
-            prev_positions[i][0] = -1;
-    }
+    //forget samples older than max_time
+    IPoseFilter& filter = history_.Filter();
+    filter.Expire(curr_time - history_.max_time);
 
     double time = time_offset;
     // double offset = (rand() % 100) / 10000.;
@@ -292,59 +513,34 @@ void ExampleDriver::TrackerDevice::save_current_pose(double a, double b, double
     double dist = sqrt(pow(next_pose[0] - a, 2) + pow(next_pose[1] - b, 2) + pow(next_pose[2] - c, 2));
     if (pose_valid == 0 && dist > 0.5)
     {
-        Log("Dropped a pose! its error was " + std::to_string(dist));
-        Log("Height vs predicted height:" + std::to_string(b) + " " + std::to_string(next_pose[1]));
-        return;
+        this->dropped_far_log_.Count(dist);
+        return 1;
     }
 
     dist = sqrt(pow(a, 2) + pow(b, 2) + pow(c, 2));
     if (dist > 10)
     {
-        Log("Dropped a pose! Was outside of playspace: " + std::to_string(dist));
-        return;
+        this->dropped_outside_log_.Count(dist);
+        return 1;
     }
 
-    if (time > max_time)
-        return;
+    if (time > history_.max_time)
+        return 1;
 
-    if (prev_positions[max_saved - 1][0] < time && prev_positions[max_saved - 1][0] >= 0)
-        return;
+    double values[7] = { a, b, c, w, x, y, z };
+    if (!filter.AddSample(curr_time - time, values))
+        return 1;
+    history_.last_capture = std::max(history_.last_capture, curr_time - time);
 
-    int i = 0;
-    while (prev_positions[i][0] < time&& prev_positions[i][0] >= 0)
-        i++;
-
-    for (int j = max_saved - 1; j > i; j--)
-    {
-        if (prev_positions[j - 1][0] >= 0)
-        {
-            for (int k = 0; k < 8; k++)
-            {
-                prev_positions[j][k] = prev_positions[j - 1][k];
-            }
-        }
-        else
-        {
-            prev_positions[j][0] = -1;
-        }
-    }
-    prev_positions[i][0] = time;
-    prev_positions[i][1] = a;
-    prev_positions[i][2] = b;
-    prev_positions[i][3] = c;
-    prev_positions[i][4] = w;
-    prev_positions[i][5] = x;
-    prev_positions[i][6] = y;
-    prev_positions[i][7] = z;
     /*                                                 //for debugging
     Log("------------------------------------------------");
-    for (int i = 0; i < max_saved; i++)
+    for (int i = 0; i < history_.regression.Samples().Size(); i++)
     {
-        Log("Time: " + std::to_string(prev_positions[i][0]));
-        Log("Position x: " + std::to_string(prev_positions[i][1]));
+        Log("Time: " + std::to_string(history_.regression.Samples().Time(i)));
+        Log("Position x: " + std::to_string(history_.regression.Samples().Value(0, i)));
     }
     */
-    return;
+    return 0;
 }
 
 /*
@@ -405,12 +601,10 @@ vr::TrackedDeviceIndex_t ExampleDriver::TrackerDevice::GetDeviceIndex()
 
 vr::EVRInitError ExampleDriver::TrackerDevice::Activate(uint32_t unObjectId)
 {
-    this->device_index_ = unObjectId;
-
     GetDriver()->Log("Activating tracker " + this->serial_);
 
     // Get the properties handle
-    auto props = GetDriver()->GetProperties()->TrackedDeviceToPropertyContainer(this->device_index_);
+    auto props = GetDriver()->GetProperties()->TrackedDeviceToPropertyContainer(unObjectId);
 
     // Set some universe ID (Must be 2 or higher)
     GetDriver()->GetProperties()->SetUint64Property(props, vr::Prop_CurrentUniverseId_Uint64, 3);
@@ -474,12 +668,21 @@ vr::EVRInitError ExampleDriver::TrackerDevice::Activate(uint32_t unObjectId)
     if(rolehint != "vive_tracker")
         vr::VRSettings()->SetString(vr::k_pch_Trackers_Section, l_registeredDevice.c_str(), role_.c_str());
 
+    // Get told when this device is asked to vibrate
+    GetDriver()->GetInput()->CreateHapticComponent(props, "/output/haptic", &this->haptic_component_);
+    GetDriver()->SubscribeEvent(vr::VREvent_Input_HapticVibration, this->haptic_component_, this);
+
+    // Poses are posted from here on, the device is set up
+    this->device_index_.store(unObjectId, std::memory_order_release);
+
     return vr::EVRInitError::VRInitError_None;
 }
 
 void ExampleDriver::TrackerDevice::Deactivate()
 {
-    this->device_index_ = vr::k_unTrackedDeviceIndexInvalid;
+    // The pose publisher could be half way through posting this tracker, it is stopped for good first
+    GetDriver()->StopPosePublisher();
+    this->device_index_.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_release);
 }
 
 void ExampleDriver::TrackerDevice::EnterStandby()
@@ -6,15 +6,78 @@
 #include <linalg.h>
 
 #include <Driver/IVRDevice.hpp>
+#include <Driver/Clock.hpp>
+#include <Driver/Telemetry.hpp>
+#include <Driver/TripleBuffer.hpp>
+#include <Driver/SampleRing.hpp>
+#include <Driver/PoseBatch.hpp>
+#include <Driver/Quaternion.hpp>
+#include <Driver/IPoseFilter.hpp>
+#include <Driver/RegressionFilter.hpp>
+#include <Driver/KalmanFilter.hpp>
+#include <Driver/OneEuroFilter.hpp>
+#include <Driver/PoseFusion.hpp>
+#include <Driver/SharedMemory.hpp>
+#include <Driver/DriverLog.hpp>
 #include <Native/DriverFactory.hpp>
 
-#include <windows.h>
+#include <atomic>
+#include <mutex>
 #include <thread>
 #include <sstream>
 #include <iostream>
 #include <string>
 
 namespace ExampleDriver {
+
+    // The pipe side's state of a tracker: every filter by value, only the selected one is fed samples.
+    struct PoseHistory {
+        PoseFilterType filter = PoseFilterType::Regression;
+        RegressionFilter regression;
+        KalmanFilter kalman;
+        OneEuroFilter one_euro;
+        double last_update = 0;
+        double last_capture = 0;        // capture time of the newest stored sample
+        double max_time = 1;
+        double smoothing = 0;
+
+        IPoseFilter& Filter()
+        {
+            return const_cast<IPoseFilter&>(static_cast<const PoseHistory*>(this)->Filter());
+        }
+
+        const IPoseFilter& Filter() const
+        {
+            switch (filter)
+            {
+            case PoseFilterType::Kalman:
+                return kalman;
+            case PoseFilterType::OneEuro:
+                return one_euro;
+            default:
+                return regression;
+            }
+        }
+    };
+
+    // What RunFrame needs of a PoseHistory to predict, handed from the pipe side to RunFrame as one unit.
+    // Only the selected filter is copied into it, and of the regression only the ring's running sums, so publishing
+    // one costs the same at any history size and never allocates.
+    struct PoseSnapshot {
+        PoseFilterType filter = PoseFilterType::Regression;
+        SampleRing::Moments moments;    // regression
+        int samples = 0;
+        KalmanFilter kalman;
+        OneEuroFilter one_euro;
+        double last_update = 0;
+        double last_capture = 0;
+        double smoothing = 0;
+
+        void CopyFrom(const PoseHistory& history);
+        bool Predict(double time, double pose[]) const;
+        bool Velocity(double time, double velocity[], double angular_velocity[]) const;
+    };
+
     class TrackerDevice : public IVRDevice {
         public:
 
@@ -24,10 +87,21 @@ namespace ExampleDriver {
             // Inherited via IVRDevice
             virtual std::string GetSerial() override;
             virtual void Update() override;
+            virtual void OnEvent(const vr::VREvent_t& event) override;
             //virtual void UpdatePos(double a, double b, double c, double time, double smoothing);
             //virtual void UpdateRot(double qw, double qx, double qy, double qz, double time, double smoothing);
-            virtual void save_current_pose(double a, double b, double c, double qw, double qx, double qy, double qz, double time);
+            virtual int save_current_pose(double a, double b, double c, double qw, double qx, double qy, double qz, double time);
+            virtual int add_observation(uint32_t source, double a, double b, double c, double qw, double qx, double qy, double qz, double time);
+            virtual int stage_observation(uint32_t source, double a, double b, double c, double qw, double qx, double qy, double qz, double time);
+            virtual void publish_staged();
+            virtual bool fetch_history();
+            virtual void flush_observations(double lead);
             virtual int get_next_pose(double req_time, double pred[]);
+            virtual void drain_samples(SharedMemory::PoseRing& ring, double now);
+            virtual void load_prediction(PoseBatch& batch, size_t lane);
+            virtual void apply_prediction(const PoseBatch& batch, size_t lane);
+            virtual void handle_events();
+            virtual void get_post_stats(uint64_t& count, double& rate, double& jitter) const;
             virtual vr::TrackedDeviceIndex_t GetDeviceIndex() override;
             virtual DeviceType GetDeviceType() override;
             virtual void Log(std::string message);
@@ -39,14 +113,18 @@ namespace ExampleDriver {
             virtual void DebugRequest(const char* pchRequest, char* pchResponseBuffer, uint32_t unResponseBufferSize) override;
             virtual vr::DriverPose_t GetPose() override;
             virtual void reinit(int msaved, double mtime, double msmooth);
+            virtual void set_filter(PoseFilterType filter, double param1, double param2);
+            virtual void set_fusion_window(double window);
+            virtual int get_fusion_stats(PoseFusion::SourceStats stats[], int max);
 
     private:
-        vr::TrackedDeviceIndex_t device_index_ = vr::k_unTrackedDeviceIndexInvalid;
+        // Set by SteamVR's Activate and Deactivate, read by RunFrame, the pose publisher and pipe clients
+        std::atomic<vr::TrackedDeviceIndex_t> device_index_{ vr::k_unTrackedDeviceIndexInvalid };
         std::string serial_;
         std::string role_;
         bool isSetup;
 
-        std::chrono::milliseconds _pose_timestamp;
+        double _pose_timestamp = 0;
 
         vr::DriverPose_t last_pose_ = IVRDevice::MakeDefaultPose();
 
@@ -58,11 +136,32 @@ namespace ExampleDriver {
         vr::VRInputComponentHandle_t system_click_component_ = 0;
         vr::VRInputComponentHandle_t system_touch_component_ = 0;
 
-        int max_saved = 10;
-        std::vector<std::vector<double>> prev_positions; // prev_positions[:][0] je time since now (koliko cajta nazaj se je naredl, torej min-->max)
-        double last_update = 0;
-        double max_time = 1;
-        double smoothing = 0;
-
+        // Pose writers (pipe clients and the shared memory drain) own history_ and are serialized by write_mutex_.
+        // Update never takes the lock, it reads the last snapshot published through published_history_.
+        std::mutex write_mutex_;
+        PoseHistory history_;
+        TripleBuffer<PoseSnapshot> published_history_;
+        PoseFusion fusion_;         // observations of several cameras waiting to become one sample, under write_mutex_ as well
+        bool staged_ = false;       // history_ holds samples of a batch that publish_staged has not published yet
+
+        // Dropped samples come in bursts when a tag is hard to see, they are summed up in the log once a second
+        LogSite dropped_far_log_;
+        LogSite dropped_outside_log_;
+
+        void publish_history();
+        int observe(uint32_t source, const double pose[], double time_offset, bool& stored);
+        void post_pose(int status, double pose_time, double next_pose[], const double velocity[], const double angular_velocity[]);
+        int store_pose(double a, double b, double c, double qw, double qx, double qy, double qz, double time);
+        int store_fused(const PoseFusion::Sample& sample, double now);
+        static int prediction_time(double last_update, double time_offset, double& eval_time);
+        static int predict_pose(const PoseHistory& history, double time_offset, double pred[]);
+        static int predict_motion(const PoseSnapshot& history, double& eval_time, double pred[], double velocity[], double angular_velocity[]);
+        double batch_time_ = 0;     // prediction time picked by load_prediction, only used by the posting thread
+
+        // Written by whichever thread posts poses (RunFrame or the pose publisher), readable from anywhere
+        std::atomic<uint64_t> post_count_{ 0 };
+        std::atomic<double> post_interval_{ 0 };   // smoothed seconds between posts
+        std::atomic<double> post_jitter_{ 0 };     // smoothed deviation from that interval, seconds
+        std::chrono::steady_clock::time_point last_post_time_;
     };
 };
\ No newline at end of file
@@ -1,5 +1,4 @@
 #include "TrackingReferenceDevice.hpp"
-#include <Windows.h>
 
 ExampleDriver::TrackingReferenceDevice::TrackingReferenceDevice(std::string serial):
     serial_(serial)
@@ -16,7 +15,8 @@ std::string ExampleDriver::TrackingReferenceDevice::GetSerial()
 
 void ExampleDriver::TrackingReferenceDevice::Update()
 {
-    if (this->device_index_ == vr::k_unTrackedDeviceIndexInvalid)
+    vr::TrackedDeviceIndex_t device_index = this->device_index_.load(std::memory_order_acquire);
+    if (device_index == vr::k_unTrackedDeviceIndexInvalid)
         return;
 
 
@@ -25,9 +25,9 @@ void ExampleDriver::TrackingReferenceDevice::Update()
 
     linalg::vec<float, 3> device_position{ 0.f, 1.f, 1.f };
 
-    linalg::vec<float, 4> y_quat{ 0, std::sinf(this->random_angle_rad_ / 2), 0, std::cosf(this->random_angle_rad_ / 2) }; // Point inwards (z- is forward)
+    linalg::vec<float, 4> y_quat{ 0, std::sin(this->random_angle_rad_ / 2), 0, std::cos(this->random_angle_rad_ / 2) }; // Point inwards (z- is forward)
 
-    linalg::vec<float, 4> x_look_down{ std::sinf((-3.1415f/4) / 2), 0, 0, std::cosf((-3.1415f / 4) / 2) }; // Tilt downwards to look at the centre
+    linalg::vec<float, 4> x_look_down{ std::sin((-3.1415f/4) / 2), 0, 0, std::cos((-3.1415f / 4) / 2) }; // Tilt downwards to look at the centre
 
     linalg::vec<float, 4> device_rotation = linalg::qmul(y_quat, x_look_down);
 
@@ -43,12 +43,15 @@ void ExampleDriver::TrackingReferenceDevice::Update()
     pose.qRotation.z = device_rotation.z;
 
     // Post pose
-    GetDriver()->GetDriverHost()->TrackedDevicePoseUpdated(this->device_index_, pose, sizeof(vr::DriverPose_t));
+    GetDriver()->PostPose(device_index, pose);
     this->last_pose_ = pose;
 }
 
 void ExampleDriver::TrackingReferenceDevice::UpdatePose(double a, double b, double c, double qw, double qx, double qy, double qz)
 {
+    // Called by pipe clients, read the index once in case SteamVR activates the station meanwhile
+    vr::TrackedDeviceIndex_t device_index = this->device_index_.load(std::memory_order_acquire);
+
     // Setup pose for this frame
     auto pose = IVRDevice::MakeDefaultPose();
 
@@ -62,7 +65,7 @@ void ExampleDriver::TrackingReferenceDevice::UpdatePose(double a, double b, doub
     pose.qRotation.z = qz;
 
     // Post pose
-    GetDriver()->GetDriverHost()->TrackedDevicePoseUpdated(this->device_index_, pose, sizeof(vr::DriverPose_t));
+    GetDriver()->PostPose(device_index, pose);
     this->last_pose_ = pose;
 }
 
@@ -78,12 +81,10 @@ vr::TrackedDeviceIndex_t ExampleDriver::TrackingReferenceDevice::GetDeviceIndex(
 
 vr::EVRInitError ExampleDriver::TrackingReferenceDevice::Activate(uint32_t unObjectId)
 {
-    this->device_index_ = unObjectId;
-
     GetDriver()->Log("Activating tracking reference " + this->serial_);
 
     // Get the properties handle
-    auto props = GetDriver()->GetProperties()->TrackedDeviceToPropertyContainer(this->device_index_);
+    auto props = GetDriver()->GetProperties()->TrackedDeviceToPropertyContainer(unObjectId);
 
     // Set some universe ID (Must be 2 or higher)
     GetDriver()->GetProperties()->SetUint64Property(props, vr::Prop_CurrentUniverseId_Uint64, 2);
@@ -105,12 +106,15 @@ vr::EVRInitError ExampleDriver::TrackingReferenceDevice::Activate(uint32_t unObj
     GetDriver()->GetProperties()->SetStringProperty(props, vr::Prop_NamedIconPathDeviceStandby_String, "{apriltagtrackers}/icons/trackingreference_not_ready.png");
     GetDriver()->GetProperties()->SetStringProperty(props, vr::Prop_NamedIconPathDeviceAlertLow_String, "{apriltagtrackers}/icons/trackingreference_not_ready.png");
 
+    // Poses are posted from here on, the device is set up
+    this->device_index_.store(unObjectId, std::memory_order_release);
+
     return vr::EVRInitError::VRInitError_None;
 }
 
 void ExampleDriver::TrackingReferenceDevice::Deactivate()
 {
-    this->device_index_ = vr::k_unTrackedDeviceIndexInvalid;
+    this->device_index_.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_release);
 }
 
 void ExampleDriver::TrackingReferenceDevice::EnterStandby()
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cmath>
 
@@ -30,7 +31,8 @@ namespace ExampleDriver {
             virtual vr::DriverPose_t GetPose() override;
 
     private:
-        vr::TrackedDeviceIndex_t device_index_ = vr::k_unTrackedDeviceIndexInvalid;
+        // Set by SteamVR's Activate and Deactivate, read by the threads posting poses
+        std::atomic<vr::TrackedDeviceIndex_t> device_index_{ vr::k_unTrackedDeviceIndexInvalid };
         std::string serial_;
 
         vr::DriverPose_t last_pose_ = IVRDevice::MakeDefaultPose();
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace ExampleDriver {
+
+    // Largest message either side sends, the longest replies are the text stats and publisherstats
+    constexpr size_t kMaxMessageSize = 16 * 1024;
+
+    /// <summary>
+    /// A connected, message oriented channel between the driver and one client.
+    /// Both backends preserve message boundaries, so one Send on one side is one Receive on the other.
+    /// </summary>
+    class IConnection {
+    public:
+        /// <summary>
+        /// Blocks until the next message arrives
+        /// </summary>
+        /// <param name="buffer">Buffer to receive the message into</param>
+        /// <param name="size">Size of the buffer</param>
+        /// <returns>Length of the message, or -1 if the connection was closed or the message did not fit</returns>
+        virtual int Receive(char* buffer, size_t size) = 0;
+
+        /// <summary>
+        /// Sends one message
+        /// </summary>
+        /// <returns>True on success, false if the connection was closed</returns>
+        virtual bool Send(const char* data, size_t length) = 0;
+
+        virtual ~IConnection() {}
+    };
+
+    class ITransportServer {
+    public:
+        /// <summary>
+        /// Blocks until a new client connects
+        /// </summary>
+        /// <returns>The new connection, nullptr on error</returns>
+        virtual std::unique_ptr<IConnection> Accept() = 0;
+
+        virtual ~ITransportServer() {}
+    };
+
+    /// <summary>
+    /// Creates the server side transport for this platform: a named pipe (\\.\pipe\name) on Windows,
+    /// a SOCK_SEQPACKET unix domain socket ($XDG_RUNTIME_DIR/name or /tmp/name) everywhere else
+    /// </summary>
+    /// <param name="name">Name of the pipe or socket, without any platform prefix</param>
+    /// <returns>The server, nullptr if it could not be created</returns>
+    std::unique_ptr<ITransportServer> CreateTransportServer(const std::string& name);
+
+    /// <summary>
+    /// Connects to a server created with CreateTransportServer
+    /// </summary>
+    /// <param name="name">Name of the pipe or socket, without any platform prefix</param>
+    /// <param name="timeout_ms">How long to wait for a busy server</param>
+    /// <returns>The connection, nullptr if the server could not be reached</returns>
+    std::unique_ptr<IConnection> ConnectTransport(const std::string& name, int timeout_ms = 2000);
+}
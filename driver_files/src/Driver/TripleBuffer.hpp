@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace ExampleDriver {
+
+    /// <summary>
+    /// Wait-free single writer, single reader hand-off of a value.
+    /// The writer fills Back() and calls Publish(), the reader calls Fetch() and then reads Front().
+    /// Neither side ever waits for the other, and the reader always sees a complete value.
+    /// </summary>
+    template<typename T>
+    class TripleBuffer {
+    public:
+        // writer side
+        T& Back() { return buffers_[back_]; }
+
+        void Publish()
+        {
+            back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+        }
+
+        // reader side
+
+        /// <summary>
+        /// Picks up the most recently published value, if there is a new one
+        /// </summary>
+        /// <returns>True if Front() changed</returns>
+        bool Fetch()
+        {
+            if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0)
+                return false;
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+            return true;
+        }
+
+        const T& Front() const { return buffers_[front_]; }
+
+    private:
+        static constexpr uint8_t kIndexMask = 0x3;
+        static constexpr uint8_t kFresh = 0x4;
+
+        T buffers_[3];
+        std::atomic<uint8_t> middle_{ 1 };
+        uint8_t back_ = 0;
+        uint8_t front_ = 2;
+    };
+}
@@ -4,6 +4,32 @@
 #include <Driver/ControllerDevice.hpp>
 #include <Driver/TrackingReferenceDevice.hpp>
 
+#include <cctype>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <timeapi.h>    // timeBeginPeriod, the pose publisher needs sleeps shorter than the default 15.6 ms tick
+#endif
+
+static_assert(ExampleDriver::SharedMemory::kMaxDevices == vr::k_unMaxTrackedDeviceCount, "every device index needs a shared memory slot");
+
+namespace {
+    //how long ago a sample with an absolute capture time was captured. A client clock slightly ahead of ours must not give negative ages.
+    double SampleAge(double capture_time)
+    {
+        return std::max(0.0, ExampleDriver::Clock::Now() - capture_time);
+    }
+
+    //true if the next word is a number. Optional values at the end of a command must not swallow the next command.
+    bool NumberFollows(std::istringstream& iss)
+    {
+        iss >> std::ws;
+        int next = iss.peek();
+        return std::isdigit(next) || next == '-' || next == '.';
+    }
+}
+
 vr::EVRInitError ExampleDriver::VRDriver::Init(vr::IVRDriverContext* pDriverContext)
 {
     // Perform driver context initialisation
@@ -11,8 +37,14 @@ vr::EVRInitError ExampleDriver::VRDriver::Init(vr::IVRDriverContext* pDriverCont
         return init_error;
     }
 
+    // Log from a thread of its own, so the pipe and frame threads never wait on SteamVR's log
+    DriverLog::Get().Start();
+
     Log("Activating AprilTag Driver Bridge v0.5.4...");
 
+    // Start the session clock, every timestamp in the driver counts from here
+    Clock::Epoch();
+
     // Add a HMD
     //this->AddDevice(std::make_shared<HMDDevice>("Example_HMDDevice"));
 
@@ -20,22 +52,47 @@ vr::EVRInitError ExampleDriver::VRDriver::Init(vr::IVRDriverContext* pDriverCont
     //this->AddDevice(std::make_shared<ControllerDevice>("Example_ControllerDevice", ControllerDevice::Handedness::ANY));
     //this->AddDevice(std::make_shared<ControllerDevice>("Example_ControllerDevice_Right", ControllerDevice::Handedness::RIGHT));
     
-    std::string inPipeName = "\\\\.\\pipe\\ApriltagPipeIn";
+    std::thread pipeThread(&ExampleDriver::VRDriver::PipeThread, this);
+    pipeThread.detach();
 
-    inPipe = CreateNamedPipeA(inPipeName.c_str(),
-        PIPE_ACCESS_DUPLEX,
-        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE |PIPE_WAIT,   // FILE_FLAG_FIRST_PIPE_INSTANCE is not needed but forces CreateNamedPipe(..) to fail if the pipe already exists...
-        1,
-        1024 * 16,
-        1024 * 16,
-        NMPWAIT_USE_DEFAULT_WAIT,
-        NULL);
+    // Optionally post tracker poses from a thread of their own instead of from RunFrame
+    try {
+        int publisher_rate = std::get<int>(GetSettingsValue("pose_publisher_rate"));
+        if (publisher_rate > 0)
+        {
+            this->publisher_rate_ = publisher_rate;
+            this->publisher_running_ = true;
+            this->publisher_thread_ = std::thread(&ExampleDriver::VRDriver::PosePublisherThread, this);
+            Log("Posting tracker poses at " + std::to_string(publisher_rate) + " Hz from the pose publisher");
+        }
+    }
+    catch (const std::bad_variant_access&) {}; // Wrong type or doesnt exist
 
-    //if pipe was successfully created wait for a connection
-    //ConnectNamedPipe(inPipe, NULL);
+    // How long to wait for the other cameras' observations of a tracker before fusing what arrived, 0 (the default) turns fusion off
+    try {
+        this->fusion_window = std::max(0, std::get<int>(GetSettingsValue("fusion_window"))) / 1000.0;
+    }
+    catch (const std::bad_variant_access&) {}; // Wrong type or doesnt exist
 
-    std::thread pipeThread(&ExampleDriver::VRDriver::PipeThread, this);
-    pipeThread.detach();
+    // Optionally write the telemetry histograms to the log every so many seconds
+    try {
+        this->stats_log_interval_ = std::max(0, std::get<int>(GetSettingsValue("stats_log_interval")));
+        this->last_stats_log_ = Clock::Source::now();
+    }
+    catch (const std::bad_variant_access&) {}; // Wrong type or doesnt exist
+
+    // Optionally record the session from the start, the record command can also start one later
+    try {
+        std::string record_path = std::get<std::string>(GetSettingsValue("record_path"));
+        if (!record_path.empty())
+        {
+            if (this->recorder_.Start(record_path))
+                Log("Recording session to " + record_path);
+            else
+                Log("Failed to create session recording " + record_path);
+        }
+    }
+    catch (const std::bad_variant_access&) {}; // Wrong type or doesnt exist
   
     // Add a couple tracking references
     //this->AddDevice(std::make_shared<TrackingReferenceDevice>("Example_TrackingReference_A"));
@@ -48,299 +105,994 @@ vr::EVRInitError ExampleDriver::VRDriver::Init(vr::IVRDriverContext* pDriverCont
 
 void ExampleDriver::VRDriver::Cleanup()
 {
+    StopPosePublisher();
+
+    this->recorder_.Stop();
+    DriverLog::Get().Stop();
 }
 
 void ExampleDriver::VRDriver::PipeThread()
 {
-    char buffer[1024];
-    DWORD dwWritten;
-    DWORD dwRead;
+    std::unique_ptr<ITransportServer> server = CreateTransportServer(this->pipe_name_);
+    if (server == nullptr)
+    {
+        Log("Failed to open " + this->pipe_name_ + ", no clients will be able to connect");
+        return;
+    }
 
     for (;;) 
     {
-        ConnectNamedPipe(inPipe, NULL);
-        //MessageBoxA(NULL, "connected", "Example Driver", MB_OK);
+        std::unique_ptr<IConnection> connection = server->Accept();
+        if (connection == nullptr)
+        {
+            Log("Failed to accept connection on " + this->pipe_name_);
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
 
-        //we go and read it into our buffer
-        if (ReadFile(inPipe, buffer, sizeof(buffer) - 1, &dwRead, NULL) != FALSE)
         {
-            //MessageBoxA(NULL, "connected2", "Example Driver", MB_OK);
-            buffer[dwRead] = '\0'; //add terminating zero
-            //convert our buffer to string
+            std::lock_guard<std::mutex> lock(this->pipe_clients_mutex_);
+            this->pending_connections_.push_back(std::move(connection));
+            if (this->idle_pipe_client_threads_ < (int)this->pending_connections_.size() && this->pipe_client_threads_ < kMaxPipeClients)
+            {
+                this->pipe_client_threads_++;
+                this->idle_pipe_client_threads_++;
+                std::thread clientThread(&ExampleDriver::VRDriver::PipeClientThread, this);
+                clientThread.detach();
+            }
+        }
+        this->pipe_clients_wake_.notify_one();
+    }
+}
 
-            //MessageBoxA(NULL, buffer, "Example Driver", MB_OK);
+void ExampleDriver::VRDriver::PipeClientThread()
+{
+    std::unique_lock<std::mutex> lock(this->pipe_clients_mutex_);
+    for (;;)
+    {
+        this->pipe_clients_wake_.wait(lock, [this] { return !this->pending_connections_.empty(); });
+        std::unique_ptr<IConnection> connection = std::move(this->pending_connections_.front());
+        this->pending_connections_.pop_front();
+        this->idle_pipe_client_threads_--;
+        lock.unlock();
 
-            std::string rec = buffer;
+        ServeConnection(*connection);
+        connection.reset();
 
-            //Log("Received message: " + rec);
+        lock.lock();
+        this->idle_pipe_client_threads_++;
+    }
+}
 
-            std::istringstream iss(rec);
-            std::string word;
+void ExampleDriver::VRDriver::ServeConnection(IConnection& connection)
+{
+    char buffer[4096];
+    char reply[kMaxMessageSize];
+    int length;
+    PipeSession session;
+    session.id = this->next_connection_id_++;
+
+    //serve messages until the client closes its end. Old clients using CallNamedPipe close after a single message,
+    //newer clients keep the connection open and stream many messages over it
+    while ((length = connection.Receive(buffer, sizeof(buffer) - 1)) >= 0)
+    {
+        //taken before waiting for the command lock, so clock sync sees that wait as pipe delay
+        session.receive_time = Clock::Now();
+        this->recorder_.RecordMessage(session.id, buffer, length, session.receive_time);
 
-            std::string s = "";
+        size_t reply_length;
+        {
+            std::lock_guard<std::mutex> lock(this->command_mutex_);
+            int64_t start = Clock::NowNanoseconds();
+            reply_length = HandleMessage(buffer, length, reply, sizeof(reply), session);
+            Telemetry::Get().message_handling.Record(Clock::NowNanoseconds() - start);
+        }
+
+        if (reply_length > 0 && !connection.Send(reply, reply_length))
+            break;
+    }
 
-            while (iss >> word)
+    //device poses are only published while someone listens
+    if (session.subscribed_devices != 0)
+    {
+        std::lock_guard<std::mutex> lock(this->command_mutex_);
+        SubscribeDevices(session, 0);
+    }
+}
+
+size_t ExampleDriver::VRDriver::HandleMessage(char* message, size_t length, char* reply, size_t reply_size, PipeSession& session)
+{
+    if (Protocol::IsBinaryMessage(message, length))
+    {
+        Protocol::Header header = Protocol::DecodeHeader(message, length);
+        size_t reply_length = HandleBinaryMessage(message, length, reply, reply_size, session);
+
+        //fire and forget requests are handled all the same, only nothing is sent back
+        if (!Protocol::ExpectsReply(message, length))
+            return 0;
+
+        //every reply carries the id of the request it answers, so clients can keep many requests in flight. Clients on
+        //another version get replies without one, see HandleBinaryMessage.
+        if (header.version == Protocol::kVersion && reply_length >= sizeof(Protocol::Header))
+            std::memcpy(reply + offsetof(Protocol::Header, request_id), &header.request_id, sizeof(header.request_id));
+        return reply_length;
+    }
+
+    message[length] = '\0'; //add terminating zero
+
+    std::string s = HandleTextMessage(message, session);
+
+    size_t reply_length = std::min(s.length() + 1, reply_size);     // = length of string + terminating '\0' !!!
+    std::memcpy(reply, s.c_str(), reply_length);
+    reply[reply_length - 1] = '\0';
+    return reply_length;
+}
+
+std::string ExampleDriver::VRDriver::HandleTextMessage(const char* message, PipeSession& session)
+{
+    std::string rec = message;
+
+    //Log("Received message: " + rec);
+
+    std::istringstream iss(rec);
+    std::string word;
+
+    std::string s = "";
+
+    while (iss >> word)
+    {
+        if (word == "addhipmove")
+        {
+            if (fakemove_ != nullptr)
             {
-                if (word == "addhipmove")
-                {
-                    if (fakemove_ != nullptr)
-                    {
-                        s = s + " alreadyadded";
-                    }
-                    else
-                    {
-                        fakemove_ = std::make_shared<ControllerDevice>("Example_ControllerDevice", ControllerDevice::Handedness::ANY);
-                        this->AddDevice(fakemove_);
-
-                        s = s + " added";
-                    }
-                }
-                else if (word == "hipmoveinput")
-                {
-                    if (fakemove_ == nullptr)
-                    {
-                        s = s + " notspawned";
-                    }
-                    else
-                    {
-                        float x, y, rx, ry, a, b;
-                        iss >> x; iss >> y; iss >> rx; iss >> ry; iss >> a; iss >> b;
-
-                        fakemove_->SetDirection(x, y, rx, ry, a, b);
-
-                        s = s + " updated";
-                    }
-                }
-                else if (word == "addtracker")
-                {
-                    //MessageBoxA(NULL, word.c_str(), "Example Driver", MB_OK);
-                    std::string name, role;
-
-                    iss >> name;
-                    iss >> role;
-
-                    if (name == "")
-                    {
-                        name = "UnnamedTracker" + std::to_string(this->trackers_.size());
-                        role = "TrackerRole_Waist";        //should be "vive_tracker_left_foot" or "vive_tracker_left_foot" or "vive_tracker_waist"
-                    }
-
-                    auto addtracker = std::make_shared<TrackerDevice>(name, role);
-                    this->AddDevice(addtracker);
-                    this->trackers_.push_back(addtracker);
-                    addtracker->reinit(tracker_max_saved, tracker_max_time, tracker_smoothing);
-                    s = s + " added";
-                }
-                else if (word == "addstation")
-                {
-                    auto addstation = std::make_shared<TrackingReferenceDevice>("AprilCamera" + std::to_string(this->devices_.size()));
-                    this->AddDevice(addstation);
-                    this->stations_.push_back(addstation);
-                    s = s + " added";
-                }
-                else if (word == "updatestation")
-                {
-                    int idx;
-                    double a, b, c, qw, qx, qy, qz;
-                    iss >> idx; iss >> a; iss >> b; iss >> c; iss >> qw; iss >> qx; iss >> qy; iss >> qz;
-
-                    if (idx < this->stations_.size())
-                    {
-                        this->stations_[idx]->UpdatePose(a, b, c, qw, qx, qy, qz);
-                        s = s + " updated";
-                    }
-                    else
-                    {
-                        s = s + " idinvalid";
-                    }
+                s = s + " alreadyadded";
+            }
+            else
+            {
+                fakemove_ = std::make_shared<ControllerDevice>("Example_ControllerDevice", ControllerDevice::Handedness::ANY);
+                this->AddDevice(fakemove_);
 
-                }
-                else if (word == "synctime")
-                {
-                    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-                    s = s + " " + std::to_string(this->frame_timing_avg_);
-                    s = s + " " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now - this->last_frame_time_).count());
-                }
-                else if (word == "updatepose")
-                {
-                    int idx;
-                    double a, b, c, qw, qx, qy, qz, time, smoothing;
-                    iss >> idx; iss >> a; iss >> b; iss >> c; iss >> qw; iss >> qx; iss >> qy; iss >> qz; iss >> time; iss >> smoothing;
-
-                    if (idx < this->trackers_.size())
-                    {
-                        if(time < 0)
-                            time = -time;
-                        this->trackers_[idx]->save_current_pose(a, b, c, qw, qx, qy, qz, time);
-                        //this->trackers_[idx]->UpdatePos(a, b, c, time, 1-smoothing);
-                        //this->trackers_[idx]->UpdateRot(qw, qx, qy, qz, time, 1-smoothing);
-
-                        //this->trackers_[idx]->Update();
-                        s = s + " updated";
-                    }
-                    else
-                    {
-                        s = s + " idinvalid";
-                    }
+                s = s + " added";
+            }
+        }
+        else if (word == "hipmoveinput")
+        {
+            if (fakemove_ == nullptr)
+            {
+                s = s + " notspawned";
+            }
+            else
+            {
+                float x, y, rx, ry, a, b;
+                iss >> x; iss >> y; iss >> rx; iss >> ry; iss >> a; iss >> b;
 
-                }
-                /*                                      no longer supported by new smoothing
-                else if (word == "updatepos")
-                {
-                    int idx;
-                    double a, b, c, time, smoothing;
-                    iss >> idx; iss >> a; iss >> b; iss >> c; iss >> time; iss >> smoothing;
-
-                    if (idx < this->devices_.size())
-                    {
-                        this->trackers_[idx]->UpdatePos(a, b, c, time, smoothing);
-                        this->trackers_[idx]->Update();
-                        s = s + " updated";
-                    }
-                    else
-                    {
-                        s = s + " idinvalid";
-                    }
+                fakemove_->SetDirection(x, y, rx, ry, a, b);
 
-                }
-                else if (word == "updaterot")
-                {
-                    int idx;
-                    double qw, qx, qy, qz, time, smoothing;
-                    iss >> qw; iss >> qx; iss >> qy; iss >> qz; iss >> time; iss >> smoothing;
-
-                    if (idx < this->devices_.size())
-                    {
-                        this->trackers_[idx]->UpdateRot(qw, qx, qy, qz, time, smoothing);
-                        this->trackers_[idx]->Update();
-                        s = s + " updated";
-                    }
-                    else
-                    {
-                        s = s + " idinvalid";
-                    }
-
-                }*/
-                else if (word == "getdevicepose")
-                {
-                    int idx;
-                    iss >> idx;
-
-                    vr::TrackedDevicePose_t hmd_pose[10];
-                    vr::VRServerDriverHost()->GetRawTrackedDevicePoses(1, hmd_pose, 10);
-
-                    vr::HmdQuaternion_t q = GetRotation(hmd_pose[idx].mDeviceToAbsoluteTracking);
-                    vr::HmdVector3_t pos = GetPosition(hmd_pose[idx].mDeviceToAbsoluteTracking);
-
-                    s = s + " devicepose " + std::to_string(idx);
-                    s = s + " " + std::to_string(pos.v[0]) +
-                        " " + std::to_string(pos.v[1]) +
-                        " " + std::to_string(pos.v[2]) +
-                        " " + std::to_string(q.w) +
-                        " " + std::to_string(q.x) +
-                        " " + std::to_string(q.y) +
-                        " " + std::to_string(q.z);
-                }
-                else if (word == "gettrackerpose")
-                {
-                    int idx;
-                    double time_offset;
-                    iss >> idx;
-                    iss >> time_offset;
-
-                    if (idx < this->devices_.size())
-                    {
-                        s = s + " trackerpose " + std::to_string(idx);
-
-                        double pose[7];
-                        int statuscode = this->trackers_[idx]->get_next_pose(time_offset, pose);
-
-                        s = s + " " + std::to_string(pose[0]) +
-                            " " + std::to_string(pose[1]) +
-                            " " + std::to_string(pose[2]) +
-                            " " + std::to_string(pose[3]) +
-                            " " + std::to_string(pose[4]) +
-                            " " + std::to_string(pose[5]) +
-                            " " + std::to_string(pose[6]) +
-                            " " + std::to_string(statuscode);
-                    }
-                    else
-                    {
-                        s = s + " idinvalid";
-                    }
+                s = s + " updated";
+            }
+        }
+        else if (word == "addtracker")
+        {
+            //MessageBoxA(NULL, word.c_str(), "Example Driver", MB_OK);
+            std::string name, role;
 
-                }
-                else if (word == "numtrackers")
-                {
-                    s = s + " numtrackers " + std::to_string(this->trackers_.size()) + " 0.5.4";
-                }
-                else if (word == "settings")
+            iss >> name;
+            iss >> role;
+
+            if (name == "")
+            {
+                name = "UnnamedTracker" + std::to_string(this->trackers_.Get().size());
+                role = "TrackerRole_Waist";        //should be "vive_tracker_left_foot" or "vive_tracker_left_foot" or "vive_tracker_waist"
+            }
+
+            auto addtracker = std::make_shared<TrackerDevice>(name, role);
+            this->AddDevice(addtracker);
+            addtracker->reinit(tracker_max_saved, tracker_max_time, tracker_smoothing);
+            addtracker->set_filter(tracker_filter, tracker_filter_param1, tracker_filter_param2);
+            addtracker->set_fusion_window(fusion_window);
+            this->trackers_.Add(addtracker);
+            s = s + " added";
+        }
+        else if (word == "addstation")
+        {
+            auto addstation = std::make_shared<TrackingReferenceDevice>("AprilCamera" + std::to_string(this->devices_.Get().size()));
+            this->AddDevice(addstation);
+            this->stations_.Add(addstation);
+            s = s + " added";
+        }
+        else if (word == "updatestation")
+        {
+            int idx;
+            double a, b, c, qw, qx, qy, qz;
+            iss >> idx; iss >> a; iss >> b; iss >> c; iss >> qw; iss >> qx; iss >> qy; iss >> qz;
+
+            auto& stations = this->stations_.Get();
+            if (idx < stations.size())
+            {
+                stations[idx]->UpdatePose(a, b, c, qw, qx, qy, qz);
+                s = s + " updated";
+            }
+            else
+            {
+                s = s + " idinvalid";
+            }
+
+        }
+        else if (word == "synctime")
+        {
+            //synctime -> average frame time, time since the last frame, session time now, session time of the last frame.
+            //All in ms with nanosecond digits, so a client can phase-lock its camera to the frames.
+            Clock::Source::time_point now = Clock::Source::now();
+            Clock::Source::time_point last_frame = this->last_frame_time_;
+            s = s + " " + std::to_string(this->frame_timing_avg_);
+            s = s + " " + std::to_string(std::chrono::duration<double, std::milli>(now - last_frame).count());
+            s = s + " " + std::to_string(Clock::ToSeconds(now) * 1000);
+            s = s + " " + std::to_string(Clock::ToSeconds(last_frame) * 1000);
+        }
+        else if (word == "clocksync")
+        {
+            //clocksync <client time ms> -> client time as sent, driver receive time, driver reply time, estimated offset, estimated drift.
+            //Times are in ms, receive and reply time on the driver session clock. The client gets the exact NTP offset
+            //((receive - sent) + (reply - arrived)) / 2 and round trip delay from its own arrival time, or uses the driver's
+            //running estimate: offset is driver time - client time in ms at the sent time, drift is in parts per million.
+            double sent;
+            iss >> sent;
+
+            double client_time = sent / 1000;
+            session.clock.AddExchange(client_time, session.receive_time);
+
+            s = s + " " + std::to_string(sent);
+            s = s + " " + std::to_string(session.receive_time * 1000);
+            s = s + " " + std::to_string(Clock::Now() * 1000);
+            s = s + " " + std::to_string(session.clock.Offset(client_time) * 1000);
+            s = s + " " + std::to_string(session.clock.Drift() * 1e6);
+        }
+        else if (word == "updateposeat")
+        {
+            //like updatepose, but the time is the absolute capture time in driver session ms, see clocksync.
+            //Unlike an age, this does not grow with the time the message spent in the pipe.
+            int idx;
+            double a, b, c, qw, qx, qy, qz, capture_time;
+            uint32_t source = PoseFusion::kNoSource;
+            iss >> idx; iss >> a; iss >> b; iss >> c; iss >> qw; iss >> qx; iss >> qy; iss >> qz; iss >> capture_time;
+            if (NumberFollows(iss))
+                iss >> source;
+
+            auto& trackers = this->trackers_.Get();
+            if (idx >= 0 && idx < trackers.size())
+            {
+                trackers[idx]->add_observation(source, a, b, c, qw, qx, qy, qz, SampleAge(capture_time / 1000));
+                WakePosePublisher();
+                s = s + " updated";
+            }
+            else
+            {
+                s = s + " idinvalid";
+            }
+        }
+        else if (word == "updatepose")
+        {
+            //updatepose <idx> <x> <y> <z> <qw> <qx> <qy> <qz> <age> <smoothing> [camera], the camera id is what fusion
+            //tells the sources of a tracker apart by. Poses without one are never fused.
+            int idx;
+            double a, b, c, qw, qx, qy, qz, time, smoothing;
+            uint32_t source = PoseFusion::kNoSource;
+            iss >> idx; iss >> a; iss >> b; iss >> c; iss >> qw; iss >> qx; iss >> qy; iss >> qz; iss >> time; iss >> smoothing;
+            if (NumberFollows(iss))
+                iss >> source;
+
+            auto& trackers = this->trackers_.Get();
+            if (idx < trackers.size())
+            {
+                if(time < 0)
+                    time = -time;
+                trackers[idx]->add_observation(source, a, b, c, qw, qx, qy, qz, time);
+                WakePosePublisher();
+                //this->trackers_[idx]->UpdatePos(a, b, c, time, 1-smoothing);
+                //this->trackers_[idx]->UpdateRot(qw, qx, qy, qz, time, 1-smoothing);
+
+                //this->trackers_[idx]->Update();
+                s = s + " updated";
+            }
+            else
+            {
+                s = s + " idinvalid";
+            }
+
+        }
+        else if (word == "updateposes")
+        {
+            //batch of updatepose samples: count, then idx x y z qw qx qy qz time for each sample, then optionally the
+            //camera id of all of them
+            Protocol::UpdatePoseBatchMessage batch;
+            uint8_t status[Protocol::kMaxBatchSize];
+
+            iss >> batch.count;
+            if (batch.count > Protocol::kMaxBatchSize)
+                batch.count = 0;
+
+            for (uint32_t i = 0; i < batch.count; i++)
+            {
+                Protocol::PoseSample& sample = batch.samples[i];
+                iss >> sample.idx; iss >> sample.position[0]; iss >> sample.position[1]; iss >> sample.position[2];
+                iss >> sample.rotation[0]; iss >> sample.rotation[1]; iss >> sample.rotation[2]; iss >> sample.rotation[3]; iss >> sample.time;
+            }
+            uint32_t source = PoseFusion::kNoSource;
+            if (batch.count > 0 && NumberFollows(iss))
+                iss >> source;
+            for (uint32_t i = 0; i < batch.count; i++)
+                batch.samples[i].source = source;
+
+            ApplyPoseBatch(batch.samples, batch.count, status);
+
+            s = s + " batch";
+            for (uint32_t i = 0; i < batch.count; i++)
+                s = s + " " + std::to_string(status[i]);
+        }
+        /*                                      no longer supported by new smoothing
+        else if (word == "updatepos")
+        {
+            int idx;
+            double a, b, c, time, smoothing;
+            iss >> idx; iss >> a; iss >> b; iss >> c; iss >> time; iss >> smoothing;
+
+            if (idx < this->devices_.size())
+            {
+                this->trackers_[idx]->UpdatePos(a, b, c, time, smoothing);
+                this->trackers_[idx]->Update();
+                s = s + " updated";
+            }
+            else
+            {
+                s = s + " idinvalid";
+            }
+
+        }
+        else if (word == "updaterot")
+        {
+            int idx;
+            double qw, qx, qy, qz, time, smoothing;
+            iss >> qw; iss >> qx; iss >> qy; iss >> qz; iss >> time; iss >> smoothing;
+
+            if (idx < this->devices_.size())
+            {
+                this->trackers_[idx]->UpdateRot(qw, qx, qy, qz, time, smoothing);
+                this->trackers_[idx]->Update();
+                s = s + " updated";
+            }
+            else
+            {
+                s = s + " idinvalid";
+            }
+
+        }*/
+        else if (word == "getdevicepose")
+        {
+            //getdevicepose <idx> [seconds] -> the device's pose predicted that far ahead, by default the current pose
+            //like the shared memory subscription publishes
+            int idx = -1;
+            iss >> idx;
+            double prediction = 0;
+            if (NumberFollows(iss))
+                iss >> prediction;
+
+            if (idx < 0 || idx >= (int)vr::k_unMaxTrackedDeviceCount)
+            {
+                s = s + " idinvalid";
+                continue;
+            }
+
+            vr::TrackedDevicePose_t device_poses[vr::k_unMaxTrackedDeviceCount];
+            vr::VRServerDriverHost()->GetRawTrackedDevicePoses(float(prediction), device_poses, vr::k_unMaxTrackedDeviceCount);
+
+            vr::HmdQuaternion_t q = GetRotation(device_poses[idx].mDeviceToAbsoluteTracking);
+            vr::HmdVector3_t pos = GetPosition(device_poses[idx].mDeviceToAbsoluteTracking);
+
+            s = s + " devicepose " + std::to_string(idx);
+            s = s + " " + std::to_string(pos.v[0]) +
+                " " + std::to_string(pos.v[1]) +
+                " " + std::to_string(pos.v[2]) +
+                " " + std::to_string(q.w) +
+                " " + std::to_string(q.x) +
+                " " + std::to_string(q.y) +
+                " " + std::to_string(q.z);
+        }
+        else if (word == "gettrackerpose")
+        {
+            int idx;
+            double time_offset;
+            iss >> idx;
+            iss >> time_offset;
+
+            auto& trackers = this->trackers_.Get();
+            if (idx < trackers.size())
+            {
+                s = s + " trackerpose " + std::to_string(idx);
+
+                double pose[7];
+                int statuscode = trackers[idx]->get_next_pose(time_offset, pose);
+
+                s = s + " " + std::to_string(pose[0]) +
+                    " " + std::to_string(pose[1]) +
+                    " " + std::to_string(pose[2]) +
+                    " " + std::to_string(pose[3]) +
+                    " " + std::to_string(pose[4]) +
+                    " " + std::to_string(pose[5]) +
+                    " " + std::to_string(pose[6]) +
+                    " " + std::to_string(statuscode);
+            }
+            else
+            {
+                s = s + " idinvalid";
+            }
+
+        }
+        else if (word == "numtrackers")
+        {
+            s = s + " numtrackers " + std::to_string(this->trackers_.Get().size()) + " 0.5.4";
+        }
+        else if (word == "handshake")
+        {
+            //clients ask which binary protocol version we speak, old clients never send this and keep using text
+            int client_version = 0;
+            iss >> client_version;
+
+            s = s + " handshake " + std::to_string(Protocol::kVersion);
+        }
+        else if (word == "sharedmemory")
+        {
+            //switch pose uploads to shared memory, the pipe stays in use for everything else
+            if (this->shared_poses_.Get() == nullptr && !this->shared_poses_.Open(this->shared_memory_name_, true))
+            {
+                Log("Failed to create shared memory " + this->shared_memory_name_);
+                s = s + " sharedmemoryfailed";
+            }
+            else
+            {
+                s = s + " sharedmemory " + this->shared_memory_name_ +
+                    " " + std::to_string(SharedMemory::kVersion) +
+                    " " + std::to_string(SharedMemory::kMaxTrackers) +
+                    " " + std::to_string(SharedMemory::kRingSize);
+            }
+        }
+        else if (word == "subscribe")
+        {
+            //subscribe [idx ...] -> the poses of these devices are written to shared memory every frame, until the next
+            //subscribe or until this connection closes. Replaces the previous subscription, no indices ends it.
+            uint64_t devices = 0;
+            bool valid = true;
+            while (iss >> std::ws && std::isdigit(iss.peek()))
+            {
+                int idx;
+                iss >> idx;
+                if (idx >= (int)SharedMemory::kMaxDevices)
+                    valid = false;
+                else
+                    devices |= uint64_t(1) << idx;
+            }
+
+            if (!valid)
+            {
+                s = s + " idinvalid";
+            }
+            else if (this->shared_poses_.Get() == nullptr && !this->shared_poses_.Open(this->shared_memory_name_, true))
+            {
+                Log("Failed to create shared memory " + this->shared_memory_name_);
+                s = s + " sharedmemoryfailed";
+            }
+            else
+            {
+                SubscribeDevices(session, devices);
+                s = s + " subscribed " + this->shared_memory_name_ +
+                    " " + std::to_string(SharedMemory::kVersion) +
+                    " " + std::to_string(SharedMemory::kMaxDevices);
+            }
+        }
+        else if (word == "stats")
+        {
+            //stats -> per histogram since the driver started: name, count, then mean, p50, p90, p99, p99.9 and max in ms
+            Histogram::Snapshot snapshot;
+            Telemetry& telemetry = Telemetry::Get();
+            s = s + " stats " + std::to_string(Telemetry::kHistograms);
+            for (int i = 0; i < Telemetry::kHistograms; i++)
+            {
+                telemetry.At(i).Read(snapshot);
+                s = s + " " + Telemetry::Format(Telemetry::Name(i), snapshot);
+            }
+        }
+        else if (word == "record")
+        {
+            //record <path> -> starts recording the session into a new file, record -> stops and reports how many records were written and dropped
+            std::string path;
+            iss >> path;
+            if (path.empty())
+            {
+                this->recorder_.Stop();
+                s = s + " recorded " + std::to_string(this->recorder_.Records()) + " " + std::to_string(this->recorder_.Dropped());
+            }
+            else if (this->recorder_.Start(path))
+            {
+                s = s + " recording";
+            }
+            else
+            {
+                Log("Failed to create session recording " + path);
+                s = s + " recordfailed";
+            }
+        }
+        else if (word == "publisherstats")
+        {
+            //publisherstats -> rate, then per tracker: poses posted, achieved Hz, jitter in ms
+            auto& trackers = this->trackers_.Get();
+            s = s + " publisherstats " + std::to_string(this->publisher_rate_) + " " + std::to_string(trackers.size());
+            for (auto& device : trackers)
+            {
+                uint64_t count;
+                double rate;
+                double jitter;
+                device->get_post_stats(count, rate, jitter);
+                s = s + " " + std::to_string(count) + " " + std::to_string(rate) + " " + std::to_string(jitter * 1000);
+            }
+        }
+        else if (word == "fusionstats")
+        {
+            //fusionstats <idx> -> window in ms, then per camera: camera id, learned error in mm, accepted and rejected observations
+            int idx = -1;
+            iss >> idx;
+
+            auto& trackers = this->trackers_.Get();
+            if (idx >= 0 && idx < trackers.size())
+            {
+                PoseFusion::SourceStats stats[PoseFusion::kMaxSources];
+                int count = trackers[idx]->get_fusion_stats(stats, PoseFusion::kMaxSources);
+                s = s + " fusionstats " + std::to_string(idx) + " " + std::to_string(fusion_window * 1000) + " " + std::to_string(count);
+                for (int i = 0; i < count; i++)
+                    s = s + " " + std::to_string(stats[i].id) + " " + std::to_string(stats[i].rms * 1000) + " " + std::to_string(stats[i].accepted) + " " + std::to_string(stats[i].rejected);
+            }
+            else
+            {
+                s = s + " idinvalid";
+            }
+        }
+        else if (word == "settings")
+        {
+            int msaved;
+            double mtime;
+            double msmooth;
+            iss >> msaved;
+            iss >> mtime;
+            iss >> msmooth;
+
+            //optional: settings ... <filter> [<idx> [<param1> <param2>]], idx -1 means every tracker
+            PoseFilterType filter = tracker_filter;
+            std::string filter_name;
+            int idx = -1;
+            double param1 = 0;
+            double param2 = 0;
+            bool valid = true;
+            if (iss >> filter_name)
+            {
+                valid = ParsePoseFilterType(filter_name, filter);
+                int tracker_idx;
+                if (iss >> tracker_idx)
                 {
-                    int msaved;
-                    double mtime;
-                    double msmooth;
-                    iss >> msaved;
-                    iss >> mtime;
-                    iss >> msmooth;
-                    
-                    for (auto& device : this->trackers_)
-                        device->reinit(msaved,mtime,msmooth);
-
-                    tracker_max_saved = msaved;
-                    tracker_max_time = mtime;
-                    tracker_smoothing = msmooth;
-
-                    s = s + "  changed";
+                    idx = tracker_idx;
+                    iss >> param1 >> param2;
                 }
-                else
+            }
+
+            auto& trackers = this->trackers_.Get();
+            if (!valid)
+            {
+                s = s + "  unrecognized";
+            }
+            else if (idx >= (int)trackers.size())
+            {
+                s = s + " idinvalid";
+            }
+            else if (idx >= 0)
+            {
+                trackers[idx]->reinit(msaved, mtime, msmooth);
+                trackers[idx]->set_filter(filter, param1, param2);
+                s = s + "  changed";
+            }
+            else
+            {
+                for (auto& device : trackers)
                 {
-                    s = s + "  unrecognized";
+                    device->reinit(msaved, mtime, msmooth);
+                    device->set_filter(filter, param1, param2);
                 }
+
+                tracker_max_saved = msaved;
+                tracker_max_time = mtime;
+                tracker_smoothing = msmooth;
+                tracker_filter = filter;
+                tracker_filter_param1 = param1;
+                tracker_filter_param2 = param2;
+
+                s = s + "  changed";
             }
+        }
+        else
+        {
+            s = s + "  unrecognized";
+        }
+    }
+
+    s = s + "  OK\0";
+
+    return s;
+}
+
+size_t ExampleDriver::VRDriver::HandleBinaryMessage(const char* message, size_t length, char* reply, size_t reply_size, PipeSession& session)
+{
+    Protocol::Header header = Protocol::DecodeHeader(message, length);
 
-            s = s + "  OK\0";
+    Protocol::StatusReply status_reply{ Protocol::MakeHeader(Protocol::MessageType::StatusReply), Protocol::Status::Updated };
 
-            DWORD dwWritten;
-            WriteFile(inPipe,
-                s.c_str(),
-                (s.length() + 1),   // = length of string + terminating '\0' !!!
-                &dwWritten,
-                NULL);
+    if (header.version != Protocol::kVersion)
+    {
+        //handshake is answered regardless of version, so a client can find out which version to use. Its header may be
+        //shorter than ours, whatever follows magic, version and type belongs to its own layout and is not read.
+        if (header.type == Protocol::MessageType::Handshake)
+            return Protocol::EncodeBaseReply(Protocol::MessageType::HandshakeReply, Protocol::kVersion, reply, reply_size);
+        return Protocol::EncodeBaseReply(Protocol::MessageType::StatusReply, Protocol::Status::VersionMismatch, reply, reply_size);
+    }
+
+    if (header.type == Protocol::MessageType::Handshake)
+    {
+        Protocol::HandshakeReply handshake_reply{ Protocol::MakeHeader(Protocol::MessageType::HandshakeReply), Protocol::kVersion };
+        return Protocol::Encode(handshake_reply, reply, reply_size);
+    }
+
+    switch (header.type)
+    {
+    case Protocol::MessageType::UpdatePose:
+    case Protocol::MessageType::UpdatePoseAt:
+    {
+        Protocol::UpdatePoseMessage msg;
+        if (!Protocol::Decode(message, length, msg))
+            status_reply.status = Protocol::Status::Malformed;
+        else if (msg.idx >= this->trackers_.Get().size())
+            status_reply.status = Protocol::Status::IdInvalid;
+        else
+        {
+            double age = header.type == Protocol::MessageType::UpdatePoseAt ? SampleAge(msg.time) : std::abs(msg.time);
+            this->trackers_.Get()[msg.idx]->add_observation(msg.source, msg.position[0], msg.position[1], msg.position[2],
+                msg.rotation[0], msg.rotation[1], msg.rotation[2], msg.rotation[3], age);
+            WakePosePublisher();
         }
-        DisconnectNamedPipe(inPipe);
-        /*
+        break;
+    }
+    case Protocol::MessageType::ClockSync:
+    {
+        Protocol::ClockSyncMessage msg;
+        if (!Protocol::Decode(message, length, msg))
+        {
+            status_reply.status = Protocol::Status::Malformed;
+            break;
+        }
+
+        session.clock.AddExchange(msg.client_time, session.receive_time);
+
+        Protocol::ClockSyncReply sync_reply{ Protocol::MakeHeader(Protocol::MessageType::ClockSyncReply), msg.client_time, session.receive_time };
+        sync_reply.offset = session.clock.Offset(msg.client_time);
+        sync_reply.drift = session.clock.Drift();
+        sync_reply.reply_time = Clock::Now();
+        return Protocol::Encode(sync_reply, reply, reply_size);
+    }
+    case Protocol::MessageType::UpdateStation:
+    {
+        Protocol::UpdateStationMessage msg;
+        if (!Protocol::Decode(message, length, msg))
+            status_reply.status = Protocol::Status::Malformed;
+        else if (msg.idx >= this->stations_.Get().size())
+            status_reply.status = Protocol::Status::IdInvalid;
+        else
+            this->stations_.Get()[msg.idx]->UpdatePose(msg.position[0], msg.position[1], msg.position[2],
+                msg.rotation[0], msg.rotation[1], msg.rotation[2], msg.rotation[3]);
+        break;
+    }
+    case Protocol::MessageType::GetTrackerPose:
+    {
+        Protocol::GetTrackerPoseMessage msg;
+        if (!Protocol::Decode(message, length, msg))
+        {
+            status_reply.status = Protocol::Status::Malformed;
+            break;
         }
+
+        Protocol::TrackerPoseReply pose_reply{ Protocol::MakeHeader(Protocol::MessageType::TrackerPoseReply), Protocol::Status::Updated, msg.idx };
+        if (msg.idx >= this->trackers_.Get().size())
+            pose_reply.status = Protocol::Status::IdInvalid;
         else
+            pose_reply.prediction_status = this->trackers_.Get()[msg.idx]->get_next_pose(msg.time_offset, pose_reply.pose);
+
+        return Protocol::Encode(pose_reply, reply, reply_size);
+    }
+    case Protocol::MessageType::UpdatePoseBatch:
+    {
+        Protocol::UpdatePoseBatchMessage msg;
+        if (!Protocol::DecodeBatch(message, length, msg))
         {
-            Sleep(1);
+            status_reply.status = Protocol::Status::Malformed;
+            break;
         }
-        */
+
+        Protocol::BatchStatusReply batch_reply{ Protocol::MakeHeader(Protocol::MessageType::BatchStatusReply), msg.count };
+        ApplyPoseBatch(msg.samples, msg.count, batch_reply.status);
+
+        return Protocol::Encode(batch_reply, reply, reply_size, Protocol::BatchReplySize(msg.count));
     }
+    case Protocol::MessageType::HipMoveInput:
+    {
+        Protocol::HipMoveInputMessage msg;
+        if (!Protocol::Decode(message, length, msg))
+            status_reply.status = Protocol::Status::Malformed;
+        else if (fakemove_ == nullptr)
+            status_reply.status = Protocol::Status::NotSpawned;
+        else
+            fakemove_->SetDirection(msg.x, msg.y, msg.rx, msg.ry, msg.a, msg.b);
+        break;
+    }
+    default:
+        status_reply.status = Protocol::Status::Unrecognized;
+        break;
+    }
+
+    return Protocol::Encode(status_reply, reply, reply_size);
+}
+
+void ExampleDriver::VRDriver::ApplyPoseBatch(const Protocol::PoseSample* samples, uint32_t count, uint8_t* status)
+{
+    //RunFrame sees the whole batch or none of it: the samples are staged per tracker and published together after the
+    //loop, and RunFrame does not fetch histories while batch_mutex_ is held
+    auto& trackers = this->trackers_.Get();
+    {
+        std::lock_guard<std::mutex> batch_lock(this->batch_mutex_);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const Protocol::PoseSample& sample = samples[i];
+            if (sample.idx >= trackers.size())
+            {
+                status[i] = (uint8_t)Protocol::Status::IdInvalid;
+                continue;
+            }
+
+            int saved = trackers[sample.idx]->stage_observation(sample.source, sample.position[0], sample.position[1], sample.position[2],
+                sample.rotation[0], sample.rotation[1], sample.rotation[2], sample.rotation[3], std::abs(sample.time));
+
+            status[i] = (uint8_t)(saved == 0 ? Protocol::Status::Updated : Protocol::Status::Dropped);
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (samples[i].idx < trackers.size())
+                trackers[samples[i].idx]->publish_staged();
+        }
+    }
+    WakePosePublisher();
 }
 
 void ExampleDriver::VRDriver::RunFrame()
 {
     //MessageBox(NULL,"hi", "Example Driver", MB_OK);
-    // Collect events
-    vr::VREvent_t event;
-    std::vector<vr::VREvent_t> events;
-    while (vr::VRServerDriverHost()->PollNextEvent(&event, sizeof(event)))
+    // Collect events, a burst that fills openvr_events_ is handed out a chunk at a time as it is polled
+    this->openvr_event_count_ = 0;
+    while (vr::VRServerDriverHost()->PollNextEvent(&this->openvr_events_[this->openvr_event_count_], sizeof(vr::VREvent_t)))
     {
-        events.push_back(event);
+        if (++this->openvr_event_count_ == this->openvr_events_.size())
+        {
+            this->event_dispatcher_.Dispatch(GetOpenVREvents());
+            this->openvr_event_count_ = 0;
+        }
     }
-    this->openvr_events_ = events;
 
     // Update frame timing
-    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-    this->frame_timing_ = std::chrono::duration_cast<std::chrono::milliseconds>(now - this->last_frame_time_);
+    Clock::Source::time_point now = Clock::Source::now();
+    this->frame_timing_ = now - this->last_frame_time_.load();
     this->last_frame_time_ = now;
 
-    this->frame_timing_avg_ = this->frame_timing_avg_ * 0.9 + ((double)this->frame_timing_.count()) * 0.1;
+    this->frame_timing_avg_ = this->frame_timing_avg_ * 0.9 + std::chrono::duration<double, std::milli>(this->frame_timing_).count() * 0.1;
+    Telemetry::Get().frame_interval.Record(this->frame_timing_.count());
+
+    if (this->stats_log_interval_ > 0 && now - this->last_stats_log_ >= std::chrono::seconds(this->stats_log_interval_))
+    {
+        LogStats();
+        this->last_stats_log_ = now;
+    }
     //MessageBox(NULL, std::to_string(((double)this->frame_timing_.count()) * 0.1).c_str(), "Example Driver", MB_OK);
 
-    for (auto& device : this->trackers_)
-        device->Update();
+    //hand every event left to its device once, then let the trackers act on what they received
+    this->event_dispatcher_.Dispatch(GetOpenVREvents());
+    for (auto& device : this->trackers_.Get())
+        device->handle_events();
+
+    uint64_t subscribed = this->subscribed_devices_.load(std::memory_order_relaxed);
+    if (subscribed != 0)
+        PublishDevicePoses(subscribed);
+
+    //with the pose publisher running, it drains and posts the trackers instead
+    if (this->publisher_rate_ > 0)
+        return;
+
+    FlushObservations(this->frame_timing_avg_ / 1000);
+    DrainSharedPoses();
+    PublishTrackerPoses(this->pose_batch_);
+}
+
+void ExampleDriver::VRDriver::PublishTrackerPoses(PoseBatch& batch)
+{
+    //fit every tracker in one vectorized pass, then post the poses
+    auto& trackers = this->trackers_.Get();
+
+    //pick up the histories the pipe side published, unless a batch is half way through being stored
+    {
+        std::unique_lock<std::mutex> batch_lock(this->batch_mutex_, std::try_to_lock);
+        if (batch_lock.owns_lock())
+        {
+            for (auto& tracker : trackers)
+                tracker->fetch_history();
+        }
+    }
+
+    batch.Resize(trackers.size());
+    for (size_t i = 0; i < trackers.size(); i++)
+        trackers[i]->load_prediction(batch, i);
+    batch.Predict();
+    for (size_t i = 0; i < trackers.size(); i++)
+    {
+        int64_t start = Clock::NowNanoseconds();
+        trackers[i]->apply_prediction(batch, i);
+        Telemetry::Get().tracker_update.Record(Clock::NowNanoseconds() - start);
+    }
+}
+
+void ExampleDriver::VRDriver::LogStats()
+{
+    //only what happened since the last dump, so a stutter stands out instead of drowning in the whole session
+    Histogram::Snapshot snapshot;
+    Telemetry& telemetry = Telemetry::Get();
+    for (int i = 0; i < Telemetry::kHistograms; i++)
+    {
+        telemetry.At(i).Read(snapshot);
+        Log("stats " + Telemetry::Format(Telemetry::Name(i), snapshot - this->logged_stats_[i]));
+        this->logged_stats_[i] = snapshot;
+    }
+}
+
+void ExampleDriver::VRDriver::StopPosePublisher()
+{
+    //SteamVR deactivates devices and cleans up on the same thread, only one of them gets to join
+    if (!this->publisher_thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(this->publisher_wake_mutex_);
+        this->publisher_running_ = false;
+    }
+    this->publisher_wake_.notify_one();
+    this->publisher_thread_.join();
+}
 
+void ExampleDriver::VRDriver::WakePosePublisher()
+{
+    if (this->publisher_rate_ <= 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(this->publisher_wake_mutex_);
+        this->publisher_pending_ = true;
+    }
+    this->publisher_wake_.notify_one();
+}
+
+void ExampleDriver::VRDriver::PosePublisherThread()
+{
+    using clock = std::chrono::steady_clock;
+    const clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / this->publisher_rate_));
+
+#ifdef _WIN32
+    timeBeginPeriod(1);
+#endif
+
+    //ticks sit on a fixed grid from the start time, so the rate does not drift with how long each pass takes
+    clock::time_point next_tick = clock::now() + period;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->publisher_wake_mutex_);
+            //sleep until the next tick, or until a pipe client stores a new sample
+            this->publisher_wake_.wait_until(lock, next_tick, [this] { return this->publisher_pending_ || !this->publisher_running_; });
+            if (!this->publisher_running_)
+                break;
+            this->publisher_pending_ = false;
+        }
+
+        //an early wake by a new sample keeps the grid, a pass that overran a whole period skips the missed ticks instead of bursting
+        clock::time_point now = clock::now();
+        if (now >= next_tick)
+        {
+            next_tick += period;
+            if (next_tick <= now)
+                next_tick = now + period;
+        }
+
+        FlushObservations(std::chrono::duration<double>(next_tick - now).count());
+        DrainSharedPoses();
+        PublishTrackerPoses(this->publisher_batch_);
+    }
+
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+void ExampleDriver::VRDriver::FlushObservations(double lead)
+{
+    //fuse the slots whose missing cameras will not report in time, lead is how long until the next flush
+    for (auto& device : this->trackers_.Get())
+        device->flush_observations(lead);
+}
+
+void ExampleDriver::VRDriver::DrainSharedPoses()
+{
+    SharedMemory::Region* region = this->shared_poses_.Get();
+    if (region == nullptr)
+        return;
+
+    double now = SharedMemory::Now();
+    auto& trackers = this->trackers_.Get();
+    size_t count = std::min<size_t>(trackers.size(), SharedMemory::kMaxTrackers);
+    for (size_t i = 0; i < count; i++)
+        trackers[i]->drain_samples(region->rings[i], now);
+}
+
+void ExampleDriver::VRDriver::SubscribeDevices(PipeSession& session, uint64_t devices)
+{
+    //called with command_mutex_ held
+    uint64_t subscribed = 0;
+    for (uint32_t i = 0; i < SharedMemory::kMaxDevices; i++)
+    {
+        uint64_t bit = uint64_t(1) << i;
+        this->device_subscribers_[i] += ((devices & bit) != 0) - ((session.subscribed_devices & bit) != 0);
+        if (this->device_subscribers_[i] > 0)
+            subscribed |= bit;
+    }
+    session.subscribed_devices = devices;
+    this->subscribed_devices_ = subscribed;
+}
+
+void ExampleDriver::VRDriver::PublishDevicePoses(uint64_t devices)
+{
+    SharedMemory::Region* region = this->shared_poses_.Get();
+    if (region == nullptr)
+        return;
+
+    //one call for every device, it is a copy of SteamVR's current poses
+    vr::VRServerDriverHost()->GetRawTrackedDevicePoses(0, this->device_poses_, SharedMemory::kMaxDevices);
+
+    double now = SharedMemory::Now();
+    for (uint32_t i = 0; i < SharedMemory::kMaxDevices; i++)
+    {
+        if ((devices & (uint64_t(1) << i)) == 0)
+            continue;
+
+        const vr::TrackedDevicePose_t& device_pose = this->device_poses_[i];
+        vr::HmdQuaternion_t q = GetRotation(device_pose.mDeviceToAbsoluteTracking);
+        vr::HmdVector3_t pos = GetPosition(device_pose.mDeviceToAbsoluteTracking);
+
+        SharedMemory::DevicePose pose;
+        pose.position[0] = pos.v[0]; pose.position[1] = pos.v[1]; pose.position[2] = pos.v[2];
+        pose.rotation[0] = q.w; pose.rotation[1] = q.x; pose.rotation[2] = q.y; pose.rotation[3] = q.z;
+        for (int j = 0; j < 3; j++)
+            pose.velocity[j] = device_pose.vVelocity.v[j];
+        pose.time = now;
+        pose.valid = device_pose.bPoseIsValid && device_pose.bDeviceIsConnected;
+        SharedMemory::Publish(region->devices[i], pose);
+    }
+    region->device_frame.fetch_add(1, std::memory_order_release);
 }
 
 bool ExampleDriver::VRDriver::ShouldBlockStandbyMode()
@@ -356,17 +1108,22 @@ void ExampleDriver::VRDriver::LeaveStandby()
 {
 }
 
-std::vector<std::shared_ptr<ExampleDriver::IVRDevice>> ExampleDriver::VRDriver::GetDevices()
+const std::vector<std::shared_ptr<ExampleDriver::IVRDevice>>& ExampleDriver::VRDriver::GetDevices()
 {
-    return this->devices_;
+    return this->devices_.Get();
 }
 
-std::vector<vr::VREvent_t> ExampleDriver::VRDriver::GetOpenVREvents()
+ExampleDriver::Span<const vr::VREvent_t> ExampleDriver::VRDriver::GetOpenVREvents()
 {
-    return this->openvr_events_;
+    return { this->openvr_events_.data(), this->openvr_event_count_ };
 }
 
-std::chrono::milliseconds ExampleDriver::VRDriver::GetLastFrameTime()
+void ExampleDriver::VRDriver::SubscribeEvent(vr::EVREventType type, uint64_t target, IVRDevice* device)
+{
+    this->event_dispatcher_.Subscribe(type, target, device);
+}
+
+std::chrono::nanoseconds ExampleDriver::VRDriver::GetLastFrameTime()
 {
     return this->frame_timing_;
 }
@@ -393,7 +1150,7 @@ bool ExampleDriver::VRDriver::AddDevice(std::shared_ptr<IVRDevice> device)
     }
     bool result = vr::VRServerDriverHost()->TrackedDeviceAdded(device->GetSerial().c_str(), openvr_device_class, device.get());
     if(result)
-        this->devices_.push_back(device);
+        this->devices_.Add(device);
     return result;
 }
 
@@ -414,11 +1171,10 @@ ExampleDriver::SettingsValue ExampleDriver::VRDriver::GetSettingsValue(std::stri
     if (err == vr::EVRSettingsError::VRSettingsError_None) {
         return bool_value;
     }
-    std::string str_value;
-    str_value.reserve(1024);
-    vr::VRSettings()->GetString(settings_key_.c_str(), key.c_str(), str_value.data(), 1024, &err);
+    char str_value[1024];
+    vr::VRSettings()->GetString(settings_key_.c_str(), key.c_str(), str_value, sizeof(str_value), &err);
     if (err == vr::EVRSettingsError::VRSettingsError_None) {
-        return str_value;
+        return std::string(str_value);
     }
     err = vr::EVRSettingsError::VRSettingsError_None;
 
@@ -427,8 +1183,7 @@ ExampleDriver::SettingsValue ExampleDriver::VRDriver::GetSettingsValue(std::stri
 
 void ExampleDriver::VRDriver::Log(std::string message)
 {
-    std::string message_endl = message + "\n";
-    vr::VRDriverLog()->Log(message_endl.c_str());
+    DriverLog::Get().Write(message);
 }
 
 vr::IVRDriverInput* ExampleDriver::VRDriver::GetInput()
@@ -446,6 +1201,12 @@ vr::IVRServerDriverHost* ExampleDriver::VRDriver::GetDriverHost()
     return vr::VRServerDriverHost();
 }
 
+void ExampleDriver::VRDriver::PostPose(uint32_t device_index, const vr::DriverPose_t& pose)
+{
+    vr::VRServerDriverHost()->TrackedDevicePoseUpdated(device_index, pose, sizeof(vr::DriverPose_t));
+    this->recorder_.RecordPose(device_index, pose, Clock::Now());
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Calculates quaternion (qw,qx,qy,qz) representing the rotation
 // from: https://github.com/Omnifinity/OpenVR-Tracking-Example/blob/master/HTC%20Lighthouse%20Tracking%20Example/LighthouseTracking.cpp
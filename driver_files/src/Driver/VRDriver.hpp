@@ -1,9 +1,14 @@
 #pragma once
-#define NOMINMAX
 
 #include <vector>
+#include <array>
 #include <memory>
-#include <windows.h>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <deque>
 
 #include <openvr_driver.h>
 
@@ -12,6 +17,17 @@
 #include <Driver/TrackerDevice.hpp>
 #include <Driver/ControllerDevice.hpp>
 #include <Driver/TrackingReferenceDevice.hpp>
+#include <Driver/Protocol.hpp>
+#include <Driver/Transport.hpp>
+#include <Driver/SharedMemory.hpp>
+#include <Driver/DeviceList.hpp>
+#include <Driver/PoseBatch.hpp>
+#include <Driver/Clock.hpp>
+#include <Driver/ClockSync.hpp>
+#include <Driver/Telemetry.hpp>
+#include <Driver/EventDispatcher.hpp>
+#include <Driver/Recording.hpp>
+#include <Driver/DriverLog.hpp>
 
 
 namespace ExampleDriver {
@@ -19,9 +35,10 @@ namespace ExampleDriver {
     public:
 
         // Inherited via IVRDriver
-        virtual std::vector<std::shared_ptr<IVRDevice>> GetDevices() override;
-        virtual std::vector<vr::VREvent_t> GetOpenVREvents() override;
-        virtual std::chrono::milliseconds GetLastFrameTime() override;
+        virtual const std::vector<std::shared_ptr<IVRDevice>>& GetDevices() override;
+        virtual Span<const vr::VREvent_t> GetOpenVREvents() override;
+        virtual void SubscribeEvent(vr::EVREventType type, uint64_t target, IVRDevice* device) override;
+        virtual std::chrono::nanoseconds GetLastFrameTime() override;
         virtual bool AddDevice(std::shared_ptr<IVRDevice> device) override;
         virtual SettingsValue GetSettingsValue(std::string key) override;
         virtual void Log(std::string message) override;
@@ -29,6 +46,8 @@ namespace ExampleDriver {
         virtual vr::IVRDriverInput* GetInput() override;
         virtual vr::CVRPropertyHelpers* GetProperties() override;
         virtual vr::IVRServerDriverHost* GetDriverHost() override;
+        virtual void PostPose(uint32_t device_index, const vr::DriverPose_t& pose) override;
+        virtual void StopPosePublisher() override;
 
         // Inherited via IServerTrackedDeviceProvider
         virtual vr::EVRInitError Init(vr::IVRDriverContext* pDriverContext) override;
@@ -39,22 +58,93 @@ namespace ExampleDriver {
         virtual void LeaveStandby() override;
         virtual ~VRDriver() = default;
 
+        // Rotation and position of an OpenVR device to absolute tracking matrix
+        static vr::HmdQuaternion_t GetRotation(vr::HmdMatrix34_t matrix);
+        static vr::HmdVector3_t GetPosition(vr::HmdMatrix34_t matrix);
+
     private:
-        HANDLE inPipe;
-        HANDLE syncPipe;
+        std::string pipe_name_ = "ApriltagPipeIn";
+        std::mutex command_mutex_;
+        std::string shared_memory_name_ = "ApriltagPoseMemory";
+        SharedMemory::Mapping shared_poses_;
         std::shared_ptr<ControllerDevice> fakemove_;
-        std::vector<std::shared_ptr<IVRDevice>> devices_;
-        std::vector<std::shared_ptr<TrackerDevice>> trackers_;
-        std::vector<std::shared_ptr<TrackingReferenceDevice>> stations_;
-        std::vector<vr::VREvent_t> openvr_events_;
-        std::chrono::milliseconds frame_timing_ = std::chrono::milliseconds(16);
-        double frame_timing_avg_ = 16;
-        std::chrono::system_clock::time_point last_frame_time_ = std::chrono::system_clock::now();
+        // Appended to by pipe clients under command_mutex_, read by RunFrame without locking
+        DeviceList<IVRDevice> devices_;
+        DeviceList<TrackerDevice> trackers_;
+        DeviceList<TrackingReferenceDevice> stations_;
+        PoseBatch pose_batch_;            // only touched by RunFrame
+        // Held while a batch of samples is stored and published, RunFrame does not pick up tracker histories meanwhile.
+        // It only ever tries the lock, while a batch is on its way the trackers keep their last histories for a frame.
+        std::mutex batch_mutex_;
+
+        // Optional pose publisher thread, set up once in Init. It shares no lock with RunFrame,
+        // the wake mutex is only taken by it and by pipe clients that just stored a sample.
+        int publisher_rate_ = 0;          // Hz, 0 posts poses from RunFrame
+        std::thread publisher_thread_;
+        std::atomic<bool> publisher_running_{ false };
+        std::mutex publisher_wake_mutex_;
+        std::condition_variable publisher_wake_;
+        bool publisher_pending_ = false;
+        PoseBatch publisher_batch_;
+        // refilled every frame, a burst that fills it is dispatched as it is polled so polling never allocates
+        std::array<vr::VREvent_t, 64> openvr_events_;
+        size_t openvr_event_count_ = 0;
+        EventDispatcher event_dispatcher_;
+        std::chrono::nanoseconds frame_timing_ = std::chrono::milliseconds(16);
+        // written by RunFrame, read by pipe clients for synctime
+        std::atomic<double> frame_timing_avg_{ 16 };      // ms
+        std::atomic<Clock::Source::time_point> last_frame_time_{ Clock::Source::now() };
         std::string settings_key_ = "driver_apriltag";
 
-        vr::HmdQuaternion_t GetRotation(vr::HmdMatrix34_t matrix);
-        vr::HmdVector3_t GetPosition(vr::HmdMatrix34_t matrix);
+        // Periodic dump of the telemetry histograms to the log, set up once in Init and then only touched by RunFrame
+        int stats_log_interval_ = 0;      // seconds, 0 never logs
+        Clock::Source::time_point last_stats_log_;
+        Histogram::Snapshot logged_stats_[Telemetry::kHistograms];
+
+        // Session recording of received messages and posted poses, started by the record command or the record_path setting
+        Recording::Writer recorder_;
+        std::atomic<uint16_t> next_connection_id_{ 0 };
+
+        // Accepted connections are served by a pool of client threads. Threads are started when every one there is
+        // is busy and go back to waiting once their client disconnects, so clients that connect for every message
+        // (CallNamedPipe) do not cost a thread each. Beyond kMaxPipeClients a connection waits for a client to leave.
+        static constexpr int kMaxPipeClients = 16;
+        std::mutex pipe_clients_mutex_;
+        std::condition_variable pipe_clients_wake_;
+        std::deque<std::unique_ptr<IConnection>> pending_connections_;
+        int pipe_client_threads_ = 0;
+        int idle_pipe_client_threads_ = 0;
+
+        // Device poses published to shared memory every frame, for the devices any client subscribed to.
+        // The subscriber counts are kept under command_mutex_, RunFrame only reads the mask.
+        int device_subscribers_[SharedMemory::kMaxDevices] = {};
+        std::atomic<uint64_t> subscribed_devices_{ 0 };
+        vr::TrackedDevicePose_t device_poses_[SharedMemory::kMaxDevices];     // only touched by RunFrame
+
+        // State of one pipe connection, owned by its PipeClientThread
+        struct PipeSession {
+            ClockSync clock;
+            uint16_t id = 0;              // tells connections apart in recordings
+            double receive_time = 0;      // session time the message being handled arrived
+            uint64_t subscribed_devices = 0;
+        };
+
         void PipeThread();
+        void PipeClientThread();
+        void ServeConnection(IConnection& connection);
+        // Returns the length of the reply, 0 if the message gets none
+        size_t HandleMessage(char* message, size_t length, char* reply, size_t reply_size, PipeSession& session);
+        std::string HandleTextMessage(const char* message, PipeSession& session);
+        size_t HandleBinaryMessage(const char* message, size_t length, char* reply, size_t reply_size, PipeSession& session);
+        void DrainSharedPoses();
+        void SubscribeDevices(PipeSession& session, uint64_t devices);
+        void PublishDevicePoses(uint64_t devices);
+        void PublishTrackerPoses(PoseBatch& batch);
+        void WakePosePublisher();
+        void PosePublisherThread();
+        void ApplyPoseBatch(const Protocol::PoseSample* samples, uint32_t count, uint8_t* status);
+        void FlushObservations(double lead);
+        void LogStats();
 
         int pipeNum = 1;
         double smoothFactor = 0.2;
@@ -62,5 +152,9 @@ namespace ExampleDriver {
         int tracker_max_saved = 10;
         double tracker_max_time = 1;
         double tracker_smoothing = 0;
+        PoseFilterType tracker_filter = PoseFilterType::Regression;
+        double tracker_filter_param1 = 0;
+        double tracker_filter_param2 = 0;
+        double fusion_window = 0;
     };
 };
\ No newline at end of file
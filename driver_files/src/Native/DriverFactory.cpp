@@ -1,7 +1,6 @@
 #include "DriverFactory.hpp"
 #include <thread>
 #include <Driver/VRDriver.hpp>
-#include <Windows.h>
 #include <sstream>
 
 static std::shared_ptr<ExampleDriver::IVRDriver> driver;
@@ -22,6 +21,7 @@ void* HmdDriverFactory(const char* interface_name, int* return_code) {
 	return nullptr;
 }
 
-std::shared_ptr<ExampleDriver::IVRDriver> ExampleDriver::GetDriver() {
-	return driver;
+// A raw pointer, so the many calls on every frame do not bump the reference count
+ExampleDriver::IVRDriver* ExampleDriver::GetDriver() {
+	return driver.get();
 }
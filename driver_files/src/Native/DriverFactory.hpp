@@ -7,8 +7,14 @@
 
 #include <Driver/IVRDriver.hpp>
 
-extern "C" __declspec(dllexport) void* HmdDriverFactory(const char* interface_name, int* return_code);
+#if defined(_WIN32)
+#define HMD_DLL_EXPORT extern "C" __declspec(dllexport)
+#else
+#define HMD_DLL_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+HMD_DLL_EXPORT void* HmdDriverFactory(const char* interface_name, int* return_code);
 
 namespace ExampleDriver {
-    std::shared_ptr<ExampleDriver::IVRDriver> GetDriver();
+    ExampleDriver::IVRDriver* GetDriver();
 }
\ No newline at end of file
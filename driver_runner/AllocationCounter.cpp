@@ -0,0 +1,41 @@
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    thread_local bool g_counting = false;
+    std::atomic<uint64_t> g_total{ 0 };
+}
+
+void DriverRunner::AllocationCounter::Count(bool on)
+{
+    g_counting = on;
+}
+
+uint64_t DriverRunner::AllocationCounter::Total()
+{
+    return g_total.load(std::memory_order_relaxed);
+}
+
+// The array and nothrow forms call this one
+void* operator new(std::size_t size)
+{
+    if (g_counting)
+        g_total.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
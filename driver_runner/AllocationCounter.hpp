@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+namespace DriverRunner {
+
+    /// <summary>
+    /// Counts heap allocations through the global operator new, which AllocationCounter.cpp replaces for the whole
+    /// program it is linked into. Only allocations made by a thread while it has counting switched on are counted.
+    /// Kept in a source file of its own so the compiler never sees the replacement next to the code calling it.
+    /// </summary>
+    namespace AllocationCounter {
+
+        /// <summary>
+        /// Switches counting on or off for the calling thread
+        /// </summary>
+        void Count(bool on);
+
+        /// <summary>
+        /// Allocations counted so far, by every thread
+        /// </summary>
+        uint64_t Total();
+    }
+}
@@ -0,0 +1,424 @@
+#include "MockHost.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <Driver/Recording.hpp>
+
+void DriverRunner::MockServerDriverHost::QueueEvent(const vr::VREvent_t& event)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->events_.push_back(event);
+}
+
+size_t DriverRunner::MockServerDriverHost::QueuedEvents() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->events_.size();
+}
+
+std::vector<DriverRunner::DeviceRecord> DriverRunner::MockServerDriverHost::GetDevices() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->devices_;
+}
+
+bool DriverRunner::MockServerDriverHost::TrackedDeviceAdded(const char* pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver* pDriver)
+{
+    uint32_t index;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        DeviceRecord record;
+        record.serial = pchDeviceSerialNumber;
+        record.device_class = eDeviceClass;
+        record.driver = pDriver;
+        record.active = !this->deferred_activation;
+        this->devices_.push_back(record);
+        index = (uint32_t)this->devices_.size();
+    }
+    if (this->deferred_activation)
+        return true;
+
+    // SteamVR activates devices right away as well, and Activate may post poses, so it runs outside the lock
+    return pDriver->Activate(index) == vr::VRInitError_None;
+}
+
+int DriverRunner::MockServerDriverHost::ActivatePending()
+{
+    std::vector<std::pair<uint32_t, vr::ITrackedDeviceServerDriver*>> pending;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        for (size_t i = 0; i < this->devices_.size(); i++) {
+            if (!this->devices_[i].active) {
+                this->devices_[i].active = true;
+                pending.emplace_back(uint32_t(i + 1), this->devices_[i].driver);
+            }
+        }
+    }
+
+    for (auto& device : pending)
+        device.second->Activate(device.first);
+    return int(pending.size());
+}
+
+void DriverRunner::MockServerDriverHost::DeactivateAll()
+{
+    std::vector<vr::ITrackedDeviceServerDriver*> active;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        for (DeviceRecord& record : this->devices_) {
+            if (record.active)
+                active.push_back(record.driver);
+            record.active = false;
+        }
+    }
+
+    for (vr::ITrackedDeviceServerDriver* driver : active)
+        driver->Deactivate();
+}
+
+void DriverRunner::MockServerDriverHost::TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t& newPose, uint32_t unPoseStructSize)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        if (unWhichDevice == 0 || unWhichDevice > this->devices_.size())
+            return;
+        auto& record = this->devices_[unWhichDevice - 1];
+        record.pose_updates++;
+        record.last_pose = newPose;
+    }
+
+    if (this->on_pose)
+        this->on_pose(unWhichDevice, newPose);
+}
+
+bool DriverRunner::MockServerDriverHost::PollNextEvent(vr::VREvent_t* pEvent, uint32_t uncbVREvent)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (this->events_.empty())
+        return false;
+    *pEvent = this->events_.front();
+    this->events_.pop_front();
+    return true;
+}
+
+void DriverRunner::MockServerDriverHost::GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount)
+{
+    // There is no HMD or other driver, only the driver's own devices are tracked, at the pose they posted last
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (uint32_t i = 0; i < unTrackedDevicePoseArrayCount; i++) {
+        pTrackedDevicePoseArray[i] = {};
+        if (i == 0 || i > this->devices_.size())
+            continue;
+
+        const DeviceRecord& record = this->devices_[i - 1];
+        ExampleDriver::Recording::PoseRecord pose = ExampleDriver::Recording::MakePoseRecord(record.last_pose);
+        double w = pose.rotation[0], x = pose.rotation[1], y = pose.rotation[2], z = pose.rotation[3];
+        float (&m)[3][4] = pTrackedDevicePoseArray[i].mDeviceToAbsoluteTracking.m;
+        m[0][0] = (float)(1 - 2 * (y * y + z * z)); m[0][1] = (float)(2 * (x * y - w * z)); m[0][2] = (float)(2 * (x * z + w * y));
+        m[1][0] = (float)(2 * (x * y + w * z)); m[1][1] = (float)(1 - 2 * (x * x + z * z)); m[1][2] = (float)(2 * (y * z - w * x));
+        m[2][0] = (float)(2 * (x * z - w * y)); m[2][1] = (float)(2 * (y * z + w * x)); m[2][2] = (float)(1 - 2 * (x * x + y * y));
+        for (int j = 0; j < 3; j++) {
+            m[j][3] = (float)pose.position[j];
+            pTrackedDevicePoseArray[i].vVelocity.v[j] = (float)pose.velocity[j];
+        }
+        pTrackedDevicePoseArray[i].eTrackingResult = record.last_pose.result;
+        pTrackedDevicePoseArray[i].bPoseIsValid = record.last_pose.poseIsValid;
+        pTrackedDevicePoseArray[i].bDeviceIsConnected = record.last_pose.deviceIsConnected;
+    }
+}
+
+bool DriverRunner::MockProperties::Get(vr::PropertyContainerHandle_t container, vr::ETrackedDeviceProperty prop, Property& out) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto it = this->properties_.find({ container, prop });
+    if (it == this->properties_.end())
+        return false;
+    out = it->second;
+    return true;
+}
+
+vr::ETrackedPropertyError DriverRunner::MockProperties::ReadPropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyRead_t* pBatch, uint32_t unBatchEntryCount)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (uint32_t i = 0; i < unBatchEntryCount; i++) {
+        auto& read = pBatch[i];
+        auto it = this->properties_.find({ ulContainerHandle, read.prop });
+        if (it == this->properties_.end()) {
+            read.unTag = vr::k_unInvalidPropertyTag;
+            read.unRequiredBufferSize = 0;
+            read.eError = vr::TrackedProp_UnknownProperty;
+            continue;
+        }
+        read.unTag = it->second.tag;
+        read.unRequiredBufferSize = (uint32_t)it->second.value.size();
+        if (read.unBufferSize < read.unRequiredBufferSize) {
+            read.eError = vr::TrackedProp_BufferTooSmall;
+            continue;
+        }
+        if (!it->second.value.empty())
+            std::memcpy(read.pvBuffer, it->second.value.data(), it->second.value.size());
+        read.eError = vr::TrackedProp_Success;
+    }
+    return vr::TrackedProp_Success;
+}
+
+vr::ETrackedPropertyError DriverRunner::MockProperties::WritePropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyWrite_t* pBatch, uint32_t unBatchEntryCount)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (uint32_t i = 0; i < unBatchEntryCount; i++) {
+        auto& write = pBatch[i];
+        std::pair<vr::PropertyContainerHandle_t, vr::ETrackedDeviceProperty> key{ ulContainerHandle, write.prop };
+        if (write.writeType == vr::PropertyWrite_Set) {
+            auto& property = this->properties_[key];
+            property.tag = write.unTag;
+            auto bytes = static_cast<const char*>(write.pvBuffer);
+            property.value.assign(bytes, bytes + write.unBufferSize);
+        }
+        else if (write.writeType == vr::PropertyWrite_Erase) {
+            this->properties_.erase(key);
+        }
+        write.eError = vr::TrackedProp_Success;
+    }
+    return vr::TrackedProp_Success;
+}
+
+const char* DriverRunner::MockProperties::GetPropErrorNameFromEnum(vr::ETrackedPropertyError error)
+{
+    switch (error) {
+    case vr::TrackedProp_Success: return "TrackedProp_Success";
+    case vr::TrackedProp_UnknownProperty: return "TrackedProp_UnknownProperty";
+    case vr::TrackedProp_BufferTooSmall: return "TrackedProp_BufferTooSmall";
+    default: return "TrackedProp_Error";
+    }
+}
+
+vr::PropertyContainerHandle_t DriverRunner::MockProperties::TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice)
+{
+    // 0 is vr::k_ulInvalidPropertyContainer
+    return (vr::PropertyContainerHandle_t)nDevice + 1;
+}
+
+bool DriverRunner::MockSettings::Set(const std::string& assignment)
+{
+    auto equals = assignment.find('=');
+    if (equals == std::string::npos)
+        return false;
+
+    std::string section = "driver_apriltag";
+    std::string key = assignment.substr(0, equals);
+    std::string text = assignment.substr(equals + 1);
+    auto slash = key.find('/');
+    if (slash != std::string::npos) {
+        section = key.substr(0, slash);
+        key = key.substr(slash + 1);
+    }
+
+    Value value = text;
+    char* end = nullptr;
+    if (text == "true" || text == "false") {
+        value = text == "true";
+    }
+    else if (!text.empty()) {
+        long integer = std::strtol(text.c_str(), &end, 10);
+        if (*end == 0) {
+            value = (int32_t)integer;
+        }
+        else {
+            float number = std::strtof(text.c_str(), &end);
+            if (*end == 0)
+                value = number;
+        }
+    }
+
+    this->Store(section.c_str(), key.c_str(), value, nullptr);
+    return true;
+}
+
+const char* DriverRunner::MockSettings::GetSettingsErrorNameFromEnum(vr::EVRSettingsError eError)
+{
+    switch (eError) {
+    case vr::VRSettingsError_None: return "VRSettingsError_None";
+    case vr::VRSettingsError_ReadFailed: return "VRSettingsError_ReadFailed";
+    case vr::VRSettingsError_UnsetSettingHasNoDefault: return "VRSettingsError_UnsetSettingHasNoDefault";
+    default: return "VRSettingsError_Error";
+    }
+}
+
+void DriverRunner::MockSettings::Store(const char* section, const char* key, Value value, vr::EVRSettingsError* error)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->values_[{ section, key }] = std::move(value);
+    if (error)
+        *error = vr::VRSettingsError_None;
+}
+
+template<typename T>
+const T* DriverRunner::MockSettings::Find(const char* section, const char* key, vr::EVRSettingsError* error) const
+{
+    auto it = this->values_.find({ section, key });
+    const T* value = it == this->values_.end() ? nullptr : std::get_if<T>(&it->second);
+    if (error)
+        *error = value ? vr::VRSettingsError_None : it == this->values_.end() ? vr::VRSettingsError_UnsetSettingHasNoDefault : vr::VRSettingsError_ReadFailed;
+    return value;
+}
+
+void DriverRunner::MockSettings::SetBool(const char* pchSection, const char* pchSettingsKey, bool bValue, vr::EVRSettingsError* peError)
+{
+    this->Store(pchSection, pchSettingsKey, bValue, peError);
+}
+
+void DriverRunner::MockSettings::SetInt32(const char* pchSection, const char* pchSettingsKey, int32_t nValue, vr::EVRSettingsError* peError)
+{
+    this->Store(pchSection, pchSettingsKey, nValue, peError);
+}
+
+void DriverRunner::MockSettings::SetFloat(const char* pchSection, const char* pchSettingsKey, float flValue, vr::EVRSettingsError* peError)
+{
+    this->Store(pchSection, pchSettingsKey, flValue, peError);
+}
+
+void DriverRunner::MockSettings::SetString(const char* pchSection, const char* pchSettingsKey, const char* pchValue, vr::EVRSettingsError* peError)
+{
+    this->Store(pchSection, pchSettingsKey, std::string(pchValue), peError);
+}
+
+bool DriverRunner::MockSettings::GetBool(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto value = this->Find<bool>(pchSection, pchSettingsKey, peError);
+    return value ? *value : false;
+}
+
+int32_t DriverRunner::MockSettings::GetInt32(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto value = this->Find<int32_t>(pchSection, pchSettingsKey, peError);
+    return value ? *value : 0;
+}
+
+float DriverRunner::MockSettings::GetFloat(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto value = this->Find<float>(pchSection, pchSettingsKey, peError);
+    return value ? *value : 0.0f;
+}
+
+void DriverRunner::MockSettings::GetString(const char* pchSection, const char* pchSettingsKey, char* pchValue, uint32_t unValueLen, vr::EVRSettingsError* peError)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto value = this->Find<std::string>(pchSection, pchSettingsKey, peError);
+    if (unValueLen == 0)
+        return;
+    std::snprintf(pchValue, unValueLen, "%s", value ? value->c_str() : "");
+}
+
+void DriverRunner::MockSettings::RemoveSection(const char* pchSection, vr::EVRSettingsError* peError)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (auto it = this->values_.begin(); it != this->values_.end();) {
+        if (it->first.first == pchSection)
+            it = this->values_.erase(it);
+        else
+            ++it;
+    }
+    if (peError)
+        *peError = vr::VRSettingsError_None;
+}
+
+void DriverRunner::MockSettings::RemoveKeyInSection(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->values_.erase({ pchSection, pchSettingsKey });
+    if (peError)
+        *peError = vr::VRSettingsError_None;
+}
+
+std::vector<DriverRunner::MockDriverInput::Component> DriverRunner::MockDriverInput::GetComponents() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->components_;
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::Create(vr::PropertyContainerHandle_t container, const char* name, vr::VRInputComponentHandle_t* handle)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    Component component;
+    component.container = container;
+    component.name = name;
+    this->components_.push_back(component);
+    *handle = (vr::VRInputComponentHandle_t)this->components_.size();
+    return vr::VRInputError_None;
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::Update(vr::VRInputComponentHandle_t handle, float value)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (handle == 0 || handle > this->components_.size())
+        return vr::VRInputError_InvalidHandle;
+    this->components_[handle - 1].value = value;
+    return vr::VRInputError_None;
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, vr::VRInputComponentHandle_t* pHandle)
+{
+    return this->Create(ulContainer, pchName, pHandle);
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset)
+{
+    return this->Update(ulComponent, bNewValue ? 1.0f : 0.0f);
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, vr::VRInputComponentHandle_t* pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits)
+{
+    return this->Create(ulContainer, pchName, pHandle);
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset)
+{
+    return this->Update(ulComponent, fNewValue);
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::CreateHapticComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, vr::VRInputComponentHandle_t* pHandle)
+{
+    return this->Create(ulContainer, pchName, pHandle);
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::CreateSkeletonComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, const char* pchSkeletonPath, const char* pchBasePosePath,
+    vr::EVRSkeletalTrackingLevel eSkeletalTrackingLevel, const vr::VRBoneTransform_t* pGripLimitTransforms, uint32_t unGripLimitTransformCount, vr::VRInputComponentHandle_t* pHandle)
+{
+    return this->Create(ulContainer, pchName, pHandle);
+}
+
+vr::EVRInputError DriverRunner::MockDriverInput::UpdateSkeletonComponent(vr::VRInputComponentHandle_t ulComponent, vr::EVRSkeletalMotionRange eMotionRange, const vr::VRBoneTransform_t* pTransforms, uint32_t unTransformCount)
+{
+    // Bone transforms are not kept, only that the handle is valid
+    return this->Update(ulComponent, 0.0f);
+}
+
+void DriverRunner::MockDriverLog::Log(const char* pchLogMessage)
+{
+    if (this->echo)
+        std::fprintf(stderr, "%s\n", pchLogMessage);
+}
+
+void* DriverRunner::MockDriverContext::GetGenericInterface(const char* pchInterfaceVersion, vr::EVRInitError* peError)
+{
+    void* result = nullptr;
+    if (std::strcmp(pchInterfaceVersion, vr::IVRServerDriverHost_Version) == 0)
+        result = static_cast<vr::IVRServerDriverHost*>(&this->host);
+    else if (std::strcmp(pchInterfaceVersion, vr::IVRProperties_Version) == 0)
+        result = static_cast<vr::IVRProperties*>(&this->properties);
+    else if (std::strcmp(pchInterfaceVersion, vr::IVRSettings_Version) == 0)
+        result = static_cast<vr::IVRSettings*>(&this->settings);
+    else if (std::strcmp(pchInterfaceVersion, vr::IVRDriverInput_Version) == 0)
+        result = static_cast<vr::IVRDriverInput*>(&this->input);
+    else if (std::strcmp(pchInterfaceVersion, vr::IVRDriverLog_Version) == 0)
+        result = static_cast<vr::IVRDriverLog*>(&this->log);
+
+    if (peError)
+        *peError = result ? vr::VRInitError_None : vr::VRInitError_Init_InterfaceNotFound;
+    return result;
+}
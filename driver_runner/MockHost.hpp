@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <openvr_driver.h>
+
+namespace DriverRunner {
+
+    // What the driver told the host about one device
+    struct DeviceRecord {
+        std::string serial;
+        vr::ETrackedDeviceClass device_class = vr::TrackedDeviceClass_Invalid;
+        vr::ITrackedDeviceServerDriver* driver = nullptr;
+        bool active = false;
+        uint64_t pose_updates = 0;
+        vr::DriverPose_t last_pose = {};
+    };
+
+    /// <summary>
+    /// Stands in for SteamVR's server driver host: activates added devices and records every pose they post.
+    /// Events queued with QueueEvent are handed out by PollNextEvent on the next frame.
+    /// </summary>
+    class MockServerDriverHost : public vr::IVRServerDriverHost {
+    public:
+        // Called with every posted pose after it was recorded, on the thread that posted it. Set before the driver starts.
+        std::function<void(uint32_t device, const vr::DriverPose_t& pose)> on_pose;
+
+        // Leaves Activate to ActivatePending instead of calling it from TrackedDeviceAdded, the way vrserver activates
+        // devices later on a thread of its own. Set before the driver starts.
+        bool deferred_activation = false;
+
+        void QueueEvent(const vr::VREvent_t& event);
+        // Events queued and not polled yet
+        size_t QueuedEvents() const;
+        std::vector<DeviceRecord> GetDevices() const;
+
+        // Activates the devices added since the last call, returns how many
+        int ActivatePending();
+        // Deactivates every active device, like vrserver shutting down
+        void DeactivateAll();
+
+        // Inherited via IVRServerDriverHost
+        virtual bool TrackedDeviceAdded(const char* pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver* pDriver) override;
+        virtual void TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t& newPose, uint32_t unPoseStructSize) override;
+        virtual void VsyncEvent(double vsyncTimeOffsetSeconds) override {}
+        virtual void VendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t& eventData, double eventTimeOffset) override {}
+        virtual bool IsExiting() override { return false; }
+        virtual bool PollNextEvent(vr::VREvent_t* pEvent, uint32_t uncbVREvent) override;
+        virtual void GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override;
+        virtual void RequestRestart(const char* pchLocalizedReason, const char* pchExecutablePath, const char* pchArguments, const char* pchWorkingDirectory) override {}
+        virtual uint32_t GetFrameTimings(vr::Compositor_FrameTiming* pTiming, uint32_t nFrames) override { return 0; }
+        virtual void SetDisplayEyeToHead(uint32_t unWhichDevice, const vr::HmdMatrix34_t& eyeToHeadLeft, const vr::HmdMatrix34_t& eyeToHeadRight) override {}
+        virtual void SetDisplayProjectionRaw(uint32_t unWhichDevice, const vr::HmdRect2_t& eyeLeft, const vr::HmdRect2_t& eyeRight) override {}
+        virtual void SetRecommendedRenderTargetSize(uint32_t unWhichDevice, uint32_t nWidth, uint32_t nHeight) override {}
+
+    private:
+        mutable std::mutex mutex_;
+        std::vector<DeviceRecord> devices_;     // device index i + 1, index 0 belongs to the HMD in SteamVR
+        std::deque<vr::VREvent_t> events_;
+    };
+
+    /// <summary>
+    /// Property store: every device gets a container, written properties are kept as raw bytes with their type tag
+    /// </summary>
+    class MockProperties : public vr::IVRProperties {
+    public:
+        struct Property {
+            vr::PropertyTypeTag_t tag = vr::k_unInvalidPropertyTag;
+            std::vector<char> value;
+        };
+
+        bool Get(vr::PropertyContainerHandle_t container, vr::ETrackedDeviceProperty prop, Property& out) const;
+
+        // Inherited via IVRProperties
+        virtual vr::ETrackedPropertyError ReadPropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyRead_t* pBatch, uint32_t unBatchEntryCount) override;
+        virtual vr::ETrackedPropertyError WritePropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyWrite_t* pBatch, uint32_t unBatchEntryCount) override;
+        virtual const char* GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) override;
+        virtual vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) override;
+
+    private:
+        mutable std::mutex mutex_;
+        std::map<std::pair<vr::PropertyContainerHandle_t, vr::ETrackedDeviceProperty>, Property> properties_;
+    };
+
+    /// <summary>
+    /// Settings store, empty unless filled with Set. Unset keys fail the way SteamVR's do, so the driver falls back to its defaults.
+    /// </summary>
+    class MockSettings : public vr::IVRSettings {
+    public:
+        using Value = std::variant<bool, int32_t, float, std::string>;
+
+        /// <summary>
+        /// Sets a value from text: true/false is a bool, an integer an int32, any other number a float, everything else a string
+        /// </summary>
+        /// <param name="assignment">[section/]key=value, the section defaults to driver_apriltag</param>
+        /// <returns>False if there is no '='</returns>
+        bool Set(const std::string& assignment);
+
+        // Inherited via IVRSettings
+        virtual const char* GetSettingsErrorNameFromEnum(vr::EVRSettingsError eError) override;
+        virtual void SetBool(const char* pchSection, const char* pchSettingsKey, bool bValue, vr::EVRSettingsError* peError = nullptr) override;
+        virtual void SetInt32(const char* pchSection, const char* pchSettingsKey, int32_t nValue, vr::EVRSettingsError* peError = nullptr) override;
+        virtual void SetFloat(const char* pchSection, const char* pchSettingsKey, float flValue, vr::EVRSettingsError* peError = nullptr) override;
+        virtual void SetString(const char* pchSection, const char* pchSettingsKey, const char* pchValue, vr::EVRSettingsError* peError = nullptr) override;
+        virtual bool GetBool(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError = nullptr) override;
+        virtual int32_t GetInt32(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError = nullptr) override;
+        virtual float GetFloat(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError = nullptr) override;
+        virtual void GetString(const char* pchSection, const char* pchSettingsKey, char* pchValue, uint32_t unValueLen, vr::EVRSettingsError* peError = nullptr) override;
+        virtual void RemoveSection(const char* pchSection, vr::EVRSettingsError* peError = nullptr) override;
+        virtual void RemoveKeyInSection(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError = nullptr) override;
+
+    private:
+        void Store(const char* section, const char* key, Value value, vr::EVRSettingsError* error);
+
+        // the stored value if it holds a T, otherwise nullptr and an error. Callers hold mutex_.
+        template<typename T>
+        const T* Find(const char* section, const char* key, vr::EVRSettingsError* error) const;
+
+        mutable std::mutex mutex_;
+        std::map<std::pair<std::string, std::string>, Value> values_;
+    };
+
+    /// <summary>
+    /// Input components: handles are handed out in creation order, updates only keep the latest value
+    /// </summary>
+    class MockDriverInput : public vr::IVRDriverInput {
+    public:
+        struct Component {
+            vr::PropertyContainerHandle_t container = 0;
+            std::string name;
+            float value = 0;
+        };
+
+        std::vector<Component> GetComponents() const;
+
+        // Inherited via IVRDriverInput
+        virtual vr::EVRInputError CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, vr::VRInputComponentHandle_t* pHandle) override;
+        virtual vr::EVRInputError UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset) override;
+        virtual vr::EVRInputError CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, vr::VRInputComponentHandle_t* pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) override;
+        virtual vr::EVRInputError UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset) override;
+        virtual vr::EVRInputError CreateHapticComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, vr::VRInputComponentHandle_t* pHandle) override;
+        virtual vr::EVRInputError CreateSkeletonComponent(vr::PropertyContainerHandle_t ulContainer, const char* pchName, const char* pchSkeletonPath, const char* pchBasePosePath,
+            vr::EVRSkeletalTrackingLevel eSkeletalTrackingLevel, const vr::VRBoneTransform_t* pGripLimitTransforms, uint32_t unGripLimitTransformCount, vr::VRInputComponentHandle_t* pHandle) override;
+        virtual vr::EVRInputError UpdateSkeletonComponent(vr::VRInputComponentHandle_t ulComponent, vr::EVRSkeletalMotionRange eMotionRange, const vr::VRBoneTransform_t* pTransforms, uint32_t unTransformCount) override;
+
+    private:
+        vr::EVRInputError Create(vr::PropertyContainerHandle_t container, const char* name, vr::VRInputComponentHandle_t* handle);
+        vr::EVRInputError Update(vr::VRInputComponentHandle_t handle, float value);
+
+        mutable std::mutex mutex_;
+        std::vector<Component> components_;     // handle i + 1
+    };
+
+    class MockDriverLog : public vr::IVRDriverLog {
+    public:
+        bool echo = false;      // copy every line to stderr
+
+        // Inherited via IVRDriverLog
+        virtual void Log(const char* pchLogMessage) override;
+    };
+
+    /// <summary>
+    /// The context handed to IServerTrackedDeviceProvider::Init. Through it the driver's vr::VRServerDriverHost(), vr::VRProperties(),
+    /// vr::VRSettings(), vr::VRDriverInput() and vr::VRDriverLog() all end up at the mocks above.
+    /// </summary>
+    class MockDriverContext : public vr::IVRDriverContext {
+    public:
+        MockServerDriverHost host;
+        MockProperties properties;
+        MockSettings settings;
+        MockDriverInput input;
+        MockDriverLog log;
+
+        // Inherited via IVRDriverContext
+        virtual void* GetGenericInterface(const char* pchInterfaceVersion, vr::EVRInitError* peError = nullptr) override;
+        virtual vr::DriverHandle_t GetDriverHandle() override { return 1; }
+    };
+}
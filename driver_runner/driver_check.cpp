@@ -0,0 +1,1055 @@
+// Checks of the driver for CI on machines without SteamVR, most of them end to end against the mock SteamVR host.
+// Every check is a subcommand that prints what it measured and exits with 0 when it passed:
+//
+//   loopback          pose updates sent over the local transport (unix socket on linux, named pipe on windows)
+//                     until the host sees the pose move, with percentiles of the reply round trip and of the whole
+//                     way to SteamVR
+//   sharedmemory      the same through the pipe and then through the shared memory rings, to compare the two
+//   extrapolation     every other sample of a known path sent, the ones left out compared with the posted poses
+//                     moved along their velocities the way SteamVR does between our updates
+//   clockdelay        samples held back on their way to the driver, sent as ages and as synced capture times, with
+//                     the error of the posted poses for every delay
+//   allocations       counts the heap allocations RunFrame makes once warmed up, there must be none, also on frames
+//                     with a burst of more events than it polls at once
+//   handshake         version 1 and current version handshakes, and a version 1 update refused in the version 1 layout
+//   fusion            two cameras that name themselves and clients that name none sending poses of one tracker with
+//                     fusion turned on, only the named cameras may become sources
+//   stress            clients hammer the driver from several threads for a few seconds: batches, single updates and
+//                     queries, shared memory, settings changes and new trackers, while RunFrame runs at 1 kHz and
+//                     another thread activates the trackers, and deactivates them all at the end
+//   stress_publisher  the same with the pose publisher thread posting the trackers instead of RunFrame
+//   regression        RegressionFilter, which fits from running sums, against the original multi-pass regression
+//                     on the same samples, without a driver
+//   recording         a session recording written from several threads at once until it is stopped under them, every
+//                     record must come out whole and in order, without a driver
+//
+// CTest runs each check as a test of its own. They all serve the same pipe name, so they never run at the same time.
+// Where the compiler has ThreadSanitizer the stress and recording checks run again in driver_check_tsan, which fails on
+// any race.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openvr_driver.h>
+
+#include <Native/DriverFactory.hpp>
+#include <Driver/Clock.hpp>
+#include <Driver/Telemetry.hpp>
+#include <Driver/Transport.hpp>
+#include <Driver/Protocol.hpp>
+#include <Driver/SharedMemory.hpp>
+#include <Driver/RegressionFilter.hpp>
+#include <Driver/Recording.hpp>
+
+#include <ApriltagClient.hpp>
+
+#include "AllocationCounter.hpp"
+#include "MockHost.hpp"
+
+using namespace ExampleDriver;
+
+namespace {
+
+    // Never destroyed, the driver's pipe threads outlive main
+    DriverRunner::MockDriverContext& Context()
+    {
+        static DriverRunner::MockDriverContext* context = new DriverRunner::MockDriverContext();
+        return *context;
+    }
+
+    vr::IServerTrackedDeviceProvider* StartDriver()
+    {
+        int error = vr::VRInitError_None;
+        auto provider = static_cast<vr::IServerTrackedDeviceProvider*>(HmdDriverFactory(vr::IServerTrackedDeviceProvider_Version, &error));
+        if (provider == nullptr || provider->Init(&Context()) != vr::VRInitError_None) {
+            std::fprintf(stderr, "driver failed to initialize\n");
+            return nullptr;
+        }
+        return provider;
+    }
+
+    // Calls RunFrame at a fixed rate on a thread of its own, like SteamVR does
+    class FrameThread {
+    public:
+        FrameThread(vr::IServerTrackedDeviceProvider* provider, double rate)
+        {
+            this->thread_ = std::thread([this, provider, rate]() {
+                auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / rate));
+                auto next = std::chrono::steady_clock::now();
+                while (this->running_.load(std::memory_order_relaxed)) {
+                    provider->RunFrame();
+                    next += period;
+                    std::this_thread::sleep_until(next);
+                }
+            });
+        }
+
+        ~FrameThread()
+        {
+            this->running_ = false;
+            this->thread_.join();
+        }
+
+    private:
+        std::atomic<bool> running_{ true };
+        std::thread thread_;
+    };
+
+    void PrintPercentiles(const char* name, const Histogram::Snapshot& snapshot)
+    {
+        std::printf("%-12s %6llu samples, mean %8.1f us, p50 %8.1f us, p90 %8.1f us, p99 %8.1f us, max %8.1f us\n", name,
+            (unsigned long long)snapshot.count, snapshot.Mean() / 1000, snapshot.Percentile(0.5) / 1000, snapshot.Percentile(0.9) / 1000,
+            snapshot.Percentile(0.99) / 1000, snapshot.Max() / 1000);
+    }
+
+    int64_t NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // One text command and its reply, without the trailing newline
+    bool Request(IConnection& connection, const char* command, std::string& reply)
+    {
+        char buffer[kMaxMessageSize];
+        if (!connection.Send(command, std::strlen(command)))
+            return false;
+        int length = connection.Receive(buffer, sizeof(buffer) - 1);
+        if (length < 0)
+            return false;
+        reply.assign(buffer, length);
+        while (!reply.empty() && (reply.back() == '\n' || reply.back() == '\0'))
+            reply.pop_back();
+        return true;
+    }
+
+    // The step on its way to the host, shared with the host's pose hook on the frame thread
+    constexpr double kArrivalThreshold = 0.0001;        // m the posted pose has to move before a step counts as arrived
+    std::atomic<int64_t> g_sent_at{ 0 };                // ns, 0 while no step is on its way
+    std::atomic<double> g_origin{ 0 };                  // x the tracker steps away from
+    Histogram* g_arrival = new Histogram();             // ns from sending a step until the host saw it
+
+    // Sends one pose of tracker 0, false if it could not be sent
+    using SendPose = std::function<bool(const ApriltagClient::Pose& pose)>;
+
+    // Steps tracker 0 back and forth by a centimeter through send and times every step until the host sees the tracker
+    // leave its old position. The history is filled at the new position before the next step, so every step starts
+    // from rest. Prints percentiles of the send call and of the arrival at the host, returns the number of steps that
+    // failed to send or never reached the host.
+    int MeasureSteps(const char* name, const SendPose& send)
+    {
+        const int steps = 100;
+        const int history = 5;
+        const double step = 0.01;           // m
+        const double timeout = 1;           // s
+
+        auto sending = std::make_unique<Histogram>();
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> phase(0, 11111);
+        ApriltagClient::Pose pose = { { 0, 1, 0 }, { 1, 0, 0, 0 } };
+        auto hold = [&]() {
+            for (int i = 0; i < history; i++) {
+                send(pose);
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+            // a few frames to post the pose at rest, then a random part of a frame so steps land all over the frame
+            std::this_thread::sleep_for(std::chrono::milliseconds(40) + std::chrono::microseconds(phase(random)));
+        };
+        hold();
+
+        Histogram::Snapshot before;
+        g_arrival->Read(before);
+        int failed = 0;
+        for (int i = 0; i < steps; i++) {
+            g_origin.store(pose.position[0], std::memory_order_relaxed);
+            pose.position[0] = pose.position[0] == 0 ? step : 0;
+
+            int64_t sent = NowNs();
+            g_sent_at.store(sent, std::memory_order_release);
+            bool ok = send(pose);
+            sending->Record(NowNs() - sent);
+
+            while (g_sent_at.load(std::memory_order_acquire) != 0 && NowNs() - sent < timeout * 1e9)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            int64_t pending = sent;
+            bool lost = g_sent_at.compare_exchange_strong(pending, 0);
+            if (!ok || lost)
+                failed++;
+            hold();
+        }
+
+        Histogram::Snapshot result;
+        sending->Read(result);
+        PrintPercentiles((std::string(name) + "_send").c_str(), result);
+        g_arrival->Read(result);
+        PrintPercentiles((std::string(name) + "_arrival").c_str(), result - before);
+        std::printf("%s: %d steps, %d failed or never reached the host\n", name, steps, failed);
+        return failed;
+    }
+
+    // The host's pose hook for MeasureSteps
+    void WatchArrival(uint32_t device, const vr::DriverPose_t& pose)
+    {
+        int64_t sent = g_sent_at.load(std::memory_order_acquire);
+        if (sent != 0 && std::abs(pose.vecPosition[0] - g_origin.load(std::memory_order_relaxed)) > kArrivalThreshold
+            && g_sent_at.compare_exchange_strong(sent, 0))
+            g_arrival->Record(NowNs() - sent);
+    }
+
+    // Starts the driver with one tracker and RunFrame at 90 Hz, handing every posted pose to on_pose
+    struct Session {
+        vr::IServerTrackedDeviceProvider* provider = nullptr;
+        ApriltagClient::Client client;
+        std::unique_ptr<FrameThread> frames;
+
+        bool Start(std::function<void(uint32_t device, const vr::DriverPose_t& pose)> on_pose = WatchArrival)
+        {
+            Context().host.on_pose = std::move(on_pose);
+
+            this->provider = StartDriver();
+            if (this->provider == nullptr || !this->client.Connect()) {
+                std::fprintf(stderr, "could not connect to the driver\n");
+                return false;
+            }
+            if (!this->client.AddTracker("check_0", "TrackerRole_Waist")) {
+                std::fprintf(stderr, "could not add a tracker\n");
+                return false;
+            }
+            this->frames = std::make_unique<FrameThread>(this->provider, 90);
+            return true;
+        }
+    };
+
+    // Poses sent over the local transport, each waiting for its reply
+    int CheckLoopback()
+    {
+        Session session;
+        if (!session.Start())
+            return 1;
+        return MeasureSteps("pipe", [&](const ApriltagClient::Pose& pose) {
+            return session.client.UpdatePose(0, pose, 0) == ApriltagClient::Status::Updated;
+        }) == 0 ? 0 : 1;
+    }
+
+    // The same steps through the pipe and through the shared memory rings, one after the other in the same driver
+    int CheckSharedMemory()
+    {
+        Session session;
+        if (!session.Start())
+            return 1;
+
+        std::unique_ptr<IConnection> connection = ConnectTransport("ApriltagPipeIn");
+        std::string reply;
+        SharedMemory::Mapping mapping;
+        if (connection == nullptr || !Request(*connection, "sharedmemory", reply) || reply.find("sharedmemory ApriltagPoseMemory") == std::string::npos
+            || !mapping.Open("ApriltagPoseMemory", false)) {
+            std::fprintf(stderr, "could not map the driver's shared memory\n");
+            return 1;
+        }
+
+        int failed = MeasureSteps("pipe", [&](const ApriltagClient::Pose& pose) {
+            return session.client.UpdatePose(0, pose, 0) == ApriltagClient::Status::Updated;
+        });
+        failed += MeasureSteps("shm", [&](const ApriltagClient::Pose& pose) {
+            SharedMemory::Sample sample;
+            std::memcpy(sample.position, pose.position, sizeof(sample.position));
+            std::memcpy(sample.rotation, pose.rotation, sizeof(sample.rotation));
+            sample.capture_time = SharedMemory::Now();
+            return SharedMemory::Push(mapping.Get()->rings[0], sample);
+        });
+        return failed == 0 ? 0 : 1;
+    }
+
+    // A tracker going round a circle of 5 m at 1 m/s at session time t, wide enough for the regression to fit it closely
+    // and within the 10 m the driver accepts samples at
+    void ArcPose(double t, ApriltagClient::Pose& pose)
+    {
+        double angle = 0.2 * t;
+        pose = { { 5 * std::cos(angle), 1, 5 * std::sin(angle) }, { std::cos(angle / 2), 0, std::sin(angle / 2), 0 } };
+    }
+
+    void SleepUntil(double session_time)
+    {
+        std::this_thread::sleep_until(Clock::Epoch() + std::chrono::duration_cast<Clock::Source::duration>(std::chrono::duration<double>(session_time)));
+    }
+
+    // Every valid pose the host was handed, in world space, for comparing with the true path. Add is the host's pose hook.
+    struct PoseLog {
+        struct Posted {
+            double time;            // session seconds the pose was posted
+            double pose_time;       // and predicted for
+            Recording::PoseRecord pose;
+        };
+
+        std::mutex mutex;
+        std::vector<Posted> posted;
+
+        void Add(const vr::DriverPose_t& pose)
+        {
+            if (!pose.poseIsValid)
+                return;
+            double now = Clock::Now();
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->posted.push_back({ now, now + pose.poseTimeOffset, Recording::MakePoseRecord(pose) });
+        }
+    };
+
+    // SteamVR does not wait for our next pose, it moves the newest one along its velocity to the time it draws. The
+    // client sends every other sample of a tracker moving along a wide arc, the samples left out are compared with
+    // what SteamVR would have drawn at their capture time: the newest pose posted a frame before, extrapolated from the
+    // time it was predicted for (posting time plus poseTimeOffset). The arc is wide enough for the regression to fit it,
+    // so what is left is the extrapolation. Passes when it is well below the error of the pose left where it was.
+    int CheckExtrapolation()
+    {
+        const double seconds = 4;
+        const double settle = 1;            // s before anything is compared, the history fills up
+        const double rate = 60;             // Hz of the samples, half of them sent
+        const double age = 0.02;            // s, how old the samples are when sent
+        const double lead = 1.0 / 90;       // s SteamVR draws ahead of the newest pose, a frame
+        const double max_error = 0.01;      // m rms
+
+        PoseLog log;
+        Session session;
+        if (!session.Start([&log](uint32_t device, const vr::DriverPose_t& pose) { log.Add(pose); }))
+            return 1;
+
+        std::vector<double> held_out;
+        double start = Clock::Now();
+        int failed = 0;
+        for (int n = 0;; n++) {
+            double capture = start + n / rate;
+            if (capture - start > seconds)
+                break;
+            SleepUntil(capture + age);
+            if (n % 2 == 1) {
+                held_out.push_back(capture);
+                continue;
+            }
+            ApriltagClient::Pose pose;
+            ArcPose(capture, pose);
+            if (session.client.UpdatePose(0, pose, Clock::Now() - capture) != ApriltagClient::Status::Updated)
+                failed++;
+        }
+        session.frames.reset();
+
+        double extrapolated_squares = 0;
+        double held_squares = 0;
+        uint64_t compared = 0;
+        std::lock_guard<std::mutex> lock(log.mutex);
+        const std::vector<PoseLog::Posted>& posted = log.posted;
+        for (double capture : held_out) {
+            auto after = std::upper_bound(posted.begin(), posted.end(), capture - lead, [](double t, const PoseLog::Posted& p) { return t < p.time; });
+            if (capture - start < settle || after == posted.begin())
+                continue;
+            const PoseLog::Posted& newest = *(after - 1);
+            ApriltagClient::Pose truth;
+            ArcPose(capture, truth);
+            for (int i = 0; i < 3; i++) {
+                double extrapolated = newest.pose.position[i] + newest.pose.velocity[i] * (capture - newest.pose_time);
+                extrapolated_squares += (extrapolated - truth.position[i]) * (extrapolated - truth.position[i]);
+                held_squares += (newest.pose.position[i] - truth.position[i]) * (newest.pose.position[i] - truth.position[i]);
+            }
+            compared++;
+        }
+
+        double extrapolated_rms = std::sqrt(extrapolated_squares / std::max<uint64_t>(1, compared));
+        double held_rms = std::sqrt(held_squares / std::max<uint64_t>(1, compared));
+        std::printf("%llu held out samples, %zu poses posted, %d updates failed\n", (unsigned long long)compared, posted.size(), failed);
+        std::printf("extrapolated from the posted velocity %.2f mm rms, without it %.2f mm rms\n", extrapolated_rms * 1000, held_rms * 1000);
+        bool passed = failed == 0 && compared > 0 && extrapolated_rms < max_error && extrapolated_rms < held_rms / 2;
+        return passed ? 0 : 1;
+    }
+
+    // Pipe queueing between the client stamping a sample and the driver reading it: the client sends the tracker's
+    // samples with a delay injected after it stamped them, first as ages (updatepose), then as capture times on its
+    // own clock after a few clock syncs (UpdatePoseAt). Ages grow stale by the delay, so the posted poses trail the
+    // true path by it; absolute capture times should leave the error where it was without a delay. The syncs are not
+    // delayed, the driver's offset estimate assumes the two ways take about as long.
+    int CheckClockDelay()
+    {
+        const double delays[] = { 0, 0.01, 0.02, 0.03 };    // s, below the sample period, so samples never overtake
+        const double segment = 2;           // s per delay and mode
+        const double settle = 0.5;          // s of every segment not compared, the history still holds older samples
+        const double rate = 30;             // Hz
+        const double age = 0.02;            // s, how old the samples are when stamped
+        const double max_growth = 0.005;    // m rms the error with capture times may grow by at the longest delay, the
+                                            // prediction reaches further past older samples and the circle bends away a little
+        const double min_growth = 0.01;     // m rms the error with ages has to grow by, or the delay did not get through
+
+        PoseLog log;
+        Session session;
+        if (!session.Start([&log](uint32_t device, const vr::DriverPose_t& pose) { log.Add(pose); }))
+            return 1;
+
+        int failed = 0;
+        double rms[2][4];
+        double next = Clock::Now();
+        for (int absolute = 0; absolute < 2; absolute++) {
+            for (int d = 0; d < 4; d++) {
+                double start = next;
+                int samples = int(segment * rate);
+                for (int n = 0; n < samples; n++) {
+                    double capture = start + n / rate;
+                    if (absolute && n % int(rate) == 0 && !session.client.SyncClock())
+                        failed++;
+                    SleepUntil(capture + age);
+                    ApriltagClient::Pose pose;
+                    ArcPose(capture, pose);
+                    double stamped_age = Clock::Now() - capture;
+                    double client_capture = ApriltagClient::Client::Now() - stamped_age;
+                    SleepUntil(capture + age + delays[d]);
+                    ApriltagClient::Status status = absolute ? session.client.UpdatePoseAt(0, pose, client_capture)
+                        : session.client.UpdatePose(0, pose, stamped_age);
+                    if (status != ApriltagClient::Status::Updated)
+                        failed++;
+                }
+                next = start + samples / rate;
+
+                double squares = 0;
+                uint64_t compared = 0;
+                std::lock_guard<std::mutex> lock(log.mutex);
+                for (const PoseLog::Posted& posted : log.posted) {
+                    if (posted.time < start + settle || posted.time >= next)
+                        continue;
+                    ApriltagClient::Pose truth;
+                    ArcPose(posted.pose_time, truth);
+                    for (int i = 0; i < 3; i++)
+                        squares += (posted.pose.position[i] - truth.position[i]) * (posted.pose.position[i] - truth.position[i]);
+                    compared++;
+                }
+                rms[absolute][d] = std::sqrt(squares / std::max<uint64_t>(1, compared));
+                std::printf("%-13s delay %2.0f ms: %4llu poses, %6.2f mm rms from the true path\n", absolute ? "capture times" : "ages",
+                    delays[d] * 1000, (unsigned long long)compared, rms[absolute][d] * 1000);
+            }
+        }
+        session.frames.reset();
+
+        std::printf("%d updates or syncs failed\n", failed);
+        return failed == 0 && rms[1][3] - rms[1][0] < max_growth && rms[0][3] - rms[0][0] > min_growth ? 0 : 1;
+    }
+
+    // Every RunFrame on this thread with poses to post, haptic events to dispatch and device poses to publish to shared
+    // memory, after a warm-up that lets every buffer reach its size. After it, now and then a frame gets a burst of more
+    // events than RunFrame holds at once. Fails on any heap allocation made inside RunFrame or on events left unpolled;
+    // sending the poses and queueing the events happens between frames and is not counted.
+    int CheckAllocations()
+    {
+        const int trackers = 4;
+        const int warmup = 200;
+        const int frames = 2000;
+        const int burst = 200;              // events queued on every 100th frame after the warm-up, nothing has grown to fit them
+
+        vr::IServerTrackedDeviceProvider* provider = StartDriver();
+        ApriltagClient::Client client;
+        if (provider == nullptr || !client.Connect()) {
+            std::fprintf(stderr, "could not connect to the driver\n");
+            return 1;
+        }
+        for (int i = 0; i < trackers; i++)
+            client.AddTracker(("alloc_" + std::to_string(i)).c_str(), "TrackerRole_Waist");
+        uint32_t devices[] = { 1, 2 };
+        if (!client.SubscribeDevicePoses(devices, 2)) {
+            std::fprintf(stderr, "could not subscribe to device poses\n");
+            return 1;
+        }
+
+        int failed = 0;
+        uint64_t allocations = 0;
+        uint64_t worst = 0;
+        int unpolled = 0;
+        for (int frame = 0; frame < warmup + frames; frame++) {
+            double t = frame / 90.0;
+            for (int i = 0; i < trackers; i++) {
+                if ((frame + i) % 3 != 0)
+                    continue;
+                ApriltagClient::Pose pose;
+                ArcPose(t + i, pose);
+                if (client.UpdatePose(i, pose, 0.01) != ApriltagClient::Status::Updated)
+                    failed++;
+            }
+            for (int n = 0; n < (frame >= warmup && frame % 100 == 50 ? burst : 1); n++) {
+                vr::VREvent_t event = {};
+                event.eventType = vr::VREvent_Input_HapticVibration;
+                event.data.hapticVibration.componentHandle = (frame + n) % 8;
+                Context().host.QueueEvent(event);
+            }
+
+            uint64_t before = DriverRunner::AllocationCounter::Total();
+            DriverRunner::AllocationCounter::Count(true);
+            provider->RunFrame();
+            DriverRunner::AllocationCounter::Count(false);
+            uint64_t made = DriverRunner::AllocationCounter::Total() - before;
+            if (Context().host.QueuedEvents() != 0)
+                unpolled++;
+            if (frame >= warmup) {
+                allocations += made;
+                worst = std::max(worst, made);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+
+        std::printf("%d frames with %d trackers and bursts of %d events: %llu heap allocations in RunFrame, at most %llu in one frame, "
+            "%d frames left events unpolled, %d updates failed\n", frames, trackers, burst, (unsigned long long)allocations,
+            (unsigned long long)worst, unpolled, failed);
+        return allocations == 0 && unpolled == 0 && failed == 0 ? 0 : 1;
+    }
+
+    // Clients of protocol version 1, whose header ends after magic, version and type, still get their handshake
+    // answered in their own layout and are told the version does not match for anything else, without a request id
+    // written over the body. A handshake on the current version gets its request id back.
+    int CheckHandshake()
+    {
+        vr::IServerTrackedDeviceProvider* provider = StartDriver();
+        std::unique_ptr<IConnection> connection;
+        for (int attempt = 0; provider != nullptr && attempt < 50 && connection == nullptr; attempt++) {
+            connection = ConnectTransport("ApriltagPipeIn");
+            if (connection == nullptr)
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (connection == nullptr) {
+            std::fprintf(stderr, "could not connect to the driver\n");
+            return 1;
+        }
+
+        // magic, version and type, then the body, the way version 1 packed its messages
+        auto v1_message = [](Protocol::MessageType type, const void* body, size_t size) {
+            std::string message(Protocol::kMinHeaderSize + size, '\0');
+            Protocol::Header header = Protocol::MakeHeader(type);
+            header.version = 1;
+            std::memcpy(&message[0], &header, Protocol::kMinHeaderSize);
+            std::memcpy(&message[Protocol::kMinHeaderSize], body, size);
+            return message;
+        };
+        char reply[kMaxMessageSize];
+        auto exchange = [&](const std::string& message) {
+            return connection->Send(message.data(), message.size()) ? connection->Receive(reply, sizeof(reply)) : -1;
+        };
+        int failed = 0;
+
+        uint16_t client_version = 1;
+        int length = exchange(v1_message(Protocol::MessageType::Handshake, &client_version, sizeof(client_version)));
+        Protocol::Header header = Protocol::DecodeHeader(reply, std::max(length, 0));
+        uint16_t driver_version = 0;
+        if (length == int(Protocol::kMinHeaderSize + sizeof(driver_version)))
+            std::memcpy(&driver_version, reply + Protocol::kMinHeaderSize, sizeof(driver_version));
+        bool ok = header.magic == Protocol::kMagic && header.type == Protocol::MessageType::HandshakeReply && header.version == Protocol::kVersion
+            && driver_version == Protocol::kVersion;
+        std::printf("version 1 handshake: %d byte reply, driver version %u, %s\n", length, driver_version, ok ? "ok" : "wrong");
+        failed += !ok;
+
+        // idx, position, rotation, time and smoothing of a version 1 UpdatePose
+        char pose[4 + 9 * sizeof(double)] = {};
+        length = exchange(v1_message(Protocol::MessageType::UpdatePose, pose, sizeof(pose)));
+        header = Protocol::DecodeHeader(reply, std::max(length, 0));
+        Protocol::Status status = Protocol::Status::Updated;
+        if (length == int(Protocol::kMinHeaderSize + sizeof(status)))
+            std::memcpy(&status, reply + Protocol::kMinHeaderSize, sizeof(status));
+        ok = header.type == Protocol::MessageType::StatusReply && status == Protocol::Status::VersionMismatch;
+        std::printf("version 1 update: %d byte reply, status %d, %s\n", length, int(status), ok ? "ok" : "wrong");
+        failed += !ok;
+
+        Protocol::HandshakeMessage handshake{ Protocol::MakeHeader(Protocol::MessageType::Handshake, 1234), Protocol::kVersion };
+        length = exchange(std::string(reinterpret_cast<const char*>(&handshake), sizeof(handshake)));
+        Protocol::HandshakeReply handshake_reply{};
+        ok = Protocol::Decode(reply, std::max(length, 0), handshake_reply) && handshake_reply.header.request_id == 1234
+            && handshake_reply.driver_version == Protocol::kVersion;
+        std::printf("version %u handshake: %d byte reply, request id %u, %s\n", Protocol::kVersion, length, handshake_reply.header.request_id, ok ? "ok" : "wrong");
+        failed += !ok;
+
+        return failed == 0 ? 0 : 1;
+    }
+
+    // Fusion tells the cameras of a tracker apart by the id their clients send, not by the connection: two clients that
+    // name cameras 1 and 2 send at 30 Hz, while old style clients that name no camera connect for every single update,
+    // which must neither show up as sources nor push the cameras out. A text update naming camera 3 adds a third.
+    int CheckFusion()
+    {
+        const double seconds = 2;
+        const double rate = 30;             // Hz, per camera
+        const double age = 0.01;            // s
+
+        Context().settings.Set("fusion_window=25");
+        Session session;
+        ApriltagClient::Client cameras[2];
+        if (!session.Start())
+            return 1;
+        for (int c = 0; c < 2; c++) {
+            if (!cameras[c].Connect()) {
+                std::fprintf(stderr, "could not connect to the driver\n");
+                return 1;
+            }
+            cameras[c].SetSource(c + 1);
+        }
+
+        // fusionstats <idx> <window ms> <count>, then id, error, accepted and rejected of every camera
+        auto stats = [](std::vector<std::array<double, 4>>& sources, double& window) {
+            std::unique_ptr<IConnection> connection = ConnectTransport("ApriltagPipeIn");
+            std::string reply;
+            int count = 0;
+            int used = 0;
+            size_t at = connection != nullptr && Request(*connection, "fusionstats 0", reply) ? reply.find("fusionstats") : std::string::npos;
+            if (at == std::string::npos || std::sscanf(reply.c_str() + at, "fusionstats 0 %lf %d%n", &window, &count, &used) != 2)
+                return false;
+            sources.assign(count, {});
+            const char* rest = reply.c_str() + at + used;
+            for (auto& source : sources) {
+                if (std::sscanf(rest, "%lf %lf %lf %lf%n", &source[0], &source[1], &source[2], &source[3], &used) != 4)
+                    return false;
+                rest += used;
+            }
+            return true;
+        };
+
+        int failed = 0;
+        int one_shots = 0;
+        double start = Clock::Now();
+        for (int n = 0; n < int(seconds * rate); n++) {
+            double capture = start + n / rate;
+            SleepUntil(capture + age);
+            ApriltagClient::Pose pose;
+            ArcPose(capture, pose);
+            for (ApriltagClient::Client& camera : cameras) {
+                if (camera.UpdatePose(0, pose, Clock::Now() - capture) != ApriltagClient::Status::Updated)
+                    failed++;
+            }
+            if (n % 3 == 0) {
+                char command[256];
+                std::snprintf(command, sizeof(command), "updatepose 0 %f %f %f %f %f %f %f %f 0", pose.position[0], pose.position[1],
+                    pose.position[2], pose.rotation[0], pose.rotation[1], pose.rotation[2], pose.rotation[3], Clock::Now() - capture);
+                std::unique_ptr<IConnection> connection = ConnectTransport("ApriltagPipeIn");
+                std::string reply;
+                if (connection == nullptr || !Request(*connection, command, reply) || reply.find("updated") == std::string::npos)
+                    failed++;
+                one_shots++;
+            }
+        }
+
+        std::vector<std::array<double, 4>> sources;
+        double window = 0;
+        bool ok = stats(sources, window) && window == 25 && sources.size() == 2;
+        for (size_t i = 0; ok && i < sources.size(); i++)
+            ok = sources[i][0] == i + 1 && sources[i][2] > 0;
+        std::printf("%d one shot updates without a camera, window %.0f ms, %zu sources:", one_shots, window, sources.size());
+        for (const auto& source : sources)
+            std::printf(" camera %.0f %.0f accepted %.0f rejected", source[0], source[2], source[3]);
+        std::printf(", %s\n", ok ? "ok" : "wrong");
+        failed += !ok;
+
+        std::unique_ptr<IConnection> connection = ConnectTransport("ApriltagPipeIn");
+        std::string reply;
+        if (connection == nullptr || !Request(*connection, "updatepose 0 5 1 0 1 0 0 0 0 0 3", reply) || reply.find("updated") == std::string::npos)
+            failed++;
+        ok = stats(sources, window) && sources.size() == 3 && sources[2][0] == 3;
+        std::printf("text update naming camera 3: %zu sources, %s\n", sources.size(), ok ? "ok" : "wrong");
+        failed += !ok;
+
+        session.frames.reset();
+        std::printf("%d updates failed\n", failed);
+        return failed == 0 ? 0 : 1;
+    }
+
+    // Every thread counts what failed, a client that loses its connection stops early. The counts only say whether
+    // the driver kept answering, the races themselves are ThreadSanitizer's to find.
+    int Stress(bool publisher)
+    {
+        const double seconds = 3;
+        const int max_trackers = 16;
+
+        if (publisher)
+            Context().settings.Set("pose_publisher_rate=500");
+        // devices are activated from a thread of their own while poses are posted, as vrserver does
+        Context().host.deferred_activation = true;
+        vr::IServerTrackedDeviceProvider* provider = StartDriver();
+        ApriltagClient::Client setup;
+        if (provider == nullptr || !setup.Connect()) {
+            std::fprintf(stderr, "could not connect to the driver\n");
+            return 1;
+        }
+        for (int i = 0; i < 4; i++)
+            setup.AddTracker(("stress_" + std::to_string(i)).c_str(), "TrackerRole_Waist");
+        FrameThread frames(provider, 1000);
+
+        std::atomic<bool> running{ true };
+        std::atomic<int> failures{ 0 };
+        std::atomic<uint64_t> operations{ 0 };
+        auto pose_at = [](int tracker, double t, ApriltagClient::Pose& pose) {
+            pose = { { 0.5 * std::cos(t + tracker), 1, 0.5 * std::sin(t + tracker) }, { std::cos(t / 2), 0, std::sin(t / 2), 0 } };
+        };
+        auto now = []() { return ApriltagClient::Client::Now(); };
+        auto client_thread = [&](auto&& body) {
+            return std::thread([&, body]() {
+                ApriltagClient::Client client;
+                if (!client.Connect()) {
+                    failures++;
+                    return;
+                }
+                uint64_t count = 0;
+                while (running.load(std::memory_order_relaxed) && body(client))
+                    count++;
+                if (running.load(std::memory_order_relaxed))
+                    failures++;
+                operations += count;
+            });
+        };
+
+        std::vector<std::thread> threads;
+        // batches for every tracker there is, from two clients at once
+        for (int c = 0; c < 2; c++) {
+            threads.push_back(client_thread([&](ApriltagClient::Client& client) {
+                ApriltagClient::PoseSample samples[max_trackers];
+                int count = client.NumTrackers();
+                double t = now();
+                for (int i = 0; i < count && i < max_trackers; i++) {
+                    ApriltagClient::Pose pose;
+                    pose_at(i, t, pose);
+                    samples[i].idx = i;
+                    samples[i].source = 0;
+                    std::memcpy(samples[i].position, pose.position, sizeof(samples[i].position));
+                    std::memcpy(samples[i].rotation, pose.rotation, sizeof(samples[i].rotation));
+                    samples[i].time = 0;
+                }
+                return count >= 0 && client.UpdatePoses(samples, std::min(count, max_trackers));
+            }));
+        }
+        // single updates, fire and forget ones and pose queries
+        threads.push_back(client_thread([&](ApriltagClient::Client& client) {
+            ApriltagClient::Pose pose;
+            pose_at(0, now(), pose);
+            client.SendPose(1, pose, 0.01);
+            if (client.UpdatePose(0, pose, 0) == ApriltagClient::Status::Malformed)
+                return false;
+            return client.GetTrackerPose(0, 0, pose) != ApriltagClient::Status::Malformed;
+        }));
+        // samples through shared memory and subscribed device poses back, mapping is only touched by this thread
+        SharedMemory::Mapping mapping;
+        threads.push_back(client_thread([&](ApriltagClient::Client& client) {
+            if (mapping.Get() == nullptr) {
+                uint32_t devices[] = { 1, 2 };
+                std::string reply;
+                auto connection = ConnectTransport("ApriltagPipeIn");
+                if (connection == nullptr || !Request(*connection, "sharedmemory", reply) || !mapping.Open("ApriltagPoseMemory", false)
+                    || !client.SubscribeDevicePoses(devices, 2))
+                    return false;
+            }
+            ApriltagClient::Pose pose;
+            pose_at(2, now(), pose);
+            SharedMemory::Sample sample;
+            std::memcpy(sample.position, pose.position, sizeof(sample.position));
+            std::memcpy(sample.rotation, pose.rotation, sizeof(sample.rotation));
+            sample.capture_time = SharedMemory::Now();
+            SharedMemory::Push(mapping.Get()->rings[2], sample);
+            ApriltagClient::DevicePose device;
+            client.ReadDevicePose(1, device);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            return true;
+        }));
+        // settings, filters, new trackers and the stats replies, which read every tracker
+        threads.push_back(std::thread([&]() {
+            auto connection = ConnectTransport("ApriltagPipeIn");
+            const char* commands[] = { "settings 10 1 0 regression", "stats", "settings 20 1 0.2 kalman", "publisherstats",
+                "settings 5 1 0 oneeuro", "fusionstats 0", "addtracker", "numtrackers" };
+            std::string reply;
+            uint64_t count = 0;
+            for (int i = 0; connection != nullptr && running.load(std::memory_order_relaxed); i++) {
+                std::string command = commands[i % 8];
+                if (command == "addtracker") {
+                    if (setup.NumTrackers() >= max_trackers)
+                        continue;
+                    command += " stress_" + std::to_string(i) + " TrackerRole_Waist";
+                }
+                if (!Request(*connection, command.c_str(), reply))
+                    break;
+                count++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            if (running.load(std::memory_order_relaxed))
+                failures++;
+            operations += count;
+        }));
+        // haptic events for the frame thread to dispatch
+        threads.push_back(std::thread([&]() {
+            for (uint32_t i = 0; running.load(std::memory_order_relaxed); i++) {
+                vr::VREvent_t event = {};
+                event.eventType = vr::VREvent_Input_HapticVibration;
+                event.data.hapticVibration.componentHandle = i % 8;
+                Context().host.QueueEvent(event);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }));
+
+        std::atomic<bool> activating{ true };
+        std::thread activation([&]() {
+            while (activating.load(std::memory_order_relaxed)) {
+                Context().host.ActivatePending();
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        activating = false;
+        activation.join();
+        // shutting down the way vrserver does: every device deactivated while the frames and clients carry on
+        Context().host.DeactivateAll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        running = false;
+        for (std::thread& thread : threads)
+            thread.join();
+
+        std::printf("%llu operations from %zu threads in %.0f s, %d threads failed\n", (unsigned long long)operations.load(),
+            threads.size(), seconds, failures.load());
+        return failures == 0 ? 0 : 1;
+    }
+
+    int CheckStress()
+    {
+        return Stress(false);
+    }
+
+    int CheckStressPublisher()
+    {
+        return Stress(true);
+    }
+
+    // The prediction before RegressionFilter kept running sums, as TrackerDevice::get_next_pose had it: samples stored
+    // as ages before the newest update, averages, deviations and the correlation in separate passes over them.
+    // ages[i] and values[i][7] are the samples, age the age to predict at.
+    bool OriginalRegression(const std::vector<double>& ages, const std::vector<std::array<double, 7>>& values, double age, double pred[])
+    {
+        int curr_saved = (int)ages.size();
+        if (curr_saved < 4)
+            return false;
+
+        double avg_time = 0;
+        double avg_time2 = 0;
+        for (int i = 0; i < curr_saved; i++) {
+            avg_time += ages[i];
+            avg_time2 += ages[i] * ages[i];
+        }
+        avg_time /= curr_saved;
+        avg_time2 /= curr_saved;
+
+        double st = 0;
+        for (int j = 0; j < curr_saved; j++)
+            st += (ages[j] - avg_time) * (ages[j] - avg_time);
+        st = std::sqrt(st * (1.0 / curr_saved));
+
+        for (int i = 0; i < 7; i++) {
+            double avg_val = 0;
+            double avg_val2 = 0;
+            double avg_tval = 0;
+            for (int ii = 0; ii < curr_saved; ii++) {
+                avg_val += values[ii][i];
+                avg_tval += ages[ii] * values[ii][i];
+                avg_val2 += values[ii][i] * values[ii][i];
+            }
+            avg_val /= curr_saved;
+            avg_tval /= curr_saved;
+            avg_val2 /= curr_saved;
+
+            double sv = 0;
+            for (int j = 0; j < curr_saved; j++)
+                sv += (values[j][i] - avg_val) * (values[j][i] - avg_val);
+            sv = std::sqrt(sv * (1.0 / curr_saved));
+
+            double rxy = (avg_tval - (avg_val * avg_time)) / std::sqrt((avg_time2 - (avg_time * avg_time)) * (avg_val2 - (avg_val * avg_val)));
+            double b = rxy * (sv / st);
+            double a = avg_val - (b * avg_time);
+
+            double y = a + b * age;
+            if (std::abs(avg_val2 - (avg_val * avg_val)) < 0.00000001)
+                y = avg_val;
+            pred[i] = y;
+        }
+        return true;
+    }
+
+    // Feeds long noisy sessions to RegressionFilter, with late samples, gaps that expire the history and session times
+    // far from zero, and compares every prediction with the original regression over the samples the ring holds
+    int CheckRegression()
+    {
+        const int sizes[] = { 5, 10, 50, 200 };
+        const int samples = 20000;
+        const double tolerance = 1e-6;      // m for positions, the quaternion components are of order 1
+
+        double worst = 0;
+        uint64_t compared = 0;
+        uint64_t mismatched = 0;
+        for (int size : sizes) {
+            for (double start : { 0.0, 1e5 }) {
+                std::mt19937 random(size);
+                std::normal_distribution<double> noise(0, 0.002);
+                std::uniform_real_distribution<double> uniform(0, 1);
+                RegressionFilter filter;
+                filter.Configure(size);
+
+                double t = start;
+                for (int n = 0; n < samples; n++) {
+                    //30 Hz with a pause now and then that lets the whole history expire
+                    t += uniform(random) < 0.002 ? 2 : 1 / 30.0 + 0.002 * uniform(random);
+                    double capture = uniform(random) < 0.05 ? t - 0.1 * uniform(random) : t;
+                    double angle = 0.7 * capture;
+                    double pose[7] = { 0.5 * std::cos(angle) + noise(random), 1 + 0.1 * std::sin(3 * angle) + noise(random), 0.5 * std::sin(angle) + noise(random),
+                        std::cos(angle / 2), 0, std::sin(angle / 2), 0 };
+                    filter.Expire(t - 1);
+                    filter.AddSample(capture, pose);
+
+                    //the ring's samples as the original stored them, ages before the newest one
+                    const SampleRing& ring = filter.Samples();
+                    if (ring.Size() < RegressionFilter::kMinSamples)
+                        continue;
+                    std::vector<double> ages(ring.Size());
+                    std::vector<std::array<double, 7>> values(ring.Size());
+                    double newest = ring.Time(0);
+                    for (int i = 0; i < ring.Size(); i++) {
+                        ages[i] = newest - ring.Time(i);
+                        for (int channel = 0; channel < 7; channel++)
+                            values[i][channel] = ring.Value(channel, i);
+                    }
+
+                    double eval_time = t + 0.02;
+                    double expected[7];
+                    double actual[7];
+                    if (!OriginalRegression(ages, values, newest - eval_time, expected) || !filter.Predict(eval_time, actual)) {
+                        mismatched++;
+                        continue;
+                    }
+                    compared++;
+                    double error = 0;
+                    for (int channel = 0; channel < 7; channel++)
+                        error = std::max(error, std::abs(expected[channel] - actual[channel]));
+                    worst = std::max(worst, error);
+                    if (!(error <= tolerance))
+                        mismatched++;
+                }
+            }
+        }
+
+        std::printf("%llu predictions compared, largest difference %.3g, %llu over %.0g\n", (unsigned long long)compared, worst,
+            (unsigned long long)mismatched, tolerance);
+        return mismatched == 0 ? 0 : 1;
+    }
+
+    // Threads record messages of every size as fast as they can, so the ring fills, wraps and drops, and the recording
+    // is stopped while they carry on. Every message holds its thread's sequence number and a pattern made from it.
+    int CheckRecording()
+    {
+        const int threads = 8;
+        const double seconds = 1;
+        const std::string path = (std::filesystem::temp_directory_path() / "driver_check_recording.bin").string();
+
+        auto fill = [](uint32_t sequence, char* message) {
+            size_t length = sizeof(sequence) + sequence * 37 % 300;
+            std::memcpy(message, &sequence, sizeof(sequence));
+            for (size_t i = sizeof(sequence); i < length; i++)
+                message[i] = char(sequence + i);
+            return length;
+        };
+
+        Recording::Writer writer;
+        if (!writer.Start(path)) {
+            std::fprintf(stderr, "could not create %s\n", path.c_str());
+            return 1;
+        }
+        std::atomic<bool> running{ true };
+        std::vector<std::thread> writers;
+        for (int t = 0; t < threads; t++) {
+            writers.emplace_back([&, t]() {
+                char message[512];
+                for (uint32_t sequence = 0; running.load(std::memory_order_relaxed); sequence++)
+                    writer.RecordMessage((uint16_t)t, message, fill(sequence, message), Clock::Now());
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        writer.Stop();
+        running = false;
+        for (std::thread& thread : writers)
+            thread.join();
+
+        Recording::Reader reader;
+        if (!reader.Open(path)) {
+            std::fprintf(stderr, "could not read %s back\n", path.c_str());
+            return 1;
+        }
+        std::vector<int64_t> last(threads, -1);
+        uint64_t read = 0;
+        uint64_t wrong = 0;
+        Recording::Reader::Record record;
+        while (reader.Next(record)) {
+            read++;
+            uint32_t sequence;
+            char expected[512];
+            int t = record.header->source;
+            if (record.header->type != Recording::RecordType::Message || t >= threads || record.header->size < sizeof(sequence)) {
+                wrong++;
+                continue;
+            }
+            std::memcpy(&sequence, record.payload, sizeof(sequence));
+            size_t length = fill(sequence, expected);
+            if (record.header->size != length || std::memcmp(record.payload, expected, length) != 0 || sequence <= last[t])
+                wrong++;
+            last[t] = sequence;
+        }
+        reader.Close();
+        std::filesystem::remove(path);
+
+        bool ok = read == writer.Records() && read > 0 && wrong == 0;
+        std::printf("%llu records from %d threads, %llu dropped, %llu read back, %llu wrong\n", (unsigned long long)writer.Records(),
+            threads, (unsigned long long)writer.Dropped(), (unsigned long long)read, (unsigned long long)wrong);
+        return ok ? 0 : 1;
+    }
+
+    struct Check {
+        const char* name;
+        int (*run)();
+    };
+
+    const Check kChecks[] = {
+        { "loopback", CheckLoopback },
+        { "sharedmemory", CheckSharedMemory },
+        { "extrapolation", CheckExtrapolation },
+        { "clockdelay", CheckClockDelay },
+        { "allocations", CheckAllocations },
+        { "handshake", CheckHandshake },
+        { "fusion", CheckFusion },
+        { "stress", CheckStress },
+        { "stress_publisher", CheckStressPublisher },
+        { "regression", CheckRegression },
+        { "recording", CheckRecording },
+    };
+}
+
+int main(int argc, char** argv)
+{
+    const Check* check = nullptr;
+    for (const Check& candidate : kChecks) {
+        if (argc == 2 && std::strcmp(argv[1], candidate.name) == 0)
+            check = &candidate;
+    }
+    if (check == nullptr) {
+        std::fprintf(stderr, "usage: driver_check <check>, one of:");
+        for (const Check& candidate : kChecks)
+            std::fprintf(stderr, " %s", candidate.name);
+        std::fprintf(stderr, "\n");
+        return 2;
+    }
+
+    int result = check->run();
+    std::printf("%s: %s\n", check->name, result == 0 ? "passed" : "FAILED");
+
+    // The pipe server thread blocks in Accept for good, leave without running static destructors underneath it
+    std::fflush(stdout);
+    std::_Exit(result);
+}
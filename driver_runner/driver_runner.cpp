@@ -0,0 +1,273 @@
+// Headless host for the driver: loads it against MockHost instead of SteamVR, replays recorded pipe traffic into it
+// and drives RunFrame at a fixed rate, so changes can be benchmarked and regression checked on machines without SteamVR.
+//
+// The input is either a session recording (see Driver/Recording.hpp), whose messages are sent again over as many
+// connections as were recorded, or a plain text trace with one message per line: the time in seconds since the start
+// of the trace, a space, then the pipe message exactly as a client would send it. Lines starting with # are skipped.
+//
+//   0.000 addtracker apriltag_0 AprilTag_0
+//   0.033 updatepose 0 0.1 1.0 0.2 1 0 0 0 0.02
+//
+// Replies are written to stdout when --replies is given, the stats reply and a summary of every device always are.
+// With --record the run is itself recorded, session_tool diff compares the poses of two such runs.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openvr_driver.h>
+
+#include <Native/DriverFactory.hpp>
+#include <Driver/Transport.hpp>
+#include <Driver/Protocol.hpp>
+#include <Driver/Recording.hpp>
+
+#include "MockHost.hpp"
+
+namespace {
+
+    struct Options {
+        std::string trace;
+        std::string record;
+        double speed = 1;           // 0 replays as fast as the driver answers
+        double frame_rate = 90;     // Hz
+        double linger = 0.5;        // seconds of frames after the last message
+        bool replies = false;
+        bool verbose = false;
+    };
+
+    void PrintUsage()
+    {
+        std::fprintf(stderr,
+            "usage: driver_runner [options] <trace or recording>\n"
+            "  --speed <x>               replay speed, 2 is twice as fast, 0 as fast as possible (default 1)\n"
+            "  --frame-rate <hz>         RunFrame rate (default 90)\n"
+            "  --linger <seconds>        keep running frames after the trace ends (default 0.5)\n"
+            "  --set [section/]key=value driver setting, the section defaults to driver_apriltag\n"
+            "  --record <file>           record the run\n"
+            "  --replies                 print every reply\n"
+            "  --verbose                 print the driver log to stderr\n");
+    }
+
+    struct Message {
+        double time;            // seconds
+        uint16_t connection;
+        std::string data;
+    };
+
+    bool IsTextCommand(const std::string& message, const char* command)
+    {
+        size_t length = std::strlen(command);
+        return message.compare(0, length, command) == 0 && (message.size() == length || message[length] == ' ' || message[length] == '\0');
+    }
+
+    bool LoadRecording(const std::string& path, std::vector<Message>& messages)
+    {
+        ExampleDriver::Recording::Reader reader;
+        if (!reader.Open(path))
+            return false;
+
+        ExampleDriver::Recording::Reader::Record record;
+        while (reader.Next(record)) {
+            if (record.header->type != ExampleDriver::Recording::RecordType::Message)
+                continue;
+            Message message{ record.header->time, record.header->source, std::string(record.payload, record.header->size) };
+            // Starting or stopping a recording is left to --record
+            if (IsTextCommand(message.data, "record"))
+                continue;
+            messages.push_back(std::move(message));
+        }
+        return true;
+    }
+
+    bool LoadTrace(const std::string& path, std::vector<Message>& messages)
+    {
+        std::ifstream trace(path);
+        if (!trace)
+            return false;
+
+        std::string line;
+        while (std::getline(trace, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            size_t space = line.find(' ');
+            if (space == std::string::npos)
+                continue;
+            messages.push_back({ std::atof(line.substr(0, space).c_str()), 0, line.substr(space + 1) });
+        }
+        return true;
+    }
+
+    // Sends one message and waits for its reply. Binary replies are shown as their length.
+    bool Exchange(ExampleDriver::IConnection& connection, const std::string& message, std::string& reply)
+    {
+        char buffer[ExampleDriver::kMaxMessageSize];
+        if (!connection.Send(message.data(), message.size()))
+            return false;
+        if (!ExampleDriver::Protocol::ExpectsReply(message.data(), message.size())) {
+            reply = "<no reply>";
+            return true;
+        }
+        int length = connection.Receive(buffer, sizeof(buffer) - 1);
+        if (length < 0)
+            return false;
+        buffer[length] = '\0';
+        if (ExampleDriver::Protocol::IsBinaryMessage(buffer, length))
+            reply = "<binary reply, " + std::to_string(length) + " bytes>";
+        else
+            reply = buffer;
+        return true;
+    }
+
+    std::unique_ptr<ExampleDriver::IConnection> Connect()
+    {
+        // The pipe server starts on its own thread in Init, give it a moment to come up
+        std::unique_ptr<ExampleDriver::IConnection> connection;
+        for (int attempt = 0; attempt < 50 && connection == nullptr; attempt++) {
+            connection = ExampleDriver::ConnectTransport("ApriltagPipeIn");
+            if (connection == nullptr)
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return connection;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // Kept alive to the very end: the driver's pipe threads are never joined
+    static DriverRunner::MockDriverContext context;
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--speed" && has_value)
+            options.speed = std::atof(argv[++i]);
+        else if (arg == "--frame-rate" && has_value)
+            options.frame_rate = std::atof(argv[++i]);
+        else if (arg == "--linger" && has_value)
+            options.linger = std::atof(argv[++i]);
+        else if (arg == "--set" && has_value) {
+            if (!context.settings.Set(argv[++i])) {
+                std::fprintf(stderr, "bad setting %s, expected [section/]key=value\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg == "--record" && has_value)
+            options.record = argv[++i];
+        else if (arg == "--replies")
+            options.replies = true;
+        else if (arg == "--verbose")
+            options.verbose = true;
+        else if (arg[0] != '-' && options.trace.empty())
+            options.trace = arg;
+        else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (options.trace.empty() || options.frame_rate <= 0) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<Message> messages;
+    if (!LoadRecording(options.trace, messages) && !LoadTrace(options.trace, messages)) {
+        std::fprintf(stderr, "could not open %s\n", options.trace.c_str());
+        return 1;
+    }
+
+    context.log.echo = options.verbose;
+
+    // Load the driver the same way SteamVR does
+    int error = vr::VRInitError_None;
+    auto provider = static_cast<vr::IServerTrackedDeviceProvider*>(HmdDriverFactory(vr::IServerTrackedDeviceProvider_Version, &error));
+    if (provider == nullptr || provider->Init(&context) != vr::VRInitError_None) {
+        std::fprintf(stderr, "driver failed to initialize\n");
+        return 1;
+    }
+
+    // RunFrame on a fixed grid, like the compositor's frame pacing. A late frame does not shift the ones after it.
+    std::atomic<bool> running{ true };
+    std::atomic<uint64_t> frames{ 0 };
+    std::thread frame_thread([&]() {
+        auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.frame_rate));
+        auto next = std::chrono::steady_clock::now();
+        while (running) {
+            provider->RunFrame();
+            frames++;
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    // One connection of our own for record and stats, the replayed ones are opened as their messages come up
+    std::string reply;
+    std::unique_ptr<ExampleDriver::IConnection> control = Connect();
+    if (control == nullptr) {
+        std::fprintf(stderr, "could not connect to the driver\n");
+        running = false;
+        frame_thread.join();
+        return 1;
+    }
+    if (!options.record.empty() && (!Exchange(*control, "record " + options.record, reply) || reply.find("recording") == std::string::npos))
+        std::fprintf(stderr, "could not record to %s\n", options.record.c_str());
+
+    // Replay. Message times are relative to the first message, scaled by the speed.
+    std::map<uint16_t, std::unique_ptr<ExampleDriver::IConnection>> connections;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sent = 0;
+    for (const auto& message : messages) {
+        if (options.speed > 0)
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((message.time - messages.front().time) / options.speed)));
+
+        auto& connection = connections[message.connection];
+        if (connection == nullptr)
+            connection = Connect();
+        if (connection == nullptr || !Exchange(*connection, message.data, reply)) {
+            std::fprintf(stderr, "driver closed the connection\n");
+            break;
+        }
+        sent++;
+        if (options.replies)
+            std::printf("%s\n", reply.c_str());
+    }
+    double replay_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.linger));
+    running = false;
+    frame_thread.join();
+    double run_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Summary: the driver's own timing histograms, then what the host saw of every device
+    if (!options.record.empty() && Exchange(*control, "record", reply))
+        std::printf("%s\n", reply.c_str());
+    if (Exchange(*control, "stats", reply))
+        std::printf("%s\n", reply.c_str());
+    std::printf("messages %llu in %.3f s, frames %llu in %.3f s\n", (unsigned long long)sent, replay_seconds, (unsigned long long)frames.load(), run_seconds);
+    for (const auto& device : context.host.GetDevices()) {
+        const auto& position = device.last_pose.vecPosition;
+        std::printf("device %s: %llu poses (%.1f/s), last %.4f %.4f %.4f%s\n", device.serial.c_str(),
+            (unsigned long long)device.pose_updates, device.pose_updates / run_seconds,
+            position[0], position[1], position[2], device.last_pose.poseIsValid ? "" : " invalid");
+    }
+    std::fflush(stdout);
+
+    connections.clear();
+    control.reset();
+    provider->Cleanup();
+
+    // The pipe server thread blocks in Accept for good, leave without running static destructors underneath it
+    std::_Exit(0);
+}
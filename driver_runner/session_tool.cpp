@@ -0,0 +1,239 @@
+// Offline tools for session recordings (see Driver/Recording.hpp):
+//
+//   session_tool dump <recording>
+//     prints the recorded messages as a driver_runner text trace, with the posted poses as comments
+//   session_tool diff <a> <b> [--position-tolerance mm] [--rotation-tolerance deg]
+//     compares the poses two driver builds posted for the same input, usually two driver_runner --record runs
+//     of one recording. Every pose of b is compared against a's poses interpolated to the same time relative to
+//     the latest message, so differences in when the replayed messages arrived cancel out. Exits with 1 if any
+//     device differs by more than the tolerances. Two runs of the same build still differ by how far a tracker moves
+//     in the remaining frame timing jitter: a few mm at walking speed.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Driver/Protocol.hpp>
+#include <Driver/Quaternion.hpp>
+#include <Driver/Recording.hpp>
+
+using namespace ExampleDriver;
+
+namespace {
+
+    struct Pose {
+        double time;    // seconds since the first message
+        Recording::PoseRecord record;
+    };
+
+    struct Session {
+        std::map<uint16_t, std::vector<Pose>> devices;
+        std::vector<double> messages;   // arrival times, seconds since the first message
+    };
+
+    double FirstMessageTime(Recording::Reader& reader)
+    {
+        Recording::Reader::Record record;
+        while (reader.Next(record)) {
+            if (record.header->type == Recording::RecordType::Message) {
+                reader.Rewind();
+                return record.header->time;
+            }
+        }
+        reader.Rewind();
+        return reader.Header()->start_time;
+    }
+
+    bool Load(const char* path, Session& session)
+    {
+        Recording::Reader reader;
+        if (!reader.Open(path)) {
+            std::fprintf(stderr, "could not open %s\n", path);
+            return false;
+        }
+
+        double origin = FirstMessageTime(reader);
+        Recording::Reader::Record record;
+        while (reader.Next(record)) {
+            if (record.header->type == Recording::RecordType::Message) {
+                session.messages.push_back(record.header->time - origin);
+            }
+            else if (record.header->type == Recording::RecordType::Pose && record.header->size >= sizeof(Recording::PoseRecord)) {
+                Pose pose;
+                pose.time = record.header->time - origin;
+                std::memcpy(&pose.record, record.payload, sizeof(pose.record));
+                session.devices[record.header->source].push_back(pose);
+            }
+        }
+        return true;
+    }
+
+    int Dump(const char* path)
+    {
+        Recording::Reader reader;
+        if (!reader.Open(path)) {
+            std::fprintf(stderr, "could not open %s\n", path);
+            return 1;
+        }
+
+        double origin = FirstMessageTime(reader);
+        Recording::Reader::Record record;
+        while (reader.Next(record)) {
+            double time = record.header->time - origin;
+            if (record.header->type == Recording::RecordType::Message) {
+                std::string message(record.payload, record.header->size);
+                if (Protocol::IsBinaryMessage(message.data(), message.size()))
+                    std::printf("# %.6f binary message, %u bytes on connection %u\n", time, record.header->size, record.header->source);
+                else
+                    std::printf("%.6f %s\n", time, message.c_str());
+            }
+            else if (record.header->type == Recording::RecordType::Pose && record.header->size >= sizeof(Recording::PoseRecord)) {
+                Recording::PoseRecord pose;
+                std::memcpy(&pose, record.payload, sizeof(pose));
+                std::printf("# %.6f pose %u %.5f %.5f %.5f %.5f %.5f %.5f %.5f%s\n", time, record.header->source,
+                    pose.position[0], pose.position[1], pose.position[2],
+                    pose.rotation[0], pose.rotation[1], pose.rotation[2], pose.rotation[3],
+                    pose.flags & Recording::kPoseValid ? "" : " invalid");
+            }
+        }
+        return 0;
+    }
+
+    // a's pose at time, interpolated between the two poses around it. False outside a's time span.
+    bool Interpolate(const std::vector<Pose>& a, double time, double position[], double rotation[], bool& valid)
+    {
+        auto after = std::lower_bound(a.begin(), a.end(), time, [](const Pose& pose, double t) { return pose.time < t; });
+        if (after == a.end() || (after == a.begin() && after->time > time))
+            return false;
+        auto before = after->time > time ? after - 1 : after;
+
+        double span = after->time - before->time;
+        double t = span > 0 ? (time - before->time) / span : 0;
+        for (int i = 0; i < 3; i++)
+            position[i] = before->record.position[i] + (after->record.position[i] - before->record.position[i]) * t;
+        Quaternion::Slerp(before->record.rotation, after->record.rotation, t, rotation);
+        valid = (before->record.flags & after->record.flags & Recording::kPoseValid) != 0;
+        return true;
+    }
+
+    // The time in a that corresponds to time in b: the same distance after the latest message
+    double ToTimeOf(const Session& a, const Session& b, double time)
+    {
+        if (a.messages.empty() || b.messages.empty())
+            return time;
+        auto next = std::upper_bound(b.messages.begin(), b.messages.end(), time);
+        size_t latest = next == b.messages.begin() ? 0 : next - b.messages.begin() - 1;
+        latest = std::min(latest, a.messages.size() - 1);
+        return time - b.messages[latest] + a.messages[latest];
+    }
+
+    int Diff(const char* path_a, const char* path_b, double position_tolerance, double rotation_tolerance)
+    {
+        Session a, b;
+        if (!Load(path_a, a) || !Load(path_b, b))
+            return 1;
+
+        std::printf("messages %zu / %zu\n", a.messages.size(), b.messages.size());
+
+        std::map<uint16_t, bool> devices;
+        for (auto& device : a.devices)
+            devices[device.first] = true;
+        for (auto& device : b.devices)
+            devices[device.first] = true;
+
+        bool differ = false;
+        for (auto& entry : devices) {
+            uint16_t index = entry.first;
+            auto& poses_a = a.devices[index];
+            auto& poses_b = b.devices[index];
+            if (poses_a.empty() || poses_b.empty()) {
+                std::printf("device %u: only posted in %s\n", index, poses_a.empty() ? "b" : "a");
+                differ = true;
+                continue;
+            }
+
+            size_t compared = 0;
+            size_t validity = 0;
+            double position_sum = 0, position_max = 0;
+            double rotation_sum = 0, rotation_max = 0;
+            double worst_time = 0;
+            for (const auto& pose : poses_b) {
+                double position[3], rotation[4];
+                bool valid;
+                if (!Interpolate(poses_a, ToTimeOf(a, b, pose.time), position, rotation, valid))
+                    continue;
+                if (valid != ((pose.record.flags & Recording::kPoseValid) != 0)) {
+                    validity++;
+                    continue;
+                }
+                if (!valid)
+                    continue;
+
+                double dx = pose.record.position[0] - position[0];
+                double dy = pose.record.position[1] - position[1];
+                double dz = pose.record.position[2] - position[2];
+                double position_error = std::sqrt(dx * dx + dy * dy + dz * dz) * 1000;
+
+                double delta[3];
+                Quaternion::Difference(rotation, pose.record.rotation, delta);
+                double rotation_error = std::sqrt(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]) * 180 / 3.14159265358979323846;
+
+                compared++;
+                position_sum += position_error;
+                rotation_sum += rotation_error;
+                if (position_error > position_max) {
+                    position_max = position_error;
+                    worst_time = pose.time;
+                }
+                rotation_max = std::max(rotation_max, rotation_error);
+            }
+
+            bool device_differs = position_max > position_tolerance || rotation_max > rotation_tolerance || validity > 0;
+            differ = differ || device_differs;
+            std::printf("device %u: %zu / %zu poses, %zu compared, position mean %.3f max %.3f mm (at %.3f s), rotation mean %.3f max %.3f deg, %zu validity changes%s\n",
+                index, poses_a.size(), poses_b.size(), compared,
+                compared ? position_sum / compared : 0, position_max, worst_time,
+                compared ? rotation_sum / compared : 0, rotation_max, validity,
+                device_differs ? " DIFFERS" : "");
+        }
+        return differ ? 1 : 0;
+    }
+
+    void PrintUsage()
+    {
+        std::fprintf(stderr,
+            "usage: session_tool dump <recording>\n"
+            "       session_tool diff <a> <b> [--position-tolerance mm] [--rotation-tolerance deg]\n"
+            "  tolerances default to 5 mm and 2 deg\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && std::strcmp(argv[1], "dump") == 0)
+        return Dump(argv[2]);
+
+    if (argc >= 4 && std::strcmp(argv[1], "diff") == 0) {
+        double position_tolerance = 5;
+        double rotation_tolerance = 2;
+        for (int i = 4; i < argc; i++) {
+            if (std::strcmp(argv[i], "--position-tolerance") == 0 && i + 1 < argc)
+                position_tolerance = std::atof(argv[++i]);
+            else if (std::strcmp(argv[i], "--rotation-tolerance") == 0 && i + 1 < argc)
+                rotation_tolerance = std::atof(argv[++i]);
+            else {
+                PrintUsage();
+                return 2;
+            }
+        }
+        return Diff(argv[2], argv[3], position_tolerance, rotation_tolerance);
+    }
+
+    PrintUsage();
+    return 2;
+}
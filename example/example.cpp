@@ -1,49 +1,47 @@
 #include "example.h"
 
-const int BUFSIZE = 1024;
-
-TCHAR chReadBuf[BUFSIZE];
-BOOL fSuccess;
-DWORD cbRead;
-LPTSTR lpszPipename = TEXT("\\\\.\\pipe\\ApriltagPipeIn");
-
 int trackernum = 4;
 
 int main()
 {
 	std::cout << "Waiting..." << std::endl;
 
-	const int BUFSIZE = 1024;
-	std::string pipeName = "\\\\.\\pipe\\ApriltagPipeIn";
-
-	std::istringstream ret;
-	std::string word;
+	ApriltagClient::Client client;
+	if (!client.Connect())
+	{
+		std::cout << "Could not connect to the driver!" << std::endl;
+		return 23;
+	}
 
-	ret = Send(TEXT("numtrackers"));
-	ret >> word;
-	if (word != "numtrackers")
+	int connected_trackers = client.NumTrackers();
+	if (connected_trackers < 0)
 	{
 		std::cout << "Wrong message received!" << std::endl;
 		return 24;
 	}
-	int connected_trackers;
-	ret >> connected_trackers;
 	for(int i = connected_trackers;i<trackernum;i++)
 	{
-		ret = Send(TEXT("addtracker"));
-		ret >> word;
-		if (word != "added")
+		std::string name = "ExampleTracker" + std::to_string(i);
+		if (!client.AddTracker(name.c_str(), "TrackerRole_Waist"))
 		{
 			std::cout << "Wrong message received!" << std::endl;
 			return 25;
 		}
 	}
 
-	//ret = Send(TEXT("addstation"));
+	//client.AddStation();
+
+	//the driver writes the controller's pose to shared memory every frame, no need to ask for it
+	const uint32_t followed_device = 1; // 0 for HMD, 1 is left controller
+	if (!client.SubscribeDevicePoses(&followed_device, 1))
+	{
+		std::cout << "Could not subscribe to device poses!" << std::endl;
+		return 27;
+	}
 
 	Sleep(1000);
 
-	//ret = Send(TEXT("updatestation 0 2 1 0 1 0 0 0"));
+	//client.UpdateStation(0, ApriltagClient::Pose{ { 2, 1, 0 }, { 1, 0, 0, 0 } });
 
 	clock_t start, end;
 	while (true)
@@ -51,101 +49,45 @@ int main()
 		//for timing our detection
 		start = clock();
 
-		ret = Send(TEXT("synctime"));
-		double avgtime; int lasttime;
-		
-		ret >> avgtime;
-		ret >> lasttime; 
+		ApriltagClient::FrameTiming timing;
+		if (!client.SyncTime(timing))
+		{
+			std::cout << "Connection to the driver lost!" << std::endl;
+			return 26;
+		}
 
-		Sleep((int)(avgtime - (lasttime % (int)avgtime)));
+		Sleep((int)(timing.frame_time - fmod(timing.since_last_frame, timing.frame_time)));
 		//Sleep(30);
 
-		ret = Send(TEXT("getdevicepose 1")); // 0 for HMD, 1 is left controller
-		ret >> word;
-		if (word != "devicepose")
+		//first three values are a position vector, second four are rotation quaternion
+		ApriltagClient::DevicePose device;
+		if (!client.ReadDevicePose(followed_device, device) || !device.valid)
 		{
-			std::cout << "Wrong message received!" << " " << word << std::endl;
+			std::cout << "Device not tracked!" << std::endl;
 			continue;
-			return 26;
 		}
-
-		//first three variables are a position vector
-		int idx; double a; double b; double c;
-
-		//second four are rotation quaternion
-		double qw; double qx; double qy; double qz;
-
-		//read to our variables
-		ret >> idx; ret >> a; ret >> b; ret >> c; ret >> qw; ret >> qx; ret >> qy; ret >> qz;
+		ApriltagClient::Pose pose;
+		std::memcpy(pose.position, device.position, sizeof(pose.position));
+		std::memcpy(pose.rotation, device.rotation, sizeof(pose.rotation));
+		double a = pose.position[0]; double b = pose.position[1]; double c = pose.position[2];
 
 		std::cout << a << " " << b << " " << c << std::endl;
 
-		SendTracker(0, a, b, c, qw, qx, qy, qz, -1, 0.9);
-		SendTracker(1, a - 1, b, c, qw, qx, qy, qz, -1, 0.9);
-		SendTracker(2, a, b, c + 1, qw, qx, qy, qz, -1, 0.9);
-		SendTracker(3, a, b, c - 1, qw, qx, qy, qz, -1, 0.9);
+		//fire and forget, the driver does not reply to these so the loop never waits on them
+		ApriltagClient::Pose moved = pose;
+		client.SendPose(0, moved, 0);
+		moved.position[0] = a - 1;
+		client.SendPose(1, moved, 0);
+		moved.position[0] = a; moved.position[2] = c + 1;
+		client.SendPose(2, moved, 0);
+		moved.position[2] = c - 1;
+		client.SendPose(3, moved, 0);
 
-		//ret = Send(TEXT("updatestation 0 0 0 0 1 0 0 0"));
+		//client.UpdateStation(0, ApriltagClient::Pose{ { 0, 0, 0 }, { 1, 0, 0, 0 } });
 
 		end = clock();
 		double frameTime = double(end - start) / double(CLOCKS_PER_SEC);
 
 		std::cout << frameTime << double(CLOCKS_PER_SEC) << std::endl;
 	}
-}
-
-std::istringstream Send(LPTSTR lpszWrite)
-{
-	fSuccess = CallNamedPipe(
-		lpszPipename,        // pipe name 
-		lpszWrite,           // message to server 
-		(lstrlen(lpszWrite) + 1) * sizeof(TCHAR), // message length 
-		chReadBuf,              // buffer to receive reply 
-		BUFSIZE * sizeof(TCHAR),  // size of read buffer 
-		&cbRead,                // number of bytes read 
-		2000);                 // waits for 2 seconds 
-
-	if (fSuccess || GetLastError() == ERROR_MORE_DATA)
-	{
-		std::cout << chReadBuf << std::endl;
-		chReadBuf[cbRead] = '\0'; //add terminating zero
-					//convert our buffer to string
-		std::string rec = chReadBuf;
-		std::istringstream iss(rec);
-		// The pipe is closed; no more data can be read. 
-
-		if (!fSuccess)
-		{
-			printf("\nExtra data in message was lost\n");
-		}
-		return iss;
-	}
-	else
-	{
-		std::cout << GetLastError() << " :(" << std::endl;
-		std::string rec = " senderror";
-		std::istringstream iss(rec);
-		return iss;
-	}
-}
-
-std::istringstream SendTracker(int id, double a, double b, double c, double qw, double qx, double qy, double qz, double time, double smoothing)
-{
-	std::string s;
-	s = " updatepose " + std::to_string(id) +
-		" " + std::to_string(a) +
-		" " + std::to_string(b) +
-		" " + std::to_string(c) +
-		" " + std::to_string(qw) +
-		" " + std::to_string(qx) +
-		" " + std::to_string(qy) +
-		" " + std::to_string(qz) +
-		" " + std::to_string(time) +
-		" " + std::to_string(smoothing) + "\n";
-
-	//send the string to our driver
-
-	LPTSTR sendstring = (LPTSTR)s.c_str();
-
-	return Send(sendstring);
 }
\ No newline at end of file
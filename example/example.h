@@ -5,9 +5,9 @@
 #include <string>
 #include <sstream> 
 #include <time.h>
+#include <math.h>
+#include <string.h>
 
-std::istringstream SendTracker(int id, double a, double b, double c, double qw, double qx, double qy, double qz, double time, double smoothing);
-std::istringstream Send(LPTSTR lpszWrite);
-void Sync();
+#include <ApriltagClient.hpp>
 
 int waitFrames = 90*30;  //at a 90hz HMD, this equals about half a minute
\ No newline at end of file
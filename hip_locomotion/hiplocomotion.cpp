@@ -2,13 +2,6 @@
 
 const int BUFSIZE = 1024;
 
-TCHAR chReadBuf[BUFSIZE];
-BOOL fSuccess;
-DWORD cbRead;
-LPTSTR lpszPipename = TEXT("\\\\.\\pipe\\ApriltagPipeIn");
-
-int trackernum = 4;
-
 void check_error(int line, vr::EVRInitError error) { if (error != 0) printf("%d: error %s\n", line, VR_GetVRInitErrorAsSymbol(error)); }
 
 int main()
@@ -17,12 +10,8 @@ int main()
 	VR_Init(&error, vr::VRApplication_Overlay);
 	check_error(__LINE__, error);
 
-	std::istringstream ret;
-	std::string word;
-
-	ret = Send(TEXT("addhipmove"));
-	ret >> word;
-	if (word != "added")
+	ApriltagClient::Client client;
+	if (!client.Connect() || !client.AddHipMove())
 	{
 		std::cout << "Wrong message received!" << std::endl;
 	}
@@ -137,7 +126,7 @@ int main()
 		{
 			Sleep(100);
 			recalibrate = true;
-			SendMove(0, 0, 0, 0, 0, 0);
+			client.HipMoveInput(0, 0, 0, 0, 0, 0);
 			continue;
 		}
 		
@@ -200,7 +189,7 @@ int main()
 
 		std::cout << "Received data: " << analogData.x << "," << analogData.y << " Calculated data: " << newDataX << "," << newDataY << std::endl;
 
-		SendMove(newDataX, newDataY, newDataRx, 0, 0, 0);
+		client.HipMoveInput(newDataX, newDataY, newDataRx, 0, 0, 0);
 
 		Sleep(2);
 
@@ -225,56 +214,4 @@ bool GetDigitalActionState(vr::VRActionHandle_t action, vr::VRInputValueHandle_t
 		}
 	}
 	return actionData.bActive && actionData.bState;
-}
-
-std::istringstream Send(LPTSTR lpszWrite)
-{
-	fSuccess = CallNamedPipe(
-		lpszPipename,        // pipe name 
-		lpszWrite,           // message to server 
-		(lstrlen(lpszWrite) + 1) * sizeof(TCHAR), // message length 
-		chReadBuf,              // buffer to receive reply 
-		BUFSIZE * sizeof(TCHAR),  // size of read buffer 
-		&cbRead,                // number of bytes read 
-		2000);                 // waits for 2 seconds 
-
-	if (fSuccess || GetLastError() == ERROR_MORE_DATA)
-	{
-		std::cout << chReadBuf << std::endl;
-		chReadBuf[cbRead] = '\0'; //add terminating zero
-					//convert our buffer to string
-		std::string rec = chReadBuf;
-		std::istringstream iss(rec);
-		// The pipe is closed; no more data can be read. 
-
-		if (!fSuccess)
-		{
-			printf("\nExtra data in message was lost\n");
-		}
-		return iss;
-	}
-	else
-	{
-		std::cout << GetLastError() << " :(" << std::endl;
-		std::string rec = " senderror";
-		std::istringstream iss(rec);
-		return iss;
-	}
-}
-
-std::istringstream SendMove(double x, double y, double rx, double ry, double a, double b)
-{
-	std::string s;
-	s = " hipmoveinput " + std::to_string(x) +
-		" " + std::to_string(y) +
-		" " + std::to_string(rx) + 
-		" " + std::to_string(ry) + 
-		" " + std::to_string(a) + 
-		" " + std::to_string(b) + "\n";
-
-	//send the string to our driver
-
-	LPTSTR sendstring = (LPTSTR)s.c_str();
-
-	return Send(sendstring);
 }
\ No newline at end of file
@@ -9,7 +9,6 @@
 #include <math.h>
 #include <filesystem>
 
+#include <ApriltagClient.hpp>
 
-std::istringstream SendMove(double x, double y, double rx, double ry, double a, double b);
-std::istringstream Send(LPTSTR lpszWrite);
 bool GetDigitalActionState(vr::VRActionHandle_t action, vr::VRInputValueHandle_t* pDevicePath = nullptr);